@@ -19,6 +19,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define JDIFF_AVX2      // AVX2 versions of maskEqual and hashBlock, selected at runtime
+#endif
+
+#include "JDefs.h"
+
 namespace JojoDiff {
 
 /* List of primes we select from when size is specified on commandline
@@ -66,4 +78,233 @@ int getLowerPrime(int aiNum){
     return aiNum;
 }
 
+/**
+* @brief Count the number of leading equal bytes in two buffers.
+*
+* Compares 32 bytes at a time using SSE2, or 8 bytes at a time on other
+* little-endian platforms, and finishes byte per byte.
+*
+* @param    apOrg   first buffer
+* @param    apNew   second buffer
+* @param    alLen   number of bytes to compare
+* @return   number of equal bytes before the first difference (alLen if all are equal)
+*/
+long countEqual(jchar const *apOrg, jchar const *apNew, long alLen){
+    long llIdx = 0 ;
+
+#if defined(__SSE2__)
+    for ( ; llIdx + 32 <= alLen; llIdx += 32) {
+        __m128i lxEq1 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *) &apOrg[llIdx]),
+                                       _mm_loadu_si128((__m128i const *) &apNew[llIdx])) ;
+        __m128i lxEq2 = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *) &apOrg[llIdx + 16]),
+                                       _mm_loadu_si128((__m128i const *) &apNew[llIdx + 16])) ;
+        unsigned int liMsk = (unsigned int) _mm_movemask_epi8(lxEq1)
+                           | ((unsigned int) _mm_movemask_epi8(lxEq2) << 16) ;
+        if (liMsk != 0xffffffffu)
+            return llIdx + __builtin_ctz(~liMsk) ;
+    }
+#elif defined(__GNUC__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    uint64_t llOrg ;
+    uint64_t llNew ;
+    for ( ; llIdx + 8 <= alLen; llIdx += 8) {
+        memcpy(&llOrg, &apOrg[llIdx], 8) ;
+        memcpy(&llNew, &apNew[llIdx], 8) ;
+        if (llOrg != llNew)
+            return llIdx + (__builtin_ctzll(llOrg ^ llNew) >> 3) ;
+    }
+#endif
+
+    for ( ; llIdx < alLen && apOrg[llIdx] == apNew[llIdx]; llIdx++) ;
+    return llIdx ;
+}
+
+/**
+* @brief Get a bitmask of the equal bytes in two blocks of 64 bytes.
+*
+* Compares 16 bytes at a time using SSE2, or 8 bytes at a time on other
+* platforms.
+*/
+static uint64_t maskEqualSse2(jchar const *apOrg, jchar const *apNew){
+    uint64_t llMsk = 0 ;
+
+#if defined(__SSE2__)
+    for (int liIdx = 0 ; liIdx < 64 ; liIdx += 16)
+        llMsk |= (uint64_t) (unsigned int) _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const *) &apOrg[liIdx]),
+                                   _mm_loadu_si128((__m128i const *) &apNew[liIdx]))) << liIdx ;
+#else
+    uint64_t llOrg ;
+    uint64_t llNew ;
+    for (int liIdx = 0 ; liIdx < 64 ; liIdx += 8) {
+        memcpy(&llOrg, &apOrg[liIdx], 8) ;
+        memcpy(&llNew, &apNew[liIdx], 8) ;
+        if (llOrg == llNew)
+            llMsk |= (uint64_t) 0xff << liIdx ;
+        else
+            for (int liByt = 0 ; liByt < 8 ; liByt++)
+                if (apOrg[liIdx + liByt] == apNew[liIdx + liByt])
+                    llMsk |= (uint64_t) 1 << (liIdx + liByt) ;
+    }
+#endif
+    return llMsk ;
+}
+
+#ifdef JDIFF_AVX2
+/**
+* @brief Get a bitmask of the equal bytes in two blocks of 64 bytes, using AVX2.
+*/
+__attribute__((target("avx2")))
+static uint64_t maskEqualAvx2(jchar const *apOrg, jchar const *apNew){
+    unsigned int liLow = (unsigned int) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *) &apOrg[0]),
+                          _mm256_loadu_si256((__m256i const *) &apNew[0]))) ;
+    unsigned int liHgh = (unsigned int) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *) &apOrg[32]),
+                          _mm256_loadu_si256((__m256i const *) &apNew[32]))) ;
+    return (uint64_t) liLow | ((uint64_t) liHgh << 32) ;
+}
+#endif // JDIFF_AVX2
+
+/**
+* @brief Select the fastest maskEqual for this processor.
+*/
+static uint64_t (*selectMaskEqual())(jchar const *, jchar const *){
+#ifdef JDIFF_AVX2
+    __builtin_cpu_init() ;
+    if (__builtin_cpu_supports("avx2"))
+        return maskEqualAvx2 ;
+#endif // JDIFF_AVX2
+    return maskEqualSse2 ;
+}
+
+uint64_t (* const maskEqual)(jchar const *apOrg, jchar const *apNew) = selectMaskEqual() ;
+
+/**
+* @brief Hash a block of bytes one byte at a time, exactly as JDiff::hash.
+*/
+static void hashBlockScalar(jchar const *apDta, long alLen, hkey &akHsh, int &acPrv, int &aiEql,
+                            hkey *apKey, int *apEql){
+    hkey lkHsh = akHsh ;
+    int  lcPrv = acPrv ;
+    int  liEql = aiEql ;
+
+    for (long llIdx = 0 ; llIdx < alLen ; llIdx++) {
+        if (apDta[llIdx] == lcPrv) {
+            if (liEql < SMPSZE)
+                liEql ++ ;
+        } else {
+            lcPrv = apDta[llIdx] ;
+            liEql = 0 ;
+        }
+        lkHsh = (lkHsh * 2) + apDta[llIdx] + liEql ;
+        apKey[llIdx] = lkHsh ;
+        apEql[llIdx] = liEql ;
+    }
+    akHsh = lkHsh ;
+    acPrv = lcPrv ;
+    aiEql = liEql ;
+}
+
+#ifdef JDIFF_AVX2
+/**
+* @brief Hash a block of bytes using AVX2 (64-bit hash keys only).
+*
+* Works in two passes. First, the equal-chars counts are calculated from a
+* bitmask of bytes that equal their predecessor, 32 bytes at a time.
+* Then, as every key is the previous key times 2 plus the byte and its count,
+* four keys at a time are calculated from the keys four positions earlier:
+*   key[i] = key[i-4] * 16 + v[i-3] * 8 + v[i-2] * 4 + v[i-1] * 2 + v[i]
+* The first four keys are calculated one by one.
+*/
+__attribute__((target("avx2")))
+static void hashBlockAvx2(jchar const *apDta, long alLen, hkey &akHsh, int &acPrv, int &aiEql,
+                          hkey *apKey, int *apEql){
+    __m256i lxHsh ;     // four consecutive keys
+    __m256i lxVal ;     // weighted sum of bytes and counts
+    __m256i lxByt ;
+    __m256i lxEql ;
+    uint32_t liMsk ;    // bytes equal to their predecessor
+    uint32_t liByt ;
+    long llIdx ;
+    int  liEql ;
+    int  liBit ;
+
+    if (alLen < 8) {
+        hashBlockScalar(apDta, alLen, akHsh, acPrv, aiEql, apKey, apEql) ;
+        return ;
+    }
+    hashBlockScalar(apDta, 4, akHsh, acPrv, aiEql, apKey, apEql) ;
+
+    /* equal-chars counts */
+    liEql = aiEql ;
+    for (llIdx = 4 ; llIdx + 32 <= alLen ; llIdx += 32) {
+        liMsk = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                    _mm256_loadu_si256((__m256i const *) &apDta[llIdx]),
+                    _mm256_loadu_si256((__m256i const *) &apDta[llIdx - 1]))) ;
+        if (liMsk == 0 || (liMsk == 0xffffffffu && liEql == SMPSZE)) {
+            // no equal bytes or a long run of equal bytes
+            lxEql = _mm256_set1_epi32(liMsk == 0 ? 0 : SMPSZE) ;
+            for (liBit = 0 ; liBit < 32 ; liBit += 8)
+                _mm256_storeu_si256((__m256i *) &apEql[llIdx + liBit], lxEql) ;
+            liEql = apEql[llIdx + 31] ;
+        } else {
+            for (liBit = 0 ; liBit < 32 ; liBit++) {
+                if ((liMsk >> liBit) & 1) {
+                    if (liEql < SMPSZE)
+                        liEql ++ ;
+                } else {
+                    liEql = 0 ;
+                }
+                apEql[llIdx + liBit] = liEql ;
+            }
+        }
+    }
+    for ( ; llIdx < alLen ; llIdx++) {
+        if (apDta[llIdx] == apDta[llIdx - 1]) {
+            if (liEql < SMPSZE)
+                liEql ++ ;
+        } else {
+            liEql = 0 ;
+        }
+        apEql[llIdx] = liEql ;
+    }
+
+    /* keys */
+    lxHsh = _mm256_loadu_si256((__m256i const *) &apKey[0]) ;
+    for (llIdx = 4 ; llIdx + 4 <= alLen ; llIdx += 4) {
+        lxVal = _mm256_setzero_si256() ;
+        for (liBit = 3 ; liBit >= 0 ; liBit--) {
+            memcpy(&liByt, &apDta[llIdx - liBit], 4) ;
+            lxByt = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128((int) liByt)) ;
+            lxEql = _mm256_cvtepi32_epi64(_mm_loadu_si128((__m128i const *) &apEql[llIdx - liBit])) ;
+            lxVal = _mm256_add_epi64(_mm256_slli_epi64(lxVal, 1), _mm256_add_epi64(lxByt, lxEql)) ;
+        }
+        lxHsh = _mm256_add_epi64(_mm256_slli_epi64(lxHsh, 4), lxVal) ;
+        _mm256_storeu_si256((__m256i *) &apKey[llIdx], lxHsh) ;
+    }
+    for ( ; llIdx < alLen ; llIdx++) {
+        apKey[llIdx] = (apKey[llIdx - 1] * 2) + apDta[llIdx] + apEql[llIdx] ;
+    }
+
+    akHsh = apKey[alLen - 1] ;
+    acPrv = apDta[alLen - 1] ;
+    aiEql = apEql[alLen - 1] ;
+}
+#endif // JDIFF_AVX2
+
+/**
+* @brief Select the fastest hashBlock for this processor.
+*/
+static void (*selectHashBlock())(jchar const *, long, hkey &, int &, int &, hkey *, int *){
+#ifdef JDIFF_AVX2
+    __builtin_cpu_init() ;
+    if (sizeof(hkey) == 8 && __builtin_cpu_supports("avx2"))
+        return hashBlockAvx2 ;
+#endif // JDIFF_AVX2
+    return hashBlockScalar ;
+}
+
+void (* const hashBlock)(jchar const *apDta, long alLen, hkey &akHsh, int &acPrv, int &aiEql,
+                         hkey *apKey, int *apEql) = selectHashBlock() ;
+
 } /* namespace JojoDiff */
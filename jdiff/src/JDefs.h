@@ -37,6 +37,7 @@
 #define _JDEFS_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define JDIFF_VERSION   "0.8.5 (beta) 2020"
 #define JDIFF_COPYRIGHT "Copyright (C) 2002-2020 Joris Heirbaut"
@@ -47,6 +48,10 @@
  *   JDIFF_STDIO_ONLY       to remove istream support
  *   JDIFF_THROW_BAD_ALLOC  to throw bad alloc exception when a malloc fails
  *   JDIFF_DEDUP            to include deduplication feature (linux only)
+ *   JDIFF_THREADS          to include multi-threaded features (needs std::thread)
+ *   JDIFF_MMAP             to include memory mapped file access (needs mmap)
+ *   JDIFF_KCOPY            to copy equal regions in the kernel when patching (linux only)
+ *   JDIFF_URING            to read the source file with io_uring (linux only)
  */
 
 // Indicate JDIFF that files may be larger that 2GB
@@ -77,7 +82,29 @@
 
 // Include deduplication feature ?
 #ifdef __linux__
-//#define JDIFF_DEDUP
+#define JDIFF_DEDUP
+#endif // __linux__
+
+// Include multi-threading ? Older MINGW32 versions lack std::thread.
+#ifdef __linux__
+#define JDIFF_THREADS
+#endif // __linux__
+
+// Include memory mapped files ? Not available on Windows.
+#ifndef _WIN32
+#define JDIFF_MMAP
+#endif // _WIN32
+
+// Copy equal regions file-to-file in the kernel (copy_file_range/sendfile) ?
+#ifdef __linux__
+#define JDIFF_KCOPY
+#endif // __linux__
+
+// Read the source file with io_uring (JFileUring) ? Falls back to pread at runtime.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define JDIFF_URING
+#endif
 #endif // __linux__
 
 /*
@@ -180,6 +207,45 @@ namespace JojoDiff {
     */
     int getLowerPrime(int aiNum) ;
 
+    /**
+    * @brief Count the number of leading equal bytes in two buffers.
+    *
+    * @param    apOrg   first buffer
+    * @param    apNew   second buffer
+    * @param    alLen   number of bytes to compare
+    * @return   number of equal bytes before the first difference (alLen if all are equal)
+    */
+    long countEqual(jchar const *apOrg, jchar const *apNew, long alLen) ;
+
+    /**
+    * @brief Get a bitmask of the equal bytes in two blocks of 64 bytes.
+    *
+    * Selected at startup: AVX2 when the processor supports it, SSE2 or
+    * 8 bytes at a time otherwise.
+    *
+    * @param    apOrg   first block
+    * @param    apNew   second block
+    * @return   bit i is set when apOrg[i] == apNew[i]
+    */
+    extern uint64_t (* const maskEqual)(jchar const *apOrg, jchar const *apNew) ;
+
+    /**
+    * @brief Hash a block of bytes, giving the same keys as JDiff::hash byte per byte.
+    *
+    * Selected at startup: AVX2 when the processor supports it, one byte at a
+    * time otherwise.
+    *
+    * @param    apDta   bytes to hash
+    * @param    alLen   number of bytes to hash
+    * @param    akHsh   in/out: hash key
+    * @param    acPrv   in/out: previous byte
+    * @param    aiEql   in/out: equal-chars count
+    * @param    apKey   out: hash key after each byte (alLen keys)
+    * @param    apEql   out: equal-chars count after each byte (alLen counts)
+    */
+    extern void (* const hashBlock)(jchar const *apDta, long alLen, hkey &akHsh, int &acPrv, int &aiEql,
+                                    hkey *apKey, int *apEql) ;
+
 } /* namespace jojodiff */
 
 #endif /* _JDEFS_H */
@@ -66,6 +66,13 @@
 #include "JDefs.h"
 #include "JDiff.h"
 #include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef JDIFF_THREADS
+#include <thread>
+#include <functional>
+#endif // JDIFF_THREADS
 
 #ifdef _FILE_OFFSET_BITS
 #pragma message "INFO: FILE OFFSET BITS = " XSTR(_FILE_OFFSET_BITS)
@@ -94,6 +101,17 @@
 
 #define PGSMRK 0x100000    /**< Progress mark: show progress in Mb (1024 * 1024 or 0x400 x 0x400)  */
 #define PGSMSK 0x1ffffff   /**< Progress mask: show progress every 32Mb when (lzPos & PGSMSK == 0) */
+#define IDXSLC 0x80000     /**< Parallel indexing: bytes per thread per round (512kB)              */
+#define SRCPFT 16          /**< Search: number of hashtable lookups to prefetch ahead              */
+#define HSHBLK 1024        /**< Number of positions hashed at a time (see hashBlock)               */
+#define ANCDEF 6           /**< Anchors: default mask bits when the source size is unknown         */
+#define ANCLOD 32          /**< Anchors: automatic mask bits aim at this many anchors per slot     */
+#define ANCMIN 4           /**< Anchors: minimum automatic mask bits, lookups skip most positions  */
+#define SFXMIN 8           /**< Suffix array: minimum match length, less is cheaper as MOD/INS     */
+#define SFXJMP 8           /**< Suffix array: extra match length elsewhere, to pay for a DEL/BKT   */
+#define SFXSTP 8           /**< Suffix array: look up every SFXSTP'th position in the source       */
+#define SFXLEN 1024        /**< Suffix array: length of a match to stop looking further            */
+#define SFXBUF 0x10000     /**< Suffix array: size of the buffer on the new file (64kB)            */
 
 namespace JojoDiff {
 
@@ -111,25 +129,76 @@ JDiff::JDiff(
     const int aiMchMax,         /* Maximum matches to search for */
     const int aiMchMin,         /* Minimum matches to search for */
     const int aiAhdMax,         /* Lookahead maximum (in bytes) */
-    const bool abCmpAll         /* Compare all matches ? */
+    const bool abCmpAll,        /* Compare all matches ? */
+    const int aiThrCnt,         /* Number of indexing threads */
+    const int aiAncBit,         /* Anchor mask bits: -1=no anchors, 0=automatic */
+    const bool abSfxArr,        /* Search with a suffix array ? */
+    const bool abHshBkt,        /* Hashtable of buckets ? */
+    const char * const asIdxCch,/* Index cache file */
+    JHashPos * const apHsh      /* Shared hashtable */
 ) : mpFilOrg(apFilOrg), mpFilNew(apFilNew), mpOut(apOut),
-    gpHsh(null), gpMch(null),
+    gpHsh(apHsh), mbHshOwn(apHsh == null), gpMch(null),
+    mpSfx(null), mpSfxBuf(null), mzSfxBuf(0), mlSfxBuf(0),
     miVerbse(aiVerbse), mbSrcBkt(abSrcBkt),
     miMchMax(aiMchMax),
     miMchMin(aiMchMin > miMchMax ? miMchMax - 1 : aiMchMin),
     miAhdMax(aiAhdMax<1024?1024:aiAhdMax),
-    mbCmpAll(abCmpAll), miSrcScn(aiSrcScn)
+    mbCmpAll(abCmpAll), miSrcScn(aiSrcScn),
+    miThrCnt(aiThrCnt < 1 ? 1 : aiThrCnt), msIdxCch(asIdxCch),
+    miHshSze(aiHshSze), miAncBit(aiAncBit), mbHshBkt(abHshBkt)
 {
-	gpHsh = new JHashPos(aiHshSze) ;
-	gpMch = new JMatchTable(gpHsh, mpFilOrg, mpFilNew, aiMchMax, abCmpAll, aiAhdMax);
+	if (! mbHshOwn) {
+	    miSrcScn = 2 ;  // shared hashtable has already been indexed
+	    miRlb = gpHsh->get_reliability() ;
+	} else if (abSfxArr) {
+	    if (mpFilOrg->geteof() < SFXMAXSZE) {
+	        // the suffix array is built by index(), as a full prescan
+	        mpSfx = new JSuffixArray() ;
+	        miSrcScn = 1 ;
+	    } else {
+	        fprintf(JDebug::stddbg, "Warning: no suffix array on a sequential or too large source file, using the hashtable.\n");
+	    }
+	}
+
+	// the hashtable is only needed without suffix array (or when building it fails)
+	if (mpSfx == null)
+	    newIndex() ;
+}
+
+/**
+ * @brief Create the hashtable (unless shared) and the matching table.
+ */
+void JDiff::newIndex()
+{
+	if (mbHshOwn) {
+	    gpHsh = new JHashPos(miHshSze, mbHshBkt) ;
+	    if (miAncBit > 0) {
+	        gpHsh->set_anchors(miAncBit) ;
+	    } else if (miAncBit == 0) {
+	        // automatic: overload the table, colliding anchors keep an evenly spread
+	        // subset, whereas too few anchors leave slots empty and matches unseen
+	        off_t lzEof = mpFilOrg->geteof() ;
+	        int liBit = ANCMIN ;
+	        if (lzEof == MAX_OFF_T)
+	            liBit = ANCDEF ;
+	        else
+	            while ((lzEof >> liBit) > (off_t) gpHsh->get_hashcapacity() * ANCLOD)
+	                liBit ++ ;
+	        gpHsh->set_anchors(liBit) ;
+	    }
+	}
+	gpMch = new JMatchTable(gpHsh, mpFilOrg, mpFilNew, miMchMax, mbCmpAll, miAhdMax);
 }
 
 /*
  * Destructor
  */
 JDiff::~JDiff() {
-	delete gpHsh ;
+	if (mbHshOwn)
+	    delete gpHsh ;
 	delete gpMch ;
+	delete mpSfx ;
+	free(mpSfxBuf) ;
 }
 
 /**
@@ -157,6 +226,7 @@ int JDiff::jdiff()
     bool  lbEql = false;    /**< accumulate equal bytes? */
     off_t lzEql = 0;        /**< accumulated equal bytes */
     off_t lzCnt ;           /**< counter */
+    off_t lzBlk ;           /**< number of bytes compared or output in bulk */
 
     int liFnd = 0;          /**< offsets are pointing to a valid solution (= equal regions) ?   */
     off_t lzAhd=0;          /**< number of bytes to advance on both files to reach the solution */
@@ -206,6 +276,15 @@ int JDiff::jdiff()
                         mlHshOrg = hash(mlHshOrg, miPrvOrg, lcOrg, miEqlOrg) ;
                         gpHsh->add(mlHshOrg, mzAhdOrg, miEqlOrg) ;
                         mzAhdOrg ++ ;
+                    } else {
+                        // compare in bulk, but not beyond the incremental scan position
+                        lzBlk = lzLapSml - lzPosNew - 1 ;
+                        if (lzPosOrg < mzAhdOrg && lzBlk > mzAhdOrg - lzPosOrg - 1)
+                            lzBlk = mzAhdOrg - lzPosOrg - 1 ;
+                        lzBlk = scanEql(lzPosOrg + 1, lzPosNew + 1, lzBlk) ;
+                        lzCnt += lzBlk ;
+                        lzPosOrg += lzBlk ;
+                        lzPosNew += lzBlk ;
                     }
                     lcOrg = mpFilOrg->get(++ lzPosOrg, JFile::Read) ;
                     lcNew = mpFilNew->get(++ lzPosNew, JFile::Read) ;
@@ -215,7 +294,11 @@ int JDiff::jdiff()
             } else {
                 lzCnt = 0;
                 while (lcOrg == lcNew && lcNew >= 0 && lzPosNew < lzLapSml){
-                    lzCnt ++ ;
+                    // compare in bulk within the buffers
+                    lzBlk = scanEql(lzPosOrg + 1, lzPosNew + 1, lzLapSml - lzPosNew - 1) ;
+                    lzCnt += lzBlk + 1 ;
+                    lzPosOrg += lzBlk ;
+                    lzPosNew += lzBlk ;
                     lcOrg = mpFilOrg->get(++ lzPosOrg, JFile::Read) ;
                     lcNew = mpFilNew->get(++ lzPosNew, JFile::Read) ;
                 }
@@ -228,19 +311,30 @@ int JDiff::jdiff()
 
             /* Output difference */
             if (lcOrg < 0) {
-                mpOut->put(INS, 1, lcOrg, lcNew, lzPosOrg, lzPosNew);
-                lzAhd -- ;      // decrease ahead counter
+                lzBlk = putRun(INS, lzPosOrg, lzPosNew, lzAhd) ;
+                if (lzBlk == 0) {
+                    mpOut->put(INS, 1, lcOrg, lcNew, lzPosOrg, lzPosNew);
+                    lzBlk = 1 ;
+                }
+                lzAhd -= lzBlk ;    // decrease ahead counter
 
                 /* Take next byte from destination file ... */
-                lcNew = mpFilNew->get(++ lzPosNew, JFile::Read) ;
+                lzPosNew += lzBlk ;
+                lcNew = mpFilNew->get(lzPosNew, JFile::Read) ;
             } else {
                 while (lcOrg != lcNew && lcOrg >= 0 && lcNew >= 0 && lzAhd > 0){
-                    mpOut->put(MOD, 1, lcOrg, lcNew, lzPosOrg, lzPosNew);
-                    lzAhd -- ;      // decrease ahead counter
+                    lzBlk = putRun(MOD, lzPosOrg, lzPosNew, lzAhd) ;
+                    if (lzBlk == 0) {
+                        mpOut->put(MOD, 1, lcOrg, lcNew, lzPosOrg, lzPosNew);
+                        lzBlk = 1 ;
+                    }
+                    lzAhd -= lzBlk ;    // decrease ahead counter
 
                     /* Take next byte from each file ... */
-                    lcOrg = mpFilOrg->get(++ lzPosOrg, JFile::Read) ;
-                    lcNew = mpFilNew->get(++ lzPosNew, JFile::Read) ;
+                    lzPosOrg += lzBlk ;
+                    lzPosNew += lzBlk ;
+                    lcOrg = mpFilOrg->get(lzPosOrg, JFile::Read) ;
+                    lcNew = mpFilNew->get(lzPosNew, JFile::Read) ;
                 }
             }
 
@@ -258,7 +352,7 @@ int JDiff::jdiff()
             }
 
             //v083x: advance depending on hashtable overloading
-            lzAhd = gpHsh->get_reliability() / 2 ;
+            lzAhd = (gpHsh != null ? gpHsh->get_reliability() : SMPSZE) / 2 ;
 
         } else {
             // Look for a new solution
@@ -298,9 +392,14 @@ int JDiff::jdiff()
             }
             if (lzSkpNew > 0) {
                 while (lzSkpNew > 0 && lcNew > EOF) {
-                    mpOut->put(INS, 1, 0, lcNew, lzPosOrg, lzPosNew);
-                    lzSkpNew-- ;
-                    lcNew = mpFilNew->get(++ lzPosNew, JFile::Read);
+                    lzBlk = putRun(INS, lzPosOrg, lzPosNew, lzSkpNew) ;
+                    if (lzBlk == 0) {
+                        mpOut->put(INS, 1, 0, lcNew, lzPosOrg, lzPosNew);
+                        lzBlk = 1 ;
+                    }
+                    lzSkpNew -= lzBlk ;
+                    lzPosNew += lzBlk ;
+                    lcNew = mpFilNew->get(lzPosNew, JFile::Read);
                 }
             }
         } /* if lcOrg == lcNew */
@@ -334,6 +433,133 @@ int JDiff::jdiff()
     return EXI_OK;
 } /* jdiff */
 
+/**
+* @brief Index the source file ahead of jdiff().
+*
+* @return 0 = ok, < 0 = error (see jdiff)
+*/
+int JDiff::index ()
+{
+    if (miSrcScn == 1) {
+        int liRet ;
+        if (mpSfx != null) {
+            if (miVerbse > 1)
+                fprintf(JDebug::stddbg, "Sorting suffixes of the source file...\n");
+            liRet = mpSfx->build(mpFilOrg) ;
+            if (liRet == EXI_OK)
+                mpSfxBuf = (jchar *) malloc(SFXBUF) ;
+            if (liRet == EXI_OK && mpSfxBuf == null)
+                liRet = EXI_MEM ;
+            if (liRet == EXI_MEM || liRet == EXI_LRG) {
+                fprintf(JDebug::stddbg, "Warning: not enough memory for a suffix array, using the hashtable.\n");
+                delete mpSfx ;
+                mpSfx = null ;
+                newIndex() ;
+            } else if (liRet != EXI_OK) {
+                return liRet ;
+            }
+        }
+        if (mpSfx == null) {
+            liRet = buildFullIndex() ;
+            if (liRet < 0)
+                return liRet ;
+        }
+        miSrcScn = 2 ;
+    }
+    if (gpHsh != null)
+        miRlb = gpHsh->get_reliability() ;
+    return 0 ;
+} /* index */
+
+/**
+ * @brief Count equal bytes using the buffers of both files.
+ *
+ * Takes contiguous spans from both buffers (JFile::getbuf) and compares them
+ * in bulk (countEqual), which is much faster than comparing byte per byte
+ * with JFile::get.
+ *
+ * @param azPosOrg  position in original file
+ * @param azPosNew  position in new file
+ * @param azMax     maximum number of bytes to compare
+ * @return number of equal bytes found within the buffers (may be less than the actual number)
+ */
+off_t JDiff::scanEql(off_t const azPosOrg, off_t const azPosNew, off_t const azMax) const {
+    off_t lzCnt = 0 ;   // equal bytes found
+    off_t lzLenOrg ;    // bytes available in original buffer
+    off_t lzLenNew ;    // bytes available in new buffer
+    long  llLen ;       // bytes to compare
+    long  llEql ;       // equal bytes compared
+    jchar *lpOrg ;
+    jchar *lpNew ;
+
+    while (lzCnt < azMax) {
+        lpOrg = mpFilOrg->getbuf(azPosOrg + lzCnt, lzLenOrg, JFile::Read) ;
+        if (lpOrg == null || lzLenOrg <= 0)
+            break ;
+        lpNew = mpFilNew->getbuf(azPosNew + lzCnt, lzLenNew, JFile::Read) ;
+        if (lpNew == null || lzLenNew <= 0)
+            break ;
+
+        if (lzLenOrg > lzLenNew)
+            lzLenOrg = lzLenNew ;
+        if (lzLenOrg > azMax - lzCnt)
+            lzLenOrg = azMax - lzCnt ;
+        llLen = (lzLenOrg > LONG_MAX) ? LONG_MAX : (long) lzLenOrg ;
+
+        llEql = countEqual(lpOrg, lpNew, llLen) ;
+        lzCnt += llEql ;
+        if (llEql < llLen)
+            break ;
+    }
+    return lzCnt ;
+} /* scanEql */
+
+/**
+ * @brief Output a run of MOD or INS bytes using the buffers of both files.
+ *
+ * Takes a contiguous span from the buffers (JFile::getbuf) and hands it over
+ * to JOut::putRun at once, instead of calling JOut::put for every byte.
+ * A MOD run ends at the first equal byte.
+ *
+ * @param aiOpr     MOD: bytes that differ on both files, INS: bytes of the new file
+ * @param azPosOrg  position in original file
+ * @param azPosNew  position in new file
+ * @param azMax     maximum number of bytes to output
+ * @return number of bytes output (0 if the data is not within the buffers)
+ */
+off_t JDiff::putRun(int const aiOpr, off_t const azPosOrg, off_t const azPosNew, off_t const azMax) const {
+    off_t lzLenOrg ;    // bytes available in original buffer
+    off_t lzLenNew ;    // bytes available in new buffer
+    long  llLen ;       // bytes to output
+    jchar *lpOrg = null ;
+    jchar *lpNew ;
+
+    lpNew = mpFilNew->getbuf(azPosNew, lzLenNew, JFile::Read) ;
+    if (lpNew == null || lzLenNew <= 0)
+        return 0 ;
+    if (lzLenNew > azMax)
+        lzLenNew = azMax ;
+
+    if (aiOpr == MOD) {
+        lpOrg = mpFilOrg->getbuf(azPosOrg, lzLenOrg, JFile::Read) ;
+        if (lpOrg == null || lzLenOrg <= 0)
+            return 0 ;
+        if (lzLenNew > lzLenOrg)
+            lzLenNew = lzLenOrg ;
+    }
+    llLen = (lzLenNew > LONG_MAX) ? LONG_MAX : (long) lzLenNew ;
+
+    if (aiOpr == MOD) {
+        long llDif ;
+        for (llDif = 0; llDif < llLen && lpOrg[llDif] != lpNew[llDif]; llDif++) ;
+        llLen = llDif ;
+    }
+
+    if (llLen > 0)
+        mpOut->putRun(aiOpr, llLen, lpOrg, lpNew, azPosOrg, azPosNew) ;
+    return llLen ;
+} /* putRun */
+
 /**
  * @brief Flush pending EQL's
  */
@@ -408,17 +634,19 @@ int JDiff::search (
     switch (miSrcScn) {
     case 1: {
             // do a full prescan
-            int liRet = buildFullIndex() ;
+            int liRet = index() ;
             if (liRet < 0)
                 return liRet ;
-            miSrcScn = 2 ;
-            miRlb = gpHsh->get_reliability() ;
         }
         break ;
 
     case 0: {
             // Set lookahead base position and determine lookahead range
             mpFilOrg->set_lookahead_base(azRedOrg);
+            if (! mbSrcBkt) {
+                // sliding window: data before the buffer cannot be read back anymore
+                gpHsh->set_window(mpFilOrg->getBufPos()) ;
+            }
             if (mbSrcBkt){
                 // Backtrace allowed: go ahead as far as possible
                 liMax = miAhdMax ;
@@ -432,8 +660,25 @@ int JDiff::search (
                     liMax = miAhdMax / 2 - (mzAhdOrg - azRedOrg) ;
             }
 
-            // scan ahead till EOB or EOF
+            // scan ahead till EOB or EOF, hashing the buffer in blocks
             int lcOrg ;
+            hkey  lkKey[HSHBLK] ;
+            int   liEql[HSHBLK] ;
+            jchar *lpBuf ;
+            off_t lzBuf ;
+            while (liMax > 0) {
+                lpBuf = mpFilOrg->getbuf(mzAhdOrg, lzBuf, JFile::SoftAhead) ;
+                if (lpBuf == null || lzBuf <= 0)
+                    break ;
+                if (lzBuf > liMax)
+                    lzBuf = liMax ;
+                if (lzBuf > HSHBLK)
+                    lzBuf = HSHBLK ;
+                hashBlock(lpBuf, (long) lzBuf, mlHshOrg, miPrvOrg, miEqlOrg, lkKey, liEql) ;
+                for (int liIdx = 0 ; liIdx < lzBuf ; liIdx++)
+                    gpHsh->add(lkKey[liIdx], mzAhdOrg ++, liEql[liIdx]) ;
+                liMax -= (int) lzBuf ;
+            }
             for ( ; liMax > 0 ; liMax --) {
                 lcOrg = mpFilOrg->get(mzAhdOrg, JFile::SoftAhead) ;
                 if (lcOrg <= EOF)
@@ -447,6 +692,9 @@ int JDiff::search (
         break ;
     } /* switch scan source file - build hashtable */
 
+    if (mpSfx != null)
+        return searchSuffix(azRedOrg, azRedNew, azSkpOrg, azSkpNew, azAhd) ;
+
     /*
     * How many bytes to look ahead (search) ?
     * As far as possible, but going too far makes no sense.
@@ -466,6 +714,14 @@ int JDiff::search (
     else
         liMax = miAhdMax ;
 
+    /*
+    * With a sliding window on the source file, the new file should not be
+    * searched further ahead than the source file has been indexed: the positions
+    * searched now would never be searched again once the source has been indexed.
+    */
+    if (! mbSrcBkt && miSrcScn == 0 && mzAhdOrg - azRedOrg < miAhdMax)
+        liMax -= (int) (miAhdMax - (mzAhdOrg > azRedOrg ? mzAhdOrg - azRedOrg : 0)) ;
+
     if (liMax < miRlb)
         liMax = miRlb  ;    // search at least the reliability distance
 
@@ -579,19 +835,64 @@ int JDiff::search (
 
         /*
         * Build the table of matches
+        *
+        * Hashtable lookups are random memory accesses, so the keys of the next
+        * SRCPFT positions are calculated and prefetched ahead of their lookup.
+        * The hash state (mlHshNew, miPrvNew, miEqlNew) only advances as the
+        * positions are consumed, so stopping halfway leaves it consistent.
         */
+        hkey lkPftHsh[SRCPFT] ;     /**< Prefetched hash keys                   */
+        int  liPftVal[SRCPFT] ;     /**< Prefetched values                      */
+        int  liPftEql[SRCPFT] ;     /**< Prefetched equal-chars counts          */
+        int  liPftCnt = 0 ;         /**< Number of prefetched positions         */
+        int  liPftIdx = 0 ;         /**< Next prefetched position to consume    */
         while ((liMax > 0)) {
-            /* hash the new value */
-            miValNew = mpFilNew->get(++ mzAhdNew, liSftNew) ;
-            if (miValNew <= EOF){
-                mzAhdNew --;
-                break ;
+            /* hash and prefetch the next positions */
+            if (liPftIdx == liPftCnt) {
+                hkey lkHsh = mlHshNew ;
+                int  lcPrv = miPrvNew ;
+                int  liEql = miEqlNew ;
+                int  lcVal ;
+                off_t lzBuf ;
+                jchar *lpBuf = mpFilNew->getbuf(mzAhdNew + 1, lzBuf, liSftNew) ;
+                if (lpBuf != null && lzBuf >= SRCPFT && liMax >= SRCPFT) {
+                    // hash a block from the buffer
+                    hashBlock(lpBuf, SRCPFT, lkHsh, lcPrv, liEql, lkPftHsh, liPftEql) ;
+                    for (liPftCnt = 0 ; liPftCnt < SRCPFT ; liPftCnt ++) {
+                        liPftVal[liPftCnt] = lpBuf[liPftCnt] ;
+                        gpHsh->prefetch(lkPftHsh[liPftCnt]) ;
+                    }
+                } else
+                for (liPftCnt = 0 ; liPftCnt < SRCPFT && liPftCnt < liMax ; liPftCnt ++) {
+                    lcVal = mpFilNew->get(mzAhdNew + 1 + liPftCnt, liSftNew) ;
+                    if (lcVal <= EOF){
+                        if (liPftCnt == 0)
+                            miValNew = lcVal ;
+                        break ;
+                    }
+                    lkHsh = hash(lkHsh, lcPrv, lcVal, liEql) ;
+                    lkPftHsh[liPftCnt] = lkHsh ;
+                    liPftVal[liPftCnt] = lcVal ;
+                    liPftEql[liPftCnt] = liEql ;
+                    gpHsh->prefetch(lkHsh) ;
+                }
+                liPftIdx = 0 ;
+                if (liPftCnt == 0)
+                    break ;
             }
-            mlHshNew = hash(mlHshNew, miPrvNew, miValNew, miEqlNew) ;
+
+            /* consume the next hashed value */
+            mzAhdNew ++ ;
+            miValNew = liPftVal[liPftIdx] ;
+            miPrvNew = miValNew ;
+            miEqlNew = liPftEql[liPftIdx] ;
+            mlHshNew = lkPftHsh[liPftIdx] ;
+            liPftIdx ++ ;
             liMax --;
 
             /* lookup the new value in the hashtable and add it to the table of matches...*/
             if (gpHsh->get(mlHshNew, lzFndOrg)) {
+                miHshHit ++ ;
                 /* ...unless it's not usable because we've been instructed not to backtrack on source file */
                 if (lzFndOrg > lzBseOrg) {
                     /* it's usable: add to the table of matches */
@@ -686,36 +987,152 @@ int JDiff::search (
         }
         return 0 ;
     }  else  {
-        if (lzFndOrg >= azRedOrg) {
-            if (lzFndOrg - azRedOrg >= lzFndNew - azRedNew) {
-                /* go forward on original file */
-                azSkpOrg = lzFndOrg - azRedOrg + azRedNew - lzFndNew ;
-                azSkpNew = 0 ;
-                azAhd    = lzFndNew - azRedNew ;
-            } else {
-                /* go forward on new file */
-                azSkpOrg = 0;
-                azSkpNew = lzFndNew - azRedNew + azRedOrg - lzFndOrg ;
-                azAhd    = lzFndOrg - azRedOrg ;
-            }
+        offsets(azRedOrg, azRedNew, lzFndOrg, lzFndNew, lzBseOrg, azSkpOrg, azSkpNew, azAhd) ;
+        return 1 ;
+    }
+} /* search */
+
+/**
+ * @brief Calculate the offsets to reach a found solution (see search).
+ */
+void JDiff::offsets (
+  off_t const azRedOrg, off_t const azRedNew,
+  off_t const azFndOrg, off_t const azFndNew, off_t const azBseOrg,
+  off_t &azSkpOrg, off_t &azSkpNew, off_t &azAhd
+) const {
+    if (azFndOrg >= azRedOrg) {
+        if (azFndOrg - azRedOrg >= azFndNew - azRedNew) {
+            /* go forward on original file */
+            azSkpOrg = azFndOrg - azRedOrg + azRedNew - azFndNew ;
+            azSkpNew = 0 ;
+            azAhd    = azFndNew - azRedNew ;
         } else {
-            /* backtrack on original file */
-            azSkpOrg = azRedOrg - lzFndOrg + lzFndNew - azRedNew ;
-            if (azSkpOrg <= (azRedOrg - lzBseOrg)) {
-                azSkpNew = 0 ;
-                azSkpOrg = - azSkpOrg ;
-                azAhd = lzFndNew - azRedNew ;
-            } else {
-                /* do not backtrace before beginning of file */
-                azSkpNew = azSkpOrg - (azRedOrg - lzBseOrg) ;
-                azSkpOrg = lzBseOrg - azRedOrg ;
-                azAhd = (lzFndNew - azRedNew) - azSkpNew ;
+            /* go forward on new file */
+            azSkpOrg = 0;
+            azSkpNew = azFndNew - azRedNew + azRedOrg - azFndOrg ;
+            azAhd    = azFndOrg - azRedOrg ;
+        }
+    } else {
+        /* backtrack on original file */
+        azSkpOrg = azRedOrg - azFndOrg + azFndNew - azRedNew ;
+        if (azSkpOrg <= (azRedOrg - azBseOrg)) {
+            azSkpNew = 0 ;
+            azSkpOrg = - azSkpOrg ;
+            azAhd = azFndNew - azRedNew ;
+        } else {
+            /* do not backtrace before beginning of file */
+            azSkpNew = azSkpOrg - (azRedOrg - azBseOrg) ;
+            azSkpOrg = azBseOrg - azRedOrg ;
+            azAhd = (azFndNew - azRedNew) - azSkpNew ;
+        }
+    }
+} /* offsets */
+
+/**
+ * @brief Find the nearest equal regions using the suffix array (see search).
+ *
+ * Every position of the new file, starting at azRedNew, is compared with the
+ * current source position: a continuation, without a jump. Every SFXSTP'th
+ * position is also looked up in the suffix array, anywhere in the source file,
+ * and matches found there are extended backwards. So no match is missed that is
+ * SFXMIN + SFXJMP + SFXSTP bytes or longer.
+ *
+ * Continuations of SFXMIN bytes and jumps of SFXMIN + SFXJMP bytes beat MOD/INS.
+ * The first one is taken, unless an overlapping match within the next
+ * SFXMIN + SFXJMP positions gains more (is longer by more than the bytes it
+ * starts later). A match starting after the first one ends is for the next search.
+ */
+int JDiff::searchSuffix (
+  off_t const &azRedOrg,
+  off_t const &azRedNew,
+  off_t &azSkpOrg,
+  off_t &azSkpNew,
+  off_t &azAhd
+) {
+    off_t lzBseOrg = (mbSrcBkt?0:mpFilOrg->getBufPos()) ;
+    off_t lzFndOrg=0;   /**< Best position within original file                  */
+    off_t lzFndNew=0;   /**< Best position within new file                       */
+    off_t lzPosOrg ;    /**< Continuation position within original file          */
+    off_t lzJmpOrg ;    /**< Matching position anywhere within original file     */
+    off_t lzPosNew ;    /**< Current position within new file                    */
+    off_t lzMax = azRedNew + miAhdMax ; /**< Lookahead limit on new file          */
+    off_t lzBck ;       /**< Number of bytes to extend a match backwards         */
+    int   liFnd = 0 ;   /**< Length of the best match                            */
+    int   liGan = 0 ;   /**< Gain of the best match: length minus SFXJMP on jumps */
+    int   liLen ;       /**< Length of the current match                         */
+    long  liAvl ;       /**< Number of bytes available in mpSfxBuf               */
+
+    for (lzPosNew = azRedNew ; lzPosNew < lzMax ; lzPosNew ++) {
+        /* (Re)fill the buffer on the new file when less than SFXLEN bytes remain */
+        liAvl = mzSfxBuf + mlSfxBuf - lzPosNew ;
+        if (lzPosNew < mzSfxBuf || liAvl <= 0 || (liAvl < SFXLEN && mlSfxBuf == SFXBUF)) {
+            // read ahead through the buffer, like search does, also on sequential files,
+            // keeping up to SFXSTP bytes before lzPosNew to extend matches backwards
+            mzSfxBuf = (lzPosNew - azRedNew > SFXSTP) ? lzPosNew - SFXSTP : azRedNew ;
+            mlSfxBuf = mpFilNew->JFile::read(mzSfxBuf, mpSfxBuf, SFXBUF) ;
+            if (mlSfxBuf < 0)
+                mlSfxBuf = 0 ;
+            liAvl = mzSfxBuf + mlSfxBuf - lzPosNew ;
+        }
+        if (liAvl <= 0)
+            break ;     // end of file
+
+        jchar const *lpDta = mpSfxBuf + (lzPosNew - mzSfxBuf) ;
+
+        /* Prefer a continuation on the current source position */
+        lzPosOrg = azRedOrg + (lzPosNew - azRedNew) ;
+        liLen = mpSfx->match(lpDta, (int) liAvl, lzPosOrg) ;
+        if (liLen >= SFXMIN && (liFnd == 0 || liLen - (lzPosNew - lzFndNew) > liGan)) {
+            liFnd    = liLen ;
+            liGan    = liLen ;
+            lzFndOrg = lzPosOrg ;
+            lzFndNew = lzPosNew ;
+        }
+
+        /* Otherwise jump anywhere in the source file, skipping SFXSTP - 1 positions */
+        if (liLen < SFXMIN && (lzPosNew - azRedNew) % SFXSTP == 0) {
+            liLen = mpSfx->find(lpDta, (int) liAvl, lzPosOrg, lzJmpOrg) ;
+            if (liLen >= SFXMIN && lzJmpOrg != lzPosOrg && lzJmpOrg >= lzBseOrg) {
+                // extend backwards, not before azRedNew, the buffer or lzBseOrg
+                lzBck = lzPosNew - (azRedNew > mzSfxBuf ? azRedNew : mzSfxBuf) ;
+                if (lzBck > lzJmpOrg - lzBseOrg)
+                    lzBck = lzJmpOrg - lzBseOrg ;
+                lzBck = mpSfx->matchback(lpDta, (int) lzBck, lzJmpOrg) ;
+                liLen += (int) lzBck ;
+
+                if (liLen >= SFXMIN + SFXJMP
+                        && (liFnd == 0 || liLen - SFXJMP - (lzPosNew - lzBck - lzFndNew) > liGan)) {
+                    liFnd    = liLen ;
+                    liGan    = liLen - SFXJMP ;
+                    lzFndOrg = lzJmpOrg - lzBck ;
+                    lzFndNew = lzPosNew - lzBck ;
+                }
             }
         }
+        if (liFnd > 0 && (liFnd >= SFXLEN || lzPosNew - lzFndNew >= SFXMIN + SFXJMP
+                                          || lzPosNew - lzFndNew >= liFnd - 1))
+            break ;
+    }
 
-        return 1 ;
-    }
-} /* search */
+    #if debug
+    if (JDebug::gbDbg[DBGAHD])
+        fprintf(JDebug::stddbg, "Search %" PRIzd " %" PRIzd ": suffix " P8zd " " P8zd " len=%d\n",
+                azRedOrg, azRedNew, lzFndOrg, lzFndNew, liFnd) ;
+    #endif
+
+    if (liFnd == 0) {
+        // No solution: jump forward over the searched region
+        azSkpOrg = 0 ;
+        azSkpNew = 0 ;
+        azAhd    = lzPosNew - azRedNew ;
+        if (azAhd < SMPSZE)
+            azAhd = SMPSZE ;
+        return 0 ;
+    }
+
+    offsets(azRedOrg, azRedNew, lzFndOrg, lzFndNew, lzBseOrg, azSkpOrg, azSkpNew, azAhd) ;
+    return 1 ;
+} /* searchSuffix */
 
 /**
  * @brief   Prescan the original file.
@@ -732,54 +1149,89 @@ int JDiff::buildFullIndex ()
     off_t lzPosOrg=-1;    // Position within original file
 
     int liIdx ;
+    bool lbCch = false ;  // Index loaded from cache ?
 
     if (miVerbse > 0) {
         fprintf(JDebug::stddbg, "\nIndexing  : ...           ");
     }
+    mpFilOrg->advise(JFile::Sequential) ;
 
-    /* Read SMPSZE-1 bytes (31 or 63) to initialize the hash function */
-    for (liIdx=0; (liIdx < SMPSZE - 1); liIdx++) {
-        lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
-        if (lcValOrg <= EOF)
-            break ;
-        lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
-    }
-
-    /* Build hashtable */
-    if (miVerbse > 1) {
-        /* slow version with user feedback */
-        while (lcValOrg > EOF) {
+    if (msIdxCch != null && loadIndex(lzPosOrg) == EXI_OK) {
+        lcValOrg = EOF ;
+        lbCch = true ;
+    } else
+#ifdef JDIFF_THREADS
+    if (miThrCnt > 1) {
+        lcValOrg = buildFullIndexParallel(lzPosOrg) ;
+    } else
+#endif // JDIFF_THREADS
+    {
+        /* Read SMPSZE-1 bytes (31 or 63) to initialize the hash function */
+        for (liIdx=0; (liIdx < SMPSZE - 1); liIdx++) {
             lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
             if (lcValOrg <= EOF)
                 break ;
             lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
-            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+        }
 
-            #if debug
-            if (JDebug::gbDbg[DBGAHH])
-                fprintf(JDebug::stddbg, "ufHshAdd(%2x -> %8" PRIhkey ", " P8zd ", %8d)\n",
-                        lcValOrg, lkHshOrg, lzPosOrg, 0);
-            #endif
-
-            /* output position every 16MB */
-            if ((lzPosOrg & PGSMSK) == 0) {
-              fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb", lzPosOrg / PGSMRK);
+        /* Build hashtable */
+        if (miVerbse > 1) {
+            /* slow version with user feedback */
+            while (lcValOrg > EOF) {
+                lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
+                if (lcValOrg <= EOF)
+                    break ;
+                lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
+                gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+
+                #if debug
+                if (JDebug::gbDbg[DBGAHH])
+                    fprintf(JDebug::stddbg, "ufHshAdd(%2x -> %8" PRIhkey ", " P8zd ", %8d)\n",
+                            lcValOrg, lkHshOrg, lzPosOrg, 0);
+                #endif
+
+                /* output position every 16MB */
+                if ((lzPosOrg & PGSMSK) == 0) {
+                  fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb", lzPosOrg / PGSMRK);
+                }
             }
-        }
-    } else {
-        /* fast version, no user feedback nor debug */
-        while (lcValOrg > EOF) {
-            lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
-            if (lcValOrg <= EOF)
-                break ;
-            lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
-            gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+        } else {
+            /* fast version, no user feedback nor debug: hash the buffer in blocks */
+            hkey  lkKey[HSHBLK] ;   // hash keys of current block
+            int   liEql[HSHBLK] ;   // equal-chars counts of current block
+            jchar *lpBuf ;          // buffered data
+            off_t lzBuf ;           // number of bytes in lpBuf
+            while (lcValOrg > EOF) {
+                lpBuf = mpFilOrg->getbuf(lzPosOrg + 1, lzBuf, JFile::HardAhead) ;
+                if (lpBuf != null && lzBuf > 0) {
+                    if (lzBuf > HSHBLK)
+                        lzBuf = HSHBLK ;
+                    hashBlock(lpBuf, (long) lzBuf, lkHshOrg, lcValPrv, liEqlOrg, lkKey, liEql) ;
+                    for (liIdx = 0 ; liIdx < lzBuf ; liIdx++)
+                        gpHsh->add(lkKey[liIdx], ++ lzPosOrg, liEql[liIdx]) ;
+                    continue ;
+                }
+                lcValOrg = mpFilOrg->get(++ lzPosOrg, JFile::HardAhead);
+                if (lcValOrg <= EOF)
+                    break ;
+                lkHshOrg = hash(lkHshOrg, lcValPrv, lcValOrg, liEqlOrg) ;
+                gpHsh->add(lkHshOrg, lzPosOrg, liEqlOrg) ;
+            }
         }
     }
 
+    mpFilOrg->advise(JFile::Normal) ;
+
+    /* Save the index for subsequent runs */
+    if (msIdxCch != null && ! lbCch && lcValOrg == EOF) {
+        if (saveIndex(lzPosOrg) != EXI_OK)
+            fprintf(JDebug::stddbg, "\nWarning: could not write index cache %s.\n", msIdxCch);
+    }
+
     if (miVerbse > 0) {
         /* output final position */
-        fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb\n", lzPosOrg / PGSMRK);
+        fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb%s\n",
+                lzPosOrg / PGSMRK, lbCch ? " (cached)" : "");
         fprintf(JDebug::stddbg, "Comparing : ...           ");
     }
     if (miVerbse>2){
@@ -791,5 +1243,375 @@ int JDiff::buildFullIndex ()
     else
         return 0 ;
 } /* buildFullIndex */
+
+/*
+ * Index cache file header, followed by the hashtable (see JHashPos::save).
+ * The cache is meant to be used on the same machine: integers are stored in
+ * native format, hence the sizes in the header.
+ */
+#define IDXMGC "JDIFFIDX"   /**< Index cache magic                          */
+#define IDXVER 4            /**< Index cache version                        */
+#define IDXBLK 64           /**< Number of blocks to checksum               */
+#define IDXBLS 4096         /**< Size of blocks to checksum                 */
+
+typedef struct tIdxHdr {
+    char  icMgc[8] ;        /**< IDXMGC                                     */
+    int   iiVer ;           /**< IDXVER                                     */
+    int   iiSmpSze ;        /**< SMPSZE                                     */
+    int   iiHkySze ;        /**< sizeof(hkey)                               */
+    int   iiOffSze ;        /**< sizeof(off_t)                              */
+    long long ilSrcSze ;    /**< size of the source file                    */
+    long long ilSrcMtm ;    /**< modification time of the source file       */
+    hkey  ikSrcChk ;        /**< checksum of the source file                */
+} rIdxHdr ;
+
+/**
+ * @brief Identify the source file: size, modification time and checksum.
+ *
+ * The checksum covers IDXBLK blocks of IDXBLS bytes spread over the file, so
+ * identifying a file does not cost a full read. A stale cache would only
+ * degrade the quality of the differences, not their correctness, as all
+ * equal regions are verified when comparing.
+ *
+ * @param azSze     out: size
+ * @param alMtm     out: modification time
+ * @param akChk     out: checksum
+ * @return EXI_OK, EXI_ERR when the source file cannot be identified
+ */
+int JDiff::identify (off_t &azSze, long long &alMtm, hkey &akChk)
+{
+    struct stat lsSta ;
+    off_t lzPos ;
+    int   lcVal ;
+    int   liBlk ;
+    int   liIdx ;
+
+    if (mpFilOrg->get_fd() < 0 || fstat(mpFilOrg->get_fd(), &lsSta) != 0 || ! S_ISREG(lsSta.st_mode))
+        return EXI_ERR ;
+
+    azSze = lsSta.st_size ;
+    alMtm = (long long) lsSta.st_mtime ;
+    akChk = (hkey) azSze ;
+    for (liBlk = 0; liBlk < IDXBLK; liBlk++) {
+        lzPos = (azSze / IDXBLK) * liBlk ;
+        for (liIdx = 0; liIdx < IDXBLS; liIdx++) {
+            lcVal = mpFilOrg->get(lzPos + liIdx, JFile::Read) ;
+            if (lcVal < 0)
+                break ;
+            akChk = akChk * 31 + lcVal ;
+        }
+    }
+    return EXI_OK ;
+} /* identify */
+
+/**
+ * @brief Load the hashtable from the index cache file.
+ *
+ * @param azPosOrg  out: position of the end of the source file
+ * @return EXI_OK = loaded, other = cache not usable
+ */
+int JDiff::loadIndex (off_t &azPosOrg)
+{
+    rIdxHdr lsHdr ;
+    off_t lzSze ;
+    long long llMtm ;
+    hkey  lkChk ;
+    FILE *lpFil ;
+    int   liRet ;
+
+    if (identify(lzSze, llMtm, lkChk) != EXI_OK)
+        return EXI_ERR ;
+
+    lpFil = jfopen(msIdxCch, "rb") ;
+    if (lpFil == null)
+        return EXI_FRT ;
+
+    if (fread(&lsHdr, sizeof(lsHdr), 1, lpFil) != 1) {
+        liRet = EXI_RED ;
+    } else if (memcmp(lsHdr.icMgc, IDXMGC, sizeof(lsHdr.icMgc)) != 0
+            || lsHdr.iiVer != IDXVER
+            || lsHdr.iiSmpSze != SMPSZE
+            || lsHdr.iiHkySze != (int) sizeof(hkey)
+            || lsHdr.iiOffSze != (int) sizeof(off_t)
+            || lsHdr.ilSrcSze != (long long) lzSze
+            || lsHdr.ilSrcMtm != llMtm
+            || lsHdr.ikSrcChk != lkChk) {
+        liRet = EXI_ERR ;
+    } else {
+        liRet = gpHsh->load(lpFil) ;
+    }
+    jfclose(lpFil) ;
+
+    if (liRet == EXI_OK)
+        azPosOrg = lzSze ;
+
+    return liRet ;
+} /* loadIndex */
+
+/**
+ * @brief Save the hashtable to the index cache file.
+ *
+ * Writes a temporary file first, then renames it, so that concurrent runs
+ * never read a partially written cache.
+ *
+ * @param azPosOrg  position of the end of the source file
+ * @return EXI_OK = saved, other = error
+ */
+int JDiff::saveIndex (off_t const azPosOrg)
+{
+    rIdxHdr lsHdr ;
+    off_t lzSze ;
+    FILE *lpFil ;
+    int   liRet = EXI_OK ;
+    char *lcTmp ;
+
+    memset(&lsHdr, 0, sizeof(lsHdr)) ;
+    if (identify(lzSze, lsHdr.ilSrcMtm, lsHdr.ikSrcChk) != EXI_OK || lzSze != azPosOrg)
+        return EXI_ERR ;
+    memcpy(lsHdr.icMgc, IDXMGC, sizeof(lsHdr.icMgc)) ;
+    lsHdr.iiVer    = IDXVER ;
+    lsHdr.iiSmpSze = SMPSZE ;
+    lsHdr.iiHkySze = (int) sizeof(hkey) ;
+    lsHdr.iiOffSze = (int) sizeof(off_t) ;
+    lsHdr.ilSrcSze = (long long) lzSze ;
+
+    lcTmp = (char *) malloc(strlen(msIdxCch) + 5) ;
+    if (lcTmp == null)
+        return EXI_MEM ;
+    strcpy(lcTmp, msIdxCch) ;
+    strcat(lcTmp, ".tmp") ;
+
+    lpFil = jfopen(lcTmp, "wb") ;
+    if (lpFil == null) {
+        liRet = EXI_OUT ;
+    } else {
+        if (fwrite(&lsHdr, sizeof(lsHdr), 1, lpFil) != 1)
+            liRet = EXI_WRI ;
+        else
+            liRet = gpHsh->save(lpFil) ;
+        if (jfclose(lpFil) != 0 && liRet == EXI_OK)
+            liRet = EXI_WRI ;
+
+        if (liRet == EXI_OK && rename(lcTmp, msIdxCch) != 0)
+            liRet = EXI_WRI ;
+        if (liRet != EXI_OK)
+            remove(lcTmp) ;
+    }
+    free(lcTmp) ;
+
+    return liRet ;
+} /* saveIndex */
+
+#ifdef JDIFF_THREADS
+/**
+ * @brief Copy bytes from the source file into a buffer.
+ *
+ * Uses the buffer of the source file whenever possible, byte per byte otherwise.
+ *
+ * @param apDst     destination buffer
+ * @param azPos     position to read from
+ * @param alLen     number of bytes to read
+ * @return >= 0: number of bytes copied (less than alLen at EOF), < EOF: error
+ */
+long JDiff::readOrg (jchar *apDst, off_t azPos, long alLen)
+{
+    long  llRed = 0 ;   // bytes copied
+    off_t lzBuf ;       // bytes available in buffer
+    int   lcVal ;       // byte read when buffer is not available
+    jchar *lpBuf ;
+
+    while (llRed < alLen) {
+        lpBuf = mpFilOrg->getbuf(azPos + llRed, lzBuf, JFile::HardAhead) ;
+        if (lpBuf != null && lzBuf > 0) {
+            if (lzBuf > alLen - llRed)
+                lzBuf = alLen - llRed ;
+            memcpy(apDst + llRed, lpBuf, lzBuf) ;
+            llRed += lzBuf ;
+        } else {
+            lcVal = mpFilOrg->get(azPos + llRed, JFile::HardAhead) ;
+            if (lcVal == EOF)
+                break ;
+            if (lcVal < EOF)
+                return lcVal ;
+            apDst[llRed++] = (jchar) lcVal ;
+        }
+    }
+    return llRed ;
+} /* readOrg */
+
+/**
+ * @brief Hash and sample one slice of the source file.
+ *
+ * The hash value only depends on the last SMPSZE bytes and the equal-counter
+ * never exceeds SMPSZE, so hashing 2 x SMPSZE bytes before the slice yields the
+ * same keys as a sequential scan. Selected samples are collected in ipKey/ipPos
+ * and stored into the hashtable by the calling thread, in file order.
+ */
+void JDiff::indexSlice (rIdxSlc &arSlc) const
+{
+    hkey  lkHsh=0;          // Current hash value
+    int   liEql=0;          // Number of times current value occurs in hash value
+    int   lcPrv=EOF;        // Previous value
+    off_t lzPos ;           // Position within original file
+    jchar const *lpCur ;    // Current byte
+    hkey  lkKey[HSHBLK] ;   // Hash keys of current block
+    int   liBlkEql[HSHBLK] ;// Equal-chars counts of current block
+    long  llLen ;           // Number of bytes in current block
+    long  llIdx ;
+
+    /* warm-up hash and equal-counter */
+    for (lpCur = arSlc.ipBeg; lpCur < arSlc.ipSmp; lpCur++) {
+        lkHsh = hash(lkHsh, lcPrv, *lpCur, liEql) ;
+    }
+
+    /* hash and sample */
+    arSlc.ilCnt = 0 ;
+    for (lzPos = arSlc.izSmp; lpCur < arSlc.ipEnd; lpCur += llLen, lzPos += llLen) {
+        llLen = (arSlc.ipEnd - lpCur < HSHBLK) ? (long) (arSlc.ipEnd - lpCur) : HSHBLK ;
+        hashBlock(lpCur, llLen, lkHsh, lcPrv, liEql, lkKey, liBlkEql) ;
+        for (llIdx = 0; llIdx < llLen; llIdx++) {
+            if (gpHsh->get_anchors() >= 0 ? gpHsh->anchor(lkKey[llIdx])
+                                          : gpHsh->sample(arSlc.isSte, liBlkEql[llIdx])) {
+                arSlc.ipKey[arSlc.ilCnt] = lkKey[llIdx] ;
+                arSlc.ipPos[arSlc.ilCnt] = lzPos + llIdx ;
+                arSlc.ilCnt ++ ;
+            }
+        }
+    }
+} /* indexSlice */
+
+/**
+ * @brief Multi-threaded version of buildFullIndex.
+ *
+ * The source file is processed in rounds of miThrCnt slices of IDXSLC bytes.
+ * Every round is copied into a buffer preceded by the last 2 x SMPSZE bytes of
+ * the previous round. Slices are hashed in parallel while the next round is
+ * being read. The collision strategy state at the start of each slice is
+ * calculated upfront (see JHashPos::skip), so the resulting hashtable is
+ * identical to the one built by the sequential scan.
+ *
+ * @param azPosOrg  out: position of the end of the source file
+ * @return EOF = ok, < EOF = error
+ */
+int JDiff::buildFullIndexParallel (off_t &azPosOrg)
+{
+    const long llWrm = 2 * SMPSZE ;             // warm-up bytes before each slice
+    const long llRnd = miThrCnt * (long) IDXSLC ;  // bytes per round
+
+    jchar *lpBuf[2] ;           // round buffers (warm-up + round)
+    hkey  *lpKey ;              // selected keys, IDXSLC per thread
+    off_t *lpPos ;              // selected positions, IDXSLC per thread
+    rIdxSlc *lpSlc ;            // slices
+    std::thread *lpThr ;        // threads
+
+    JHashPos::rSmpSte lsSte ;   // collision strategy state
+    jchar *lpDta ;              // start of current round within buffer
+    off_t lzPos=0 ;             // position of current round within file
+    off_t lzSmp ;               // position of first sample of a slice
+    long  llOff ;               // offset of a slice within current round
+    long  llEnd ;               // end of a slice within current round
+    long  llLen ;               // number of bytes in current round
+    long  llNxt ;               // number of bytes in next round
+    long  llIdx ;
+    int   liSlc ;               // number of slices in current round
+    int   liIdx ;
+    int   liCur=0 ;             // current buffer
+    int   liRet=EOF ;
+
+    /* allocate */
+    lpBuf[0] = (jchar *) malloc(llWrm + llRnd) ;
+    lpBuf[1] = (jchar *) malloc(llWrm + llRnd) ;
+    lpKey = (hkey *) malloc(llRnd * sizeof(hkey)) ;
+    lpPos = (off_t *) malloc(llRnd * sizeof(off_t)) ;
+    lpSlc = new rIdxSlc[miThrCnt] ;
+    lpThr = new std::thread[miThrCnt] ;
+    if (lpBuf[0] == null || lpBuf[1] == null || lpKey == null || lpPos == null) {
+        liRet = EXI_MEM ;
+        llLen = 0 ;
+    } else {
+        for (liIdx = 0; liIdx < miThrCnt; liIdx++) {
+            lpSlc[liIdx].ipKey = &lpKey[liIdx * (long) IDXSLC] ;
+            lpSlc[liIdx].ipPos = &lpPos[liIdx * (long) IDXSLC] ;
+        }
+        gpHsh->getstate(lsSte) ;
+        llLen = readOrg(lpBuf[0] + llWrm, 0, llRnd) ;
+        if (llLen < 0) {
+            liRet = (int) llLen ;
+        }
+    }
+
+    while (llLen > 0) {
+        /* split round into slices */
+        lpDta = lpBuf[liCur] + llWrm ;
+        for (llOff = 0, liSlc = 0; llOff < llLen; llOff += IDXSLC, liSlc++) {
+            rIdxSlc &lrSlc = lpSlc[liSlc] ;
+            llEnd = (llOff + IDXSLC < llLen) ? llOff + IDXSLC : llLen ;
+            lzSmp = lzPos + llOff ;
+            lrSlc.ipBeg = lpDta + llOff - ((lzSmp < llWrm) ? lzSmp : llWrm) ;
+            if (lzSmp < SMPSZE - 1)
+                lzSmp = SMPSZE - 1 ;            // first sample after SMPSZE - 1 bytes
+            if (lzSmp > lzPos + llEnd)
+                lzSmp = lzPos + llEnd ;         // tiny file
+            lrSlc.izSmp = lzSmp ;
+            lrSlc.ipSmp = lpDta + (lzSmp - lzPos) ;
+            lrSlc.ipEnd = lpDta + llEnd ;
+            lrSlc.isSte = lsSte ;
+            if (gpHsh->get_anchors() < 0)
+                gpHsh->skip(lsSte, lrSlc.ipEnd - lrSlc.ipSmp) ;
+        }
+
+        /* hash slices in parallel */
+        for (liIdx = 0; liIdx < liSlc; liIdx++) {
+            lpThr[liIdx] = std::thread(&JDiff::indexSlice, this, std::ref(lpSlc[liIdx])) ;
+        }
+
+        /* meanwhile, read next round */
+        if (llLen == llRnd) {
+            memcpy(lpBuf[1 - liCur], lpDta + llLen - llWrm, llWrm) ;
+            llNxt = readOrg(lpBuf[1 - liCur] + llWrm, lzPos + llLen, llRnd) ;
+        } else {
+            llNxt = 0 ;
+        }
+
+        /* store samples in file order */
+        for (liIdx = 0; liIdx < liSlc; liIdx++) {
+            lpThr[liIdx].join() ;
+            for (llIdx = 0; llIdx < lpSlc[liIdx].ilCnt; llIdx++) {
+                if (gpHsh->get_anchors() >= 0)
+                    gpHsh->add(lpSlc[liIdx].ipKey[llIdx], lpSlc[liIdx].ipPos[llIdx], 0) ;    // keeps the load
+                else
+                    gpHsh->store(lpSlc[liIdx].ipKey[llIdx], lpSlc[liIdx].ipPos[llIdx]) ;
+            }
+        }
+
+        /* output position every 32MB */
+        if (miVerbse > 1 && ((lzPos + llLen) & ~PGSMSK) != (lzPos & ~PGSMSK)) {
+            fprintf(JDebug::stddbg, "\b\b\b\b\b\b\b\b\b\b\b\b\b\b%12" PRIzd "Mb", (lzPos + llLen) / PGSMRK);
+        }
+
+        /* next round */
+        lzPos += llLen ;
+        if (llNxt < 0) {
+            liRet = (int) llNxt ;
+            break ;
+        }
+        llLen = llNxt ;
+        liCur = 1 - liCur ;
+    }
+    if (gpHsh->get_anchors() < 0)
+        gpHsh->setstate(lsSte) ;
+    azPosOrg = lzPos ;
+
+    /* cleanup */
+    free(lpBuf[0]);
+    free(lpBuf[1]);
+    free(lpKey);
+    free(lpPos);
+    delete[] lpSlc ;
+    delete[] lpThr ;
+
+    return liRet ;
+} /* buildFullIndexParallel */
+#endif // JDIFF_THREADS
 
 } /* namespace */
@@ -28,6 +28,7 @@
  * - JDiff.h/cpp        The main JojoDiff class
  * - JHashPos.h/cpp     The hash table collection of (sample-key, position)
  * - JMatchTable.h/cpp  The matching table logic
+ * - JSuffixArray.h/cpp The suffix array, an exact alternative to the above two
  * - JDefs.h            Global definitions
  * - JDebug.h/cpp       Debugging definitions
  * - JOut.h             Abstract output class
@@ -58,6 +59,10 @@
  *
  * Method buildFullIndex scans the left file and creates the hash table.
  *
+ * With a suffix array (option -S), the hashtable and matching table are not
+ * used: method searchSuffix looks for the nearest position in the new file
+ * having a long enough exact match in the original file.
+ *
  * TODO: allow org and new files to be the same file
  * TODO: allow sequential files as input
  *
@@ -139,6 +144,7 @@
 #include "JFile.h"
 #include "JHashPos.h"
 #include "JMatchTable.h"
+#include "JSuffixArray.h"
 #include "JOut.h"
 
 namespace JojoDiff {
@@ -163,6 +169,12 @@ public:
      * @param aiMchMin  Minimum entries in matching table (default = 2)
      * @param aiAhdMax  Maximum bytes to find ahead (default = 256kB)
      * @param abCmpAll  Compare all matches or only buffered matches ? (default true)
+     * @param aiThrCnt  Number of threads for indexing the source file (default 1)
+     * @param aiAncBit  Content-defined anchors: mask bits, 0=automatic, -1=no anchors (default)
+     * @param abSfxArr  Search with a suffix array instead of the hashtable (default no)
+     * @param abHshBkt  Hashtable of cache-line sized buckets instead of flat arrays (default no)
+     * @param asIdxCch  Index cache file for the source file (default none)
+     * @param apHsh     Shared hashtable, already indexed on the same source file (default none)
      */
     JDiff(JFile * const apFilOrg, JFile * const apFilNew, JOut * const apOut,
         const int aiHshSze=8,
@@ -172,7 +184,13 @@ public:
         const int aiMchMax=1024,
         const int aiMchMin=2,
         const int aiAhdMax=256*1024,
-        const bool abCmpAll = true);
+        const bool abCmpAll = true,
+        const int aiThrCnt=1,
+        const int aiAncBit=-1,
+        const bool abSfxArr=false,
+        const bool abHshBkt=false,
+        const char * const asIdxCch=null,
+        JHashPos * const apHsh=null);
 
 	/**
 	 * Destroys JDiff object.
@@ -197,10 +215,23 @@ public:
 	*/
 	int jdiff ();
 
+	/**
+	* @brief Index the source file ahead of jdiff().
+	*
+	* Allows to share the hashtable with other JDiff instances on the same source
+	* file (see apHsh in the constructor). Does nothing if the source file is not
+	* to be prescanned or has already been indexed.
+	*
+	* @return 0 = ok, < 0 = error (see jdiff)
+	*/
+	int index ();
+
 	/* getters */
-	JHashPos * getHsh(){return gpHsh;};     /**< get jdiff's internal hash table */
-	JMatchTable * getMch(){return gpMch;};  /**< get jdiff's internal matching table */
+	JHashPos * getHsh(){return gpHsh;};     /**< get jdiff's internal hash table (null = suffix array) */
+	JSuffixArray * getSfx(){return mpSfx;}; /**< get jdiff's suffix array (null = none) */
+	JMatchTable * getMch(){return gpMch;};  /**< get jdiff's internal matching table (null = suffix array) */
 	int getHshErr(){return miHshErr;};      /**< get number of false hash hits */
+	int getHshHit(){return miHshHit;};      /**< get number of hash hits */
 
 private:
 
@@ -221,6 +252,30 @@ private:
 	  off_t &azAhd                  /* number of bytes to go before similarity is reached */
 	);
 
+	/**
+	 * @brief Finds the nearest equal regions between the two files using the suffix array.
+	 *
+	 * Same parameters and results as search.
+	 */
+	int searchSuffix (off_t const &azRedOrg, off_t const &azRedNew,
+	                  off_t &azSkpOrg, off_t &azSkpNew, off_t &azAhd) ;
+
+	/**
+	 * @brief Calculate the offsets to reach a found solution (for search).
+	 *
+	 * @param azRedOrg  in:  read position in original file
+	 * @param azRedNew  in:  read position in new file
+	 * @param azFndOrg  in:  position of the solution in original file
+	 * @param azFndNew  in:  position of the solution in new file
+	 * @param azBseOrg  in:  do not backtrace before this position
+	 * @param azSkpOrg  out: number of bytes to skip (delete) in original file
+	 * @param azSkpNew  out: number of bytes to skip (insert) in new file
+	 * @param azAhd     out: number of bytes to go ahead on both files
+	 */
+	void offsets (off_t const azRedOrg, off_t const azRedNew,
+	              off_t const azFndOrg, off_t const azFndNew, off_t const azBseOrg,
+	              off_t &azSkpOrg, off_t &azSkpNew, off_t &azAhd) const ;
+
 	/**
      * @brief The hash function
      *
@@ -240,17 +295,113 @@ private:
      */
     int buildFullIndex () ;
 
+    /**
+     * @brief Load the hashtable from the index cache file.
+     *
+     * The cache is only used when it has been built from the same source file
+     * (size, modification time and checksum) with the same index table size.
+     *
+     * @param azPosOrg  out: position of the end of the source file
+     * @return EXI_OK = loaded, other = cache not usable
+     */
+    int loadIndex (off_t &azPosOrg) ;
+
+    /**
+     * @brief Save the hashtable to the index cache file.
+     *
+     * @param azPosOrg  position of the end of the source file
+     * @return EXI_OK = saved, other = error
+     */
+    int saveIndex (off_t const azPosOrg) ;
+
+    /**
+     * @brief Identify the source file: size, modification time and checksum.
+     *
+     * @return EXI_OK, EXI_ERR when the source file cannot be identified
+     */
+    int identify (off_t &azSze, long long &alMtm, hkey &akChk) ;
+
+#ifdef JDIFF_THREADS
+    /**
+     * @brief Slice of the source file to be indexed by one thread.
+     */
+    typedef struct tIdxSlc {
+        jchar const *ipBeg ;        /**< first byte to hash (including warm-up)       */
+        jchar const *ipSmp ;        /**< first byte to sample                         */
+        jchar const *ipEnd ;        /**< end of the slice                             */
+        off_t izSmp ;               /**< file position of ipSmp                       */
+        JHashPos::rSmpSte isSte ;   /**< collision strategy state at ipSmp            */
+        hkey  *ipKey ;              /**< out: keys of the samples to store            */
+        off_t *ipPos ;              /**< out: positions of the samples to store       */
+        long ilCnt ;                /**< out: number of samples to store              */
+    } rIdxSlc ;
+
+    /**
+     * @brief Multi-threaded version of buildFullIndex.
+     *
+     * Fills the hashtable exactly as buildFullIndex does, but hashes slices
+     * of the source file in parallel.
+     *
+     * @param azPosOrg  out: position of the end of the source file
+     * @return EOF = ok, < EOF = error
+     */
+    int buildFullIndexParallel (off_t &azPosOrg) ;
+
+    /**
+     * @brief Hash and sample one slice of the source file (thread function).
+     */
+    void indexSlice (rIdxSlc &arSlc) const ;
+
+    /**
+     * @brief Copy bytes from the source file into a buffer.
+     *
+     * @return >= 0: number of bytes copied (less than alLen at EOF), < 0 error
+     */
+    long readOrg (jchar *apDst, off_t azPos, long alLen) ;
+#endif // JDIFF_THREADS
+
+	/**
+	 * @brief Count equal bytes using the buffers of both files.
+	 *
+	 * @param azPosOrg  position in original file
+	 * @param azPosNew  position in new file
+	 * @param azMax     maximum number of bytes to compare
+	 * @return number of equal bytes found within the buffers (may be less than the actual number)
+	 */
+	off_t scanEql(off_t const azPosOrg, off_t const azPosNew, off_t const azMax) const ;
+
+	/**
+	 * @brief Output a run of MOD or INS bytes using the buffers of both files.
+	 *
+	 * @param aiOpr     MOD: bytes that differ on both files, INS: bytes of the new file
+	 * @param azPosOrg  position in original file
+	 * @param azPosNew  position in new file
+	 * @param azMax     maximum number of bytes to output
+	 * @return number of bytes output (0 if the data is not within the buffers)
+	 */
+	off_t putRun(int const aiOpr, off_t const azPosOrg, off_t const azPosNew, off_t const azMax) const ;
+
 	/**
 	 * @brief Flush pending output
 	 */
 	void flushEql(const off_t &azPosOrg, const off_t &azPosNew, off_t &azEql, bool &abEql) const ;
 
+	/**
+	 * @brief Create the hashtable (unless shared) and the matching table.
+	 */
+	void newIndex() ;
+
 	/* Context */
 	JFile * const mpFilOrg ;    /**< Original file to read                      */
 	JFile * const mpFilNew ;    /**< New file to read                           */
 	JOut  * const mpOut ;       /**< Output handler                             */
 	JHashPos * gpHsh ;          /**< Hashtable containing hashes from mpFilOrg. */
+	bool mbHshOwn ;             /**< gpHsh is owned (not shared) ?              */
 	JMatchTable * gpMch ;       /**< Table of matches                           */
+	JSuffixArray * mpSfx ;      /**< Suffix array on mpFilOrg (null = none)     */
+	jchar * mpSfxBuf ;          /**< Data from mpFilNew for searchSuffix        */
+	off_t mzSfxBuf ;            /**< Position of mpSfxBuf in mpFilNew           */
+	long  mlSfxBuf ;            /**< Number of bytes in mpSfxBuf                */
 
 	/* Settings */
 	const int miVerbse;     /**< Vebosity level                                 */
@@ -260,6 +411,11 @@ private:
 	const int miAhdMax ;    /**< Max number of bytes to look ahead              */
     const bool mbCmpAll ;   /**< Compare all matches, even if data not in buffer? */
     int  miSrcScn;          /**< Prescan original file: 0=no, 1=yes, 2=done     */
+    const int miThrCnt ;    /**< Number of threads for indexing                 */
+    const char * const msIdxCch ;   /**< Index cache file (null = none)         */
+    const int miHshSze ;    /**< Hashtable size in MB                           */
+    const int miAncBit ;    /**< Anchor mask bits: -1=no anchors, 0=automatic   */
+    const bool mbHshBkt ;   /**< Hashtable of buckets ?                         */
 
     /* Search-ahead state */
 	off_t mzAhdOrg=0;       /**< Current ahead position on original file        */
@@ -277,6 +433,7 @@ private:
      * Statistics about operations
      */
     int miHshErr ;         /**< Number of false hash hits                       */
+    int miHshHit=0 ;       /**< Number of hash hits                             */
 
 }; // class JDiff
 
@@ -45,4 +45,38 @@ void JFile::chkSeq(){
     }
 }
 
+/**
+ * @brief Copy data at given position.
+ *
+ * By default, data is copied from the buffer (hard ahead) or byte by byte.
+ *
+ * @param   azPos   position to copy from
+ * @param   apDta   destination
+ * @param   alLen   number of bytes to copy
+ *
+ * @return  number of bytes copied, less than alLen at EOF or on error
+ */
+long JFile::read(const off_t azPos, jchar * const apDta, const long alLen) {
+    long llDne = 0 ;    /**< bytes copied       */
+    off_t lzLen ;       /**< bytes in buffer    */
+    jchar *lpBuf ;
+    int lcVal ;
+
+    while (llDne < alLen) {
+        lpBuf = getbuf(azPos + llDne, lzLen, HardAhead) ;
+        if (lpBuf != null) {
+            if (lzLen > alLen - llDne)
+                lzLen = alLen - llDne ;
+            memcpy(apDta + llDne, lpBuf, (size_t) lzLen) ;
+            llDne += (long) lzLen ;
+        } else {
+            lcVal = get(azPos + llDne, HardAhead) ;
+            if (lcVal < 0)
+                break ;
+            apDta[llDne++] = (jchar) lcVal ;
+        }
+    }
+    return llDne ;
+}
+
 } /* namespace */
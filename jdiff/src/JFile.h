@@ -61,6 +61,13 @@ public:
 	*/
     enum eAhead { Read, HardAhead, SoftAhead } ;
 
+	/**
+	* Access pattern hints:
+	* - Normal     = no specific access pattern (default)
+	* - Sequential = the whole file will be read from start to end (e.g. indexing)
+	*/
+    enum eAdvice { Normal, Sequential } ;
+
 	/**
 	 * @brief Get one byte at specified address and increment the address to the next byte.
 	 *
@@ -92,6 +99,36 @@ public:
         return get(mzPosRed, aiSft);
     } ;
 
+    /**
+     * @brief Return the position of the byte the next get() will return.
+     *
+     * @return  position, -1 after EOF
+     */
+    inline off_t getpos () const {
+        return mzPosRed ;
+    } ;
+
+    /**
+     * @brief Set the position of the byte the next get() will return.
+     *
+     * @param   azPos   position
+     */
+    inline void setpos (const off_t azPos) {
+        if (azPos != mzPosRed) {
+            mzPosRed = azPos ;
+            miRedSze = 0 ;      // next get goes through get_frombuffer
+        }
+    } ;
+
+    /**
+     * @brief Return the size of the file.
+     *
+     * @return  size, MAX_OFF_T when unknown (sequential file)
+     */
+    inline off_t geteof () const {
+        return mzPosEof ;
+    } ;
+
 	/**
 	 * @brief Set lookahead base: soft lookahead will fail when reading after base + buffer size
 	 *
@@ -118,6 +155,22 @@ public:
 	*/
 	virtual int get_fd() const { return -1 ; }
 
+	/**
+	* @brief Hint the expected access pattern (ignored by default).
+	*/
+	virtual void advise(const eAdvice aiAdv) { }
+
+	/**
+	* @brief Read ahead asynchronously, aiCnt blocks (ignored by default).
+	*/
+	virtual void prefetch(const int aiCnt) { }
+
+	/**
+	* @brief Announce a read of alLen bytes at azPos, so that it can be started
+	* asynchronously (ignored by default).
+	*/
+	virtual void readahead(const off_t azPos, const long alLen) { }
+
 	/**
 	 * @brief Return the position of the buffer
 	 *
@@ -145,6 +198,17 @@ public:
 	     return null ;
     }
 
+	/**
+	 * @brief Copy data at given position, avoiding changes to the buffer where possible.
+	 *
+	 * @param   azPos   position to copy from
+	 * @param   apDta   destination
+	 * @param   alLen   number of bytes to copy
+	 *
+	 * @return  number of bytes copied, less than alLen at EOF or when not possible
+	 */
+	virtual long read(const off_t azPos, jchar * const apDta, const long alLen) ;
+
 protected:
 
     /**
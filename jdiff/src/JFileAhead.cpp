@@ -24,9 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <exception>
-#if debug
 #include <string.h>
-#endif
 
 #include "JFileAhead.h"
 #include "JDebug.h"
@@ -84,9 +82,180 @@ JFileAhead::JFileAhead(char const * const asJid, const long alBufSze, const int
 }
 
 JFileAhead::~JFileAhead() {
+    prefetch_stop() ;
 	if (mpBuf != null) free(mpBuf) ;
+#ifdef JDIFF_THREADS
+	if (mpPft != null) free(mpPft) ;
+	if (miPftLen != null) free(miPftLen) ;
+#endif // JDIFF_THREADS
+}
+
+/**
+ * @brief Read ahead asynchronously: keep up to aiCnt blocks in flight on a
+ * background thread, ahead of the sequential read position.
+ *
+ * The thread only reads blocks of miBlkSze bytes following the last block read,
+ * so it never changes what is in the buffer: get_fromfile decides what to read
+ * exactly as before and takes the blocks from the read-ahead thread instead of
+ * from the file. Seeks pause the thread and discard its blocks.
+ *
+ * Without JDIFF_THREADS, reading stays synchronous.
+ *
+ * @param   aiCnt   number of blocks to read ahead, 0 = read synchronously
+ */
+void JFileAhead::prefetch(const int aiCnt) {
+#ifdef JDIFF_THREADS
+    if (miPftCnt > 0 || aiCnt <= 0)
+        return ;    // can only be set once, before reading
+
+    mpPft = (jchar *) malloc((size_t) aiCnt * miBlkSze) ;
+    miPftLen = (int *) malloc(aiCnt * sizeof(int)) ;
+    if (mpPft == null || miPftLen == null) {
+        // not fatal: read synchronously
+        if (mpPft != null) free(mpPft) ;
+        if (miPftLen != null) free(miPftLen) ;
+        mpPft = null ;
+        miPftLen = null ;
+        return ;
+    }
+    miPftCnt = aiCnt ;
+    mbPftRun = true ;   // the thread is started on the first read
+#endif // JDIFF_THREADS
+}
+
+/**
+ * @brief Stop the read-ahead thread.
+ */
+void JFileAhead::prefetch_stop() {
+#ifdef JDIFF_THREADS
+    if (moPftThr.joinable()) {
+        {
+            std::lock_guard<std::mutex> loLck(moPftMtx) ;
+            mbPftStp = true ;
+        }
+        moPftCnd.notify_all() ;
+        moPftThr.join() ;
+    }
+    mbPftRun = false ;
+#endif // JDIFF_THREADS
 }
 
+#ifdef JDIFF_THREADS
+/**
+ * @brief Read-ahead thread: fill free blocks while running.
+ *
+ * The file is only read outside the lock, while mbPftBsy is set: ufSeek waits
+ * for that read to complete before touching the file itself.
+ */
+void JFileAhead::ufPftRun() {
+    std::unique_lock<std::mutex> loLck(moPftMtx) ;
+    int liSlt ;     /**< block to fill      */
+    size_t liDne ;  /**< bytes read         */
+
+    for (;;) {
+        moPftCnd.wait(loLck, [this]{
+            return mbPftStp || (mbPftRun && ! mbPftEnd && miPftNum < miPftCnt) ; }) ;
+        if (mbPftStp)
+            break ;
+
+        liSlt = (miPftHed + miPftNum) % miPftCnt ;
+        mbPftBsy = true ;
+        loLck.unlock() ;
+        liDne = jread(mpPft + (size_t) liSlt * miBlkSze, miBlkSze) ;
+        loLck.lock() ;
+        mbPftBsy = false ;
+
+        miPftLen[liSlt] = (int) liDne ;
+        miPftNum++ ;
+        if (liDne < (size_t) miBlkSze)
+            mbPftEnd = true ;
+        moPftCnd.notify_all() ;
+    }
+} /* ufPftRun */
+#endif // JDIFF_THREADS
+
+/**
+ * @brief Seek the file, pausing the read-ahead thread.
+ *
+ * @param azPos      position to seek to
+ * @param abPft      resume read-ahead from azPos (true) or read synchronously (false)
+ * @return EXI_OK or EXI_SEK
+ */
+int JFileAhead::ufSeek(const off_t azPos, const bool abPft) {
+    mbSekInp = false ;
+#ifdef JDIFF_THREADS
+    if (miPftCnt > 0) {
+        int liRet ;
+        std::unique_lock<std::mutex> loLck(moPftMtx) ;
+
+        // pause and discard the blocks read ahead
+        mbPftRun = false ;
+        moPftCnd.wait(loLck, [this]{ return ! mbPftBsy ; }) ;
+        miPftHed = 0 ;
+        miPftNum = 0 ;
+        miPftOff = 0 ;
+        mbPftEnd = false ;
+
+        liRet = jseek(azPos) ;
+        if (abPft && liRet == EXI_OK) {
+            mbPftRun = true ;
+            loLck.unlock() ;
+            moPftCnd.notify_all() ;
+        }
+        return liRet ;
+    }
+#endif // JDIFF_THREADS
+    return jseek(azPos) ;
+} /* ufSeek */
+
+/**
+ * @brief Read from the read-ahead blocks, or from the file when paused.
+ *
+ * @param apDta     buffer to read into
+ * @param aiLen     number of bytes to read
+ * @return number of bytes read, less than aiLen on EOF
+ */
+size_t JFileAhead::ufRead(jchar * const apDta, const size_t aiLen) {
+#ifdef JDIFF_THREADS
+    if (mbPftRun) {
+        std::unique_lock<std::mutex> loLck(moPftMtx) ;
+        size_t liDne = 0 ;  /**< bytes read         */
+        size_t liLen ;      /**< bytes to take      */
+        int liLst ;         /**< last block taken   */
+
+        if (! moPftThr.joinable())
+            moPftThr = std::thread(&JFileAhead::ufPftRun, this) ;
+
+        while (liDne < aiLen) {
+            moPftCnd.wait(loLck, [this]{ return miPftNum > 0 || mbPftEnd ; }) ;
+            if (miPftNum == 0)
+                break ;     // EOF or read error
+
+            // Take data from the first block: this block belongs to us
+            liLen = miPftLen[miPftHed] - miPftOff ;
+            if (liLen > aiLen - liDne)
+                liLen = aiLen - liDne ;
+            memcpy(apDta + liDne, mpPft + (size_t) miPftHed * miBlkSze + miPftOff, liLen) ;
+            liDne += liLen ;
+            miPftOff += liLen ;
+
+            // Release the block when done
+            if (miPftOff == miPftLen[miPftHed]) {
+                liLst = miPftLen[miPftHed] ;
+                miPftHed = (miPftHed + 1) % miPftCnt ;
+                miPftNum-- ;
+                miPftOff = 0 ;
+                moPftCnd.notify_all() ;
+                if (liLst < miBlkSze)
+                    break ; // EOF
+            }
+        }
+        return liDne ;
+    }
+#endif // JDIFF_THREADS
+    return jread(apDta, aiLen) ;
+} /* ufRead */
+
 /**
  * @brief Return number of seeks performed.
  */
@@ -125,6 +294,56 @@ void JFileAhead::set_lookahead_base (
     mzPosBse = azBse ;
 }
 
+/**
+ * @brief Copy data at given position without changing the buffer.
+ *
+ * Data is copied from the buffer when it is all there. Otherwise, it is read
+ * directly from the file, which is only positioned back at the end of the
+ * buffer when the buffer needs more data (so that a series of reads costs one
+ * seek each). Sequential files can only copy from the buffer.
+ *
+ * @param   azPos   position to copy from
+ * @param   apDta   destination
+ * @param   alLen   number of bytes to copy
+ *
+ * @return  number of bytes copied, less than alLen at EOF or on a sequential file
+ */
+long JFileAhead::read(const off_t azPos, jchar * const apDta, const long alLen) {
+    long llDne = 0 ;    /**< bytes copied       */
+    off_t lzLen ;       /**< bytes in buffer    */
+    jchar *lpBuf ;
+    size_t liRed ;
+
+    if (azPos >= mzPosInp - miBufUsd && (azPos + alLen <= mzPosInp || mbSeq)) {
+        // copy from the buffer (getbuf does not read within the buffer)
+        while (llDne < alLen && azPos + llDne < mzPosInp) {
+            lpBuf = getbuf(azPos + llDne, lzLen, Read) ;
+            if (lpBuf == null)
+                break ;
+            if (lzLen > alLen - llDne)
+                lzLen = alLen - llDne ;
+            memcpy(apDta + llDne, lpBuf, (size_t) lzLen) ;
+            llDne += (long) lzLen ;
+        }
+        return llDne ;
+    }
+    if (mbSeq || azPos >= mzPosEof)
+        return 0 ;
+
+    // read from the file, get back to the end of the buffer later on
+    if (ufSeek(azPos, false) != EXI_OK)
+        return 0 ;
+    mlFabSek++ ;
+    mbSekInp = true ;
+    while (llDne < alLen) {
+        liRed = ufRead(apDta + llDne, (size_t) (alLen - llDne)) ;
+        if (liRed == 0)
+            break ;
+        llDne += (long) liRed ;
+    }
+    return llDne ;
+}
+
 /**
  * Tries to get data from the buffer. Calls get_outofbuffer if that is not possible.
  * @param azPos     position to read from
@@ -166,12 +385,12 @@ int JFileAhead::get_frombuffer (
             int liDne ;
             int liCmp ;
             int liLen ;
-            jseek(azPos) ;
+            ufSeek(azPos, false) ;
             if (lzLen > (off_t) sizeof(lcTst))
                 liLen = sizeof(lcTst);
             else
                 liLen = lzLen ;
-            liDne = jread(lcTst, liLen) ;
+            liDne = ufRead(lcTst, liLen) ;
             if (liDne != liLen){
                 fprintf(JDebug::stddbg, "JFileAhead(%s," P8zd ",%d)->%c=%2x (mem %p): len-error !\n",
                    msJid, azPos, aiSft, *lpDta, *lpDta, lpDta );
@@ -181,7 +400,7 @@ int JFileAhead::get_frombuffer (
                 fprintf(JDebug::stddbg, "JFileAhead(%s," P8zd ",%d)->%c=%2x (mem %p): buf-error !\n",
                    msJid, azPos, aiSft, *lpDta, *lpDta, lpDta );
             }
-            jseek(mzPosInp);
+            ufSeek(mzPosInp, true);
 	    }
 	    #endif
 
@@ -273,6 +492,10 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
     eBufOpr liSek ;         /**< buffer logic operation type    */
     int liDne ;             /**< number of bytes read           */
 
+    // The buffer is about to change: the data after the read cursor of get
+    // may be overwritten when getbuf is called directly.
+    miRedSze = 0 ;
+
     /* Preparation: Check what should be done and set liSek accordingly */
     if (azPos < mzPosInp - miBufUsd ) {
         // Reading before the start of the buffer:
@@ -322,7 +545,7 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
         miBufUsd = 0 ;
 
         // Seek
-        if (jseek(mzPosInp) != EXI_OK)
+        if (ufSeek(mzPosInp, true) != EXI_OK)
             return SeekError ;
         mlFabSek++ ;
 
@@ -333,6 +556,12 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
     break ;
 
     case Append:
+        // Get back to the end of the buffer after a read elsewhere
+        if (mbSekInp) {
+            if (ufSeek(mzPosInp, true) != EXI_OK)
+                return SeekError ;
+            mlFabSek++ ;
+        }
         liDne = readblocks(mpInp, mzPosInp, azPos);
         if (liDne == EOF)
             return EndOfFile ;
@@ -357,8 +586,8 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
             mpInp    = lpInp ;
         }
 
-        // Seek
-        if (jseek(lzPos) != EXI_OK)
+        // Seek: read synchronously what is scrolled back
+        if (ufSeek(lzPos, false) != EXI_OK)
             return SeekError ;
         mlFabSek++ ;
 
@@ -375,8 +604,8 @@ JFileAhead::eBufDne JFileAhead::get_fromfile (
             return ReadError ;
         }
 
-        // @Seek
-        if (jseek(mzPosInp) != EXI_OK)
+        // @Seek: and read ahead again from there
+        if (ufSeek(mzPosInp, true) != EXI_OK)
             return SeekError ;
         mlFabSek++ ;
         } // scrollback
@@ -404,7 +633,7 @@ int JFileAhead::readblocks(jchar* &apInp, off_t &azInp, off_t const azEnd)
             liTdo = mpMax - apInp ;
 
         // Read
-        liDne = jread(apInp, liTdo) ;
+        liDne = ufRead(apInp, liTdo) ;
 
         // Update buffer vars
         apInp    += liDne ;
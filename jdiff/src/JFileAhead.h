@@ -28,6 +28,12 @@ using namespace std;
 #include "JDefs.h"
 #include "JFile.h"
 
+#ifdef JDIFF_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif // JDIFF_THREADS
+
 namespace JojoDiff {
 /**
  * Buffered JFile access: optimized buffering logic for the specific way JDiff
@@ -84,6 +90,23 @@ public:
      */
     long seekcount() const ;
 
+    /**
+     * @brief Read ahead asynchronously: keep up to aiCnt blocks in flight on a
+     * background thread, ahead of the sequential read position.
+     *
+     * @param   aiCnt   number of blocks to read ahead, 0 = read synchronously
+     */
+    virtual void prefetch(const int aiCnt) ;
+
+	/**
+	 * @brief Copy data at given position without changing the buffer.
+	 *
+	 * Data that is not buffered is read directly from the file.
+	 *
+	 * @return  number of bytes copied, less than alLen at EOF or on a sequential file
+	 */
+	virtual long read(const off_t azPos, jchar * const apDta, const long alLen) ;
+
 
 protected:
 
@@ -108,6 +131,14 @@ protected:
     * @param >= 0: number of bytes read
     */
     virtual size_t jread(jchar * const ptr, const size_t count) = 0 ;
+
+    /**
+    * @brief Stop the read-ahead thread.
+    *
+    * Subclasses must call this in their destructor, before the file they
+    * read from (jread) goes away.
+    */
+    void prefetch_stop() ;
 
 
 private:
@@ -156,6 +187,27 @@ private:
         const off_t azEnd   /* end position     */
     );
 
+    /**
+    * @brief Seek the file, pausing the read-ahead thread.
+    * @param azPos      position to seek to
+    * @param abPft      resume read-ahead from azPos (true) or read synchronously (false)
+    * @return EXI_OK or EXI_SEK
+    */
+    int ufSeek(const off_t azPos, const bool abPft) ;
+
+    /**
+    * @brief Read from the read-ahead blocks, or from the file when paused.
+    * @return number of bytes read, less than aiLen on EOF
+    */
+    size_t ufRead(jchar * const apDta, const size_t aiLen) ;
+
+#ifdef JDIFF_THREADS
+    /**
+    * @brief Read-ahead thread: fill free blocks while running.
+    */
+    void ufPftRun() ;
+#endif // JDIFF_THREADS
+
 private:
     /* Settings */
     long mlBufSze;      /**< File lookahead buffer size                   */
@@ -167,6 +219,24 @@ private:
     jchar *mpMax=null;  /**< read-ahead buffer end                        */
     jchar *mpInp=null;  /**< current position in buffer                   */
     off_t mzPosBse=0;   /**< base position for soft reading               */
+    bool mbSekInp=false;/**< file is not positioned at mzPosInp (see read) */
+
+#ifdef JDIFF_THREADS
+    /* Read-ahead state, shared with the read-ahead thread (under moPftMtx) */
+    int miPftCnt=0;     /**< number of read-ahead blocks, 0 = none        */
+    jchar *mpPft=null;  /**< read-ahead blocks                            */
+    int *miPftLen=null; /**< bytes read into each block                   */
+    int miPftHed=0;     /**< first filled block                           */
+    int miPftNum=0;     /**< number of filled blocks                      */
+    int miPftOff=0;     /**< bytes already taken from the first block     */
+    bool mbPftRun=false;/**< read ahead (true) or read synchronously      */
+    bool mbPftBsy=false;/**< read-ahead thread is reading                 */
+    bool mbPftEnd=false;/**< read-ahead thread reached EOF                */
+    bool mbPftStp=false;/**< read-ahead thread must stop                  */
+    std::thread moPftThr;
+    std::mutex moPftMtx;
+    std::condition_variable moPftCnd;
+#endif // JDIFF_THREADS
 };
 }/* namespace */
 #endif /* JFileAhead_H_ */
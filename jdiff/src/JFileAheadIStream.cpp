@@ -32,7 +32,7 @@ JFileAheadIStream::JFileAheadIStream(istream &apFil, char const * const asFid,
 
 JFileAheadIStream::~JFileAheadIStream()
 {
-    //dtor
+    prefetch_stop() ;   // before the file goes away
 }
 
 /**
@@ -32,7 +32,7 @@ JFileAheadStdio::JFileAheadStdio(FILE * const apFil, char const * const asFid,
 
 JFileAheadStdio::~JFileAheadStdio()
 {
-    //dtor
+    prefetch_stop() ;   // before the file goes away
 }
 
 /**
@@ -0,0 +1,149 @@
+/*
+ * JFileMmap.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JDefs.h"
+#include "JFileMmap.h"
+
+#ifdef JDIFF_MMAP
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief Map a file into memory.
+ *
+ * Only regular files are mapped. Check is_mapped() afterwards and fall back
+ * to another JFile if the file could not be mapped.
+ */
+JFileMmap::JFileMmap(int const aiFd, char const * const asJid)
+: JFile(asJid, false)
+, miFd(aiFd)
+{
+    void *lpMap ;
+
+    mzPosEof = jeofpos() ;
+    if (mzPosEof < 0) {
+        mzPosEof = MAX_OFF_T ;
+        mbSeq = true ;
+    } else if ((off_t) (size_t) mzPosEof != mzPosEof) {
+        // too large for the address space
+    } else if (mzPosEof == 0) {
+        // nothing to map
+        mbMap = true ;
+    } else {
+        lpMap = mmap(null, (size_t) mzPosEof, PROT_READ, MAP_PRIVATE, miFd, 0) ;
+        if (lpMap != MAP_FAILED) {
+            mpMap = (jchar *) lpMap ;
+            mbMap = true ;
+        }
+    }
+
+#if debug
+    if (JDebug::gbDbg[DBGBUF])
+        fprintf(JDebug::stddbg, "JFileMmap(%s):(map=%p,eof=" P8zd ",mapped=%d)\n",
+                asJid, mpMap, mzPosEof, mbMap);
+#endif
+}
+
+JFileMmap::~JFileMmap()
+{
+    if (mpMap != null)
+        munmap(mpMap, (size_t) mzPosEof) ;
+}
+
+/**
+ * @brief Return EOF position: size of a regular file.
+ */
+off_t JFileMmap::jeofpos() {
+    struct stat lsSta ;
+    if (fstat(miFd, &lsSta) != 0 || ! S_ISREG(lsSta.st_mode))
+        return EXI_SEK ;
+    return lsSta.st_size ;
+}
+
+/**
+ * @brief Set lookahead base: has no effect as all data is available.
+ */
+void JFileMmap::set_lookahead_base (const off_t azBse) {
+}
+
+/**
+ * @brief Hint the expected access pattern to the kernel.
+ */
+void JFileMmap::advise(const eAdvice aiAdv) {
+    if (mpMap == null)
+        return ;
+    madvise(mpMap, (size_t) mzPosEof, (aiAdv == Sequential) ? MADV_SEQUENTIAL : MADV_NORMAL) ;
+}
+
+/**
+ * @brief Get access to the mapping.
+ *
+ * @param   azPos   in:  position to get access to
+ * @param   azLen   out: number of bytes available, EOF when azPos is beyond EOF
+ * @param   aiSft   in:  0=read, 1=hard read ahead, 2=soft read ahead
+ *
+ * @return  buffer, null = azPos beyond EOF
+ */
+jchar * JFileMmap::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft) {
+    if (azPos >= mzPosEof || azPos < 0) {
+        azLen = EOF ;
+        return null ;
+    }
+    azLen = mzPosEof - azPos ;
+    return mpMap + azPos ;
+}
+
+/**
+ * @brief Get data from the mapping and prepare JFile::get for the next positions.
+ *
+ * @param azPos     position to read from
+ * @param aiSft     0=read, 1=hard ahead, 2=soft ahead
+ * @return data at requested position or EOF.
+ */
+int JFileMmap::get_frombuffer (
+    const off_t azPos,     /* position to read from                */
+    const eAhead aiSft     /* 0=read, 1=hard ahead, 2=soft ahead   */
+){
+    if (azPos >= mzPosEof || azPos < 0) {
+        mzPosRed = -1 ;
+        mpRed = null ;
+        miRedSze = 0 ;
+        return EOF ;
+    }
+
+    // prepare next reading position
+    mzPosRed = azPos + 1 ;
+    mpRed = mpMap + azPos + 1 ;
+    if (mzPosEof - mzPosRed > (off_t) LONG_MAX)
+        miRedSze = LONG_MAX ;
+    else
+        miRedSze = (long) (mzPosEof - mzPosRed) ;
+
+    return mpMap[azPos] ;
+}
+
+} /* namespace */
+#endif // JDIFF_MMAP
@@ -0,0 +1,125 @@
+/*
+ * JFileMmap.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JFILEMMAP_H_
+#define JFILEMMAP_H_
+
+#include "JDefs.h"
+#include "JFile.h"
+
+#ifdef JDIFF_MMAP
+namespace JojoDiff {
+
+/**
+ * @brief Memory mapped JFile access: the whole file is mapped into memory.
+ *
+ * The mapping acts as one big buffer: get never misses, getbuf returns pointers
+ * straight into the mapping and no seeks are needed. Only usable on regular
+ * (seekable) files, check is_mapped() after construction.
+ */
+class JFileMmap : public JFile
+{
+    JFileMmap(JFileMmap const&) = delete;
+    JFileMmap& operator=(JFileMmap const&) = delete;
+
+public:
+    /**
+     * @brief Map a file into memory.
+     *
+     * @param aiFd      file descriptor, opened for reading (not closed by JFileMmap)
+     * @param asJid     JFile-id: Org for source file, New for destination file
+     */
+    JFileMmap(int const aiFd, char const * const asJid);
+
+    /** Unmap the file */
+    virtual ~JFileMmap();
+
+    /**
+     * @brief Return whether the file could be mapped.
+     */
+    bool is_mapped() const { return mbMap ; }
+
+	 /**
+	 * @brief Get access to (fast) buffered read: a pointer into the mapping.
+	 *
+	 * @param   azPos   in:  position to get access to
+	 * @param   azLen   out: number of bytes available, EOF when azPos is beyond EOF
+	 * @param   aiSft   in:  0=read, 1=hard read ahead, 2=soft read ahead
+	 *
+	 * @return  buffer, null = azPos beyond EOF
+	 */
+	virtual jchar *getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft = Read) ;
+
+	/**
+	 * @brief Set lookahead base: has no effect as all data is available.
+	 */
+	virtual void set_lookahead_base (
+	    const off_t azBse	/* new base position for soft lookahead */
+	) ;
+
+	/**
+	 * @brief Hint the expected access pattern to the kernel (madvise).
+	 */
+	virtual void advise(const eAdvice aiAdv) ;
+
+	/**
+	 * @brief Return the position of the buffer: the whole file is buffered.
+	 */
+	virtual off_t getBufPos() { return 0 ; }
+
+	/**
+	 * @brief Return the size of the buffer: the size of the file.
+	 */
+	virtual long getBufSze() { return (long) mzPosEof ; }
+
+	/**
+	* @brief Get underlying file descriptor.
+	*/
+	virtual int get_fd() const { return miFd ; }
+
+protected:
+    /**
+    * @brief Return EOF position
+    *
+    * @return >= 0: EOF position, EXI_SEK in case of error
+    */
+    virtual off_t jeofpos() ;
+
+    /**
+     * @brief Get data from the mapping.
+     *
+     * @param azPos		position to read from
+     * @param aiSft		0=read, 1=hard ahead, 2=soft ahead
+     * @return data at requested position or EOF.
+     */
+    virtual int get_frombuffer(
+        const off_t azPos,    /* position to read from                */
+        const eAhead aiSft    /* 0=read, 1=hard ahead, 2=soft ahead   */
+    ) ;
+
+private:
+    int const miFd ;            /**< file descriptor                    */
+    jchar *mpMap=null ;         /**< start of the mapping               */
+    bool mbMap=false ;          /**< file has been mapped ?             */
+};
+} /* namespace */
+#endif // JDIFF_MMAP
+#endif /* JFILEMMAP_H_ */
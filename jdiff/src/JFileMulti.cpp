@@ -0,0 +1,226 @@
+/*
+ * JFileMulti.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+
+#include "JDefs.h"
+#include "JDebug.h"
+#include "JFileMulti.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief Concatenate files: the start position of each file is the sum of
+ * the sizes of the files before it.
+ */
+JFileMulti::JFileMulti(JFile * const * const apPrt, int const aiCnt, char const * const asJid)
+: JFile(asJid, false)
+{
+    off_t lzBeg = 0 ;
+    for (int liPrt = 0; liPrt < aiCnt; liPrt++) {
+        mpPrt.push_back(apPrt[liPrt]) ;
+        mzBeg.push_back(lzBeg) ;
+        mbRes.push_back(apPrt[liPrt]->getBufPos() == 0
+                     && apPrt[liPrt]->getBufSze() >= apPrt[liPrt]->geteof()) ;
+        if (apPrt[liPrt]->isSequential())
+            mbSeq = true ;
+        else
+            lzBeg += apPrt[liPrt]->geteof() ;
+    }
+    mzBeg.push_back(lzBeg) ;
+    mzPosEof = (mbSeq ? MAX_OFF_T : jeofpos()) ;
+
+#if debug
+    if (JDebug::gbDbg[DBGBUF])
+        fprintf(JDebug::stddbg, "JFileMulti(%s):(files=%d,eof=" P8zd ",seq=%d)\n",
+                asJid, aiCnt, mzPosEof, mbSeq);
+#endif
+}
+
+JFileMulti::~JFileMulti()
+{
+    for (size_t liPrt = 0; liPrt < mpPrt.size(); liPrt++)
+        delete mpPrt[liPrt] ;
+}
+
+/**
+ * @brief Return EOF position: sum of the file sizes.
+ */
+off_t JFileMulti::jeofpos() {
+    return mzBeg.back() ;
+}
+
+/**
+ * @brief Find the file holding a position, starting with the last one accessed.
+ */
+int JFileMulti::ufPrt(const off_t azPos) {
+    int liLow, liHig, liMid ;
+
+    if (azPos >= mzBeg[miPrt] && azPos < mzBeg[miPrt + 1])
+        return miPrt ;
+    if (azPos < 0 || azPos >= mzBeg.back())
+        return -1 ;
+
+    // binary search for the last file starting at or before azPos
+    liLow = 0 ;
+    liHig = (int) mpPrt.size() - 1 ;
+    while (liLow < liHig) {
+        liMid = (liLow + liHig + 1) / 2 ;
+        if (mzBeg[liMid] <= azPos)
+            liLow = liMid ;
+        else
+            liHig = liMid - 1 ;
+    }
+    miPrt = liLow ;
+    return miPrt ;
+}
+
+/**
+ * @brief Get access to buffered read, up to the end of the file holding azPos.
+ */
+jchar * JFileMulti::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft) {
+    int liPrt = ufPrt(azPos) ;
+    jchar *lpBuf ;
+
+    if (liPrt < 0) {
+        azLen = EOF ;
+        return null ;
+    }
+    ufRedClr(liPrt) ;
+    lpBuf = mpPrt[liPrt]->getbuf(azPos - mzBeg[liPrt], azLen, aiSft) ;
+    if (lpBuf != null && azLen > mzBeg[liPrt + 1] - azPos)
+        azLen = mzBeg[liPrt + 1] - azPos ;
+    return lpBuf ;
+}
+
+/**
+ * @brief Copy data at given position, file by file.
+ */
+long JFileMulti::read(const off_t azPos, jchar * const apDta, const long alLen) {
+    long llDne = 0 ;    /**< bytes copied           */
+    long llLen ;        /**< bytes to copy from file */
+    long llRed ;        /**< bytes copied from file  */
+    int liPrt ;
+
+    while (llDne < alLen) {
+        liPrt = ufPrt(azPos + llDne) ;
+        if (liPrt < 0)
+            break ;
+        ufRedClr(liPrt) ;
+        llLen = alLen - llDne ;
+        if (llLen > mzBeg[liPrt + 1] - azPos - llDne)
+            llLen = (long) (mzBeg[liPrt + 1] - azPos - llDne) ;
+        llRed = mpPrt[liPrt]->read(azPos + llDne - mzBeg[liPrt], apDta + llDne, llLen) ;
+        llDne += llRed ;
+        if (llRed < llLen)
+            break ;
+    }
+    return llDne ;
+}
+
+/**
+ * @brief Get data from the file holding azPos and prepare JFile::get for the
+ * next positions within the same buffer.
+ */
+int JFileMulti::get_frombuffer (
+    const off_t azPos,     /* position to read from                */
+    const eAhead aiSft     /* 0=read, 1=hard ahead, 2=soft ahead   */
+){
+    int liPrt = ufPrt(azPos) ;
+    jchar *lpBuf ;
+    off_t lzLen ;
+
+    mzPosRed = -1 ;
+    mpRed = null ;
+    miRedSze = 0 ;
+    if (liPrt < 0)
+        return EOF ;
+
+    lpBuf = mpPrt[liPrt]->getbuf(azPos - mzBeg[liPrt], lzLen, aiSft) ;
+    if (lpBuf == null) {
+        // no buffer (or EOB, EOF): read byte by byte
+        return mpPrt[liPrt]->get(azPos - mzBeg[liPrt], aiSft) ;
+    }
+    if (lzLen > mzBeg[liPrt + 1] - azPos)
+        lzLen = mzBeg[liPrt + 1] - azPos ;
+
+    // prepare next reading position
+    miRedPrt = liPrt ;
+    mzPosRed = azPos + 1 ;
+    mpRed = lpBuf + 1 ;
+    miRedSze = (lzLen - 1 > (off_t) LONG_MAX) ? LONG_MAX : (long) (lzLen - 1) ;
+
+    return *lpBuf ;
+}
+
+/**
+ * @brief Set lookahead base: the base within its own file, following files
+ * from their start.
+ */
+void JFileMulti::set_lookahead_base (const off_t azBse) {
+    for (size_t liPrt = 0; liPrt < mpPrt.size(); liPrt++) {
+        if (azBse < mzBeg[liPrt + 1]) {
+            ufRedClr((int) liPrt) ;
+            mpPrt[liPrt]->set_lookahead_base(azBse > mzBeg[liPrt] ? azBse - mzBeg[liPrt] : 0) ;
+        }
+    }
+}
+
+/**
+ * @brief Return number of seek operations performed on all files.
+ */
+long JFileMulti::seekcount() {
+    long llSek = 0 ;
+    for (size_t liPrt = 0; liPrt < mpPrt.size(); liPrt++)
+        llSek += mpPrt[liPrt]->seekcount() ;
+    return llSek ;
+}
+
+/**
+ * @brief Hint the expected access pattern to all files.
+ */
+void JFileMulti::advise(const eAdvice aiAdv) {
+    for (size_t liPrt = 0; liPrt < mpPrt.size(); liPrt++)
+        mpPrt[liPrt]->advise(aiAdv) ;
+}
+
+/**
+ * @brief Read ahead asynchronously on all files.
+ */
+void JFileMulti::prefetch(const int aiCnt) {
+    for (size_t liPrt = 0; liPrt < mpPrt.size(); liPrt++)
+        mpPrt[liPrt]->prefetch(aiCnt) ;
+}
+
+/**
+ * @brief Announce a read, limited to the file holding azPos.
+ */
+void JFileMulti::readahead(const off_t azPos, const long alLen) {
+    int liPrt = ufPrt(azPos) ;
+    if (liPrt < 0)
+        return ;
+    if (alLen > mzBeg[liPrt + 1] - azPos)
+        mpPrt[liPrt]->readahead(azPos - mzBeg[liPrt], (long) (mzBeg[liPrt + 1] - azPos)) ;
+    else
+        mpPrt[liPrt]->readahead(azPos - mzBeg[liPrt], alLen) ;
+}
+
+} /* namespace */
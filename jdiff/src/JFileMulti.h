@@ -0,0 +1,160 @@
+/*
+ * JFileMulti.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JFILEMULTI_H_
+#define JFILEMULTI_H_
+
+#include <vector>
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+const int MULMAXSRC = 16 ;      /* maximum number of source files in a JFileMulti  */
+
+/**
+ * @brief Several source files seen as one: the files are laid out one after
+ * the other, so that position azPos of file i is found at its start position
+ * getbeg(i) plus azPos.
+ *
+ * The index, the matching table and the patch format thus address all source
+ * files with one offset, a jump from one file to another being an ordinary
+ * DEL or BKT operation. The same files, in the same order, are needed to undiff.
+ * All files have to be seekable.
+ */
+class JFileMulti : public JFile
+{
+    JFileMulti(JFileMulti const&) = delete;
+    JFileMulti& operator=(JFileMulti const&) = delete;
+
+public:
+    /**
+     * @brief Concatenate files, which are deleted together with the JFileMulti.
+     *
+     * @param apPrt     files, in order
+     * @param aiCnt     number of files
+     * @param asJid     JFile-id: Org for source file
+     */
+    JFileMulti(JFile * const * const apPrt, int const aiCnt, char const * const asJid);
+
+    /** Delete the files */
+    virtual ~JFileMulti();
+
+    /**
+     * @brief Return the number of files.
+     */
+    int getcnt() const { return (int) mpPrt.size() ; }
+
+    /**
+     * @brief Return the start position of file aiPrt.
+     */
+    off_t getbeg(int const aiPrt) const { return mzBeg[aiPrt] ; }
+
+	 /**
+	 * @brief Get access to (fast) buffered read, within one file.
+	 *
+	 * @param   azPos   in:  position to get access to
+	 * @param   azLen   out: number of bytes in buffer, up to the end of the file
+	 * @param   aiSft   in:  0=read, 1=hard read ahead, 2=soft read ahead
+	 *
+	 * @return  buffer, null = azPos not in buffer or no buffer
+	 */
+	virtual jchar *getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft = Read) ;
+
+	/**
+	 * @brief Copy data at given position, across files.
+	 */
+	virtual long read(const off_t azPos, jchar * const apDta, const long alLen) ;
+
+	/**
+	 * @brief Set lookahead base on all files: the file holding the base position
+	 * gets the base itself, following files their start.
+	 */
+	virtual void set_lookahead_base (
+	    const off_t azBse	/* new base position for soft lookahead */
+	) ;
+
+	/**
+	 * @brief Return number of seek operations performed on all files.
+	 */
+	virtual long seekcount() ;
+
+	/**
+	* @brief Hint the expected access pattern to all files.
+	*/
+	virtual void advise(const eAdvice aiAdv) ;
+
+	/**
+	* @brief Read ahead asynchronously on all files.
+	*/
+	virtual void prefetch(const int aiCnt) ;
+
+	/**
+	* @brief Announce a read, within the file holding azPos.
+	*/
+	virtual void readahead(const off_t azPos, const long alLen) ;
+
+protected:
+    /**
+    * @brief Return EOF position: sum of the file sizes
+    *
+    * @return >= 0: EOF position, EXI_SEK in case of error
+    */
+    virtual off_t jeofpos() ;
+
+    /**
+     * @brief Get data from the file holding azPos.
+     *
+     * @param azPos		position to read from
+     * @param aiSft		0=read, 1=hard ahead, 2=soft ahead
+     * @return data at requested position, EOF or EOB.
+     */
+    virtual int get_frombuffer(
+        const off_t azPos,    /* position to read from                */
+        const eAhead aiSft    /* 0=read, 1=hard ahead, 2=soft ahead   */
+    ) ;
+
+private:
+    /**
+     * @brief Find the file holding a position.
+     *
+     * @param azPos     position
+     * @return file number, -1 = beyond EOF or before start
+     */
+    int ufPrt(const off_t azPos) ;
+
+    /**
+     * @brief The read cursor of get may point into the buffer of file aiPrt,
+     * which may change when aiPrt is accessed: invalidate the cursor.
+     */
+    inline void ufRedClr(const int aiPrt) {
+        if (aiPrt == miRedPrt && ! mbRes[aiPrt])
+            miRedSze = 0 ;
+    }
+
+    std::vector<JFile *> mpPrt ;    /**< files                                          */
+    std::vector<off_t>   mzBeg ;    /**< start position of each file, plus EOF          */
+    std::vector<bool>    mbRes ;    /**< file resides in memory (buffer never changes)  */
+    int miPrt=0 ;                   /**< last file accessed                             */
+    int miRedPrt=-1 ;               /**< file holding the read cursor of get            */
+};
+} /* namespace */
+#endif /* JFILEMULTI_H_ */
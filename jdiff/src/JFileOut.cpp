@@ -18,22 +18,231 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <new>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/uio.h>
+#endif // _WIN32
+
 #include "JFileOut.h"
+#ifdef JDIFF_KCOPY
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#endif // JDIFF_KCOPY
 
 namespace JojoDiff {
 
 /**
 * @brief JojoDiff's Output File abstraction
 */
-JFileOut::JFileOut( FILE * const apFil):mpFil(apFil)
+JFileOut::JFileOut( FILE * const apFil, const long alBufSze, const off_t azPos)
+: miErr(EXI_OK), mpFil(apFil), miFd(-1), mlBufSze(alBufSze < 16 ? 16 : alBufSze), mlBufLen(0), mzPos(azPos)
+{
+    mpBuf = (jchar *) malloc(mlBufSze) ;
+    #ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpBuf == null)
+        throw std::bad_alloc() ;
+    #endif // JDIFF_THROW_BAD_ALLOC
+
+    #ifndef _WIN32
+    // write straight to the file descriptor (vectored), after whatever stdio holds
+    if (fflush(mpFil) == 0)
+        miFd = fileno(mpFil) ;
+    #endif // _WIN32
+
+    #ifdef JDIFF_KCOPY
+    // kernel copies only make sense towards a regular file
+    struct stat lsSta ;
+    miKcpInp = -1 ;
+    miKcp = (miFd >= 0 && fstat(miFd, &lsSta) == 0 && S_ISREG(lsSta.st_mode)) ? 2 : 0 ;
+    #endif // JDIFF_KCOPY
+}
+
+JFileOut::JFileOut()
+: miErr(EXI_OK), mpFil(null), miFd(-1), mpBuf(null), mlBufSze(0), mlBufLen(0), mzPos(-1)
 {
-    //ctor
+    #ifdef JDIFF_KCOPY
+    miKcp = 0 ;
+    miKcpInp = -1 ;
+    #endif // JDIFF_KCOPY
 }
 
+JFileOut::~JFileOut()
+{
+    flush() ;
+    free(mpBuf) ;
+}
+
+/**
+* @brief    Write the output buffer followed by apDta to the file.
+*
+* On POSIX systems, both are written with one writev call (pwritev when
+* writing at a position).
+*
+* A failure is remembered in miErr: the buffer has been given up, so
+* the output is incomplete whatever follows.
+*
+* @param    apDta   data to write after the buffer (may be null)
+* @param    alLen   number of bytes to write
+* @return   EXI_OK or EXI_WRI
+*/
+int JFileOut::ufWrite(jchar const *apDta, long alLen){
+    long llBuf = mlBufLen ;
+    mlBufLen = 0 ;
+
+#ifndef _WIN32
+    if (miFd >= 0) {
+        struct iovec laVec[2] ;
+        ssize_t llWri ;
+
+        laVec[0].iov_base = mpBuf ;
+        laVec[0].iov_len  = llBuf ;
+        laVec[1].iov_base = (void *) apDta ;
+        laVec[1].iov_len  = alLen ;
+        while (laVec[0].iov_len + laVec[1].iov_len > 0) {
+            if (mzPos >= 0)
+                llWri = ::pwritev(miFd, laVec[0].iov_len > 0 ? &laVec[0] : &laVec[1],
+                                  laVec[0].iov_len > 0 ? 2 : 1, mzPos) ;
+            else
+                llWri = ::writev(miFd, laVec[0].iov_len > 0 ? &laVec[0] : &laVec[1],
+                                 laVec[0].iov_len > 0 ? 2 : 1) ;
+            if (llWri < 0) {
+                if (errno == EINTR)
+                    continue ;
+                miErr = EXI_WRI ;
+                return EXI_WRI ;
+            }
+            if (mzPos >= 0)
+                mzPos += llWri ;
+            if ((size_t) llWri >= laVec[0].iov_len) {
+                llWri -= laVec[0].iov_len ;
+                laVec[0].iov_len = 0 ;
+                laVec[1].iov_base = (char *) laVec[1].iov_base + llWri ;
+                laVec[1].iov_len -= llWri ;
+            } else {
+                laVec[0].iov_base = (char *) laVec[0].iov_base + llWri ;
+                laVec[0].iov_len -= llWri ;
+            }
+        }
+        return EXI_OK ;
+    }
+#endif // _WIN32
+
+    if (mzPos >= 0                      // positional writes need a file descriptor
+            || (llBuf > 0 && fwrite(mpBuf, 1, llBuf, mpFil) != (size_t) llBuf)
+            || (alLen > 0 && fwrite(apDta, 1, alLen, mpFil) != (size_t) alLen)) {
+        miErr = EXI_WRI ;
+        return EXI_WRI ;
+    }
+    return EXI_OK ;
+} /* ufWrite */
+
+/**
+* @brief    Write the output buffer to the file.
+* @return   EXI_OK or EXI_WRI, also when an earlier write failed
+*/
+int JFileOut::flush(){
+    if (ufWrite(null, 0) == EXI_OK && miFd < 0 && mpFil != null && fflush(mpFil) != 0)
+        miErr = EXI_WRI ;
+    return miErr ;
+} /* flush */
+
+/**
+* @brief    Write a series of bytes to the output.
+*
+* Small series are collected in the buffer, large series are written
+* straight from apDta together with the buffer.
+*
+* @param    apDta   data to write
+* @param    alLen   number of bytes to write
+* @return   EXI_OK or EXI_WRI
+*/
+int JFileOut::write(jchar const *apDta, long alLen){
+    if (alLen <= mlBufSze - mlBufLen) {
+        memcpy(mpBuf + mlBufLen, apDta, alLen) ;
+        mlBufLen += alLen ;
+        return EXI_OK ;
+    }
+    return ufWrite(apDta, alLen) ;
+} /* write */
+
+#ifdef JDIFF_KCOPY
+/**
+* @brief    Copy a series of bytes from a file descriptor within the kernel.
+*
+* Tries copy_file_range (which may share extents or offload the copy to the
+* storage) and falls back to sendfile. The output buffer must be empty.
+* The input's file offset is left untouched.
+*
+* @param    aiFdInp     Input file descriptor (regular file)
+* @param    azPos       Position to copy from
+* @param    azLen       Number of bytes to copy
+* @return   Number of bytes copied, -1 on write error
+*/
+off_t JFileOut::ufKcopy(int aiFdInp, off_t azPos, off_t azLen){
+    off_t lzCpy = 0 ;
+    ssize_t llRet ;
+    size_t llLen ;
+
+    while (lzCpy < azLen && miKcp > 0) {
+        llLen = (azLen - lzCpy > (off_t) 0x40000000) ? 0x40000000 : (size_t) (azLen - lzCpy) ;
+        if (miKcp == 2)
+            llRet = copy_file_range(aiFdInp, &azPos, miFd, mzPos >= 0 ? &mzPos : null, llLen, 0) ;
+        else if (mzPos < 0)
+            llRet = sendfile(miFd, aiFdInp, &azPos, llLen) ;
+        else
+            break ;     // sendfile cannot write at a position
+        if (llRet > 0) {
+            lzCpy += llRet ;
+        } else if (llRet == 0) {
+            break ;     // EOF on input: let the caller report it
+        } else if (errno == EINTR) {
+            continue ;
+        } else if (errno == ENOSPC || errno == EIO || errno == EFBIG || errno == EDQUOT) {
+            return -1 ;
+        } else {
+            miKcp-- ;   // not supported for these files: try the next method
+        }
+    }
+    return lzCpy ;
+} /* ufKcopy */
+#endif // JDIFF_KCOPY
+
 int JFileOut::copyfrom( JFile &apFilInp, off_t azPos, off_t azLen){
     jchar *lpBuf ;
     off_t lzLen ;
 
+#ifdef JDIFF_KCOPY
+    // Large copies between regular files are done within the kernel
+    if (miKcp > 0 && azLen >= FILOUTKCP) {
+        int liFdInp = apFilInp.get_fd() ;
+        struct stat lsSta ;
+        if (liFdInp >= 0 && liFdInp != miKcpInp
+                && fstat(liFdInp, &lsSta) == 0 && S_ISREG(lsSta.st_mode))
+            miKcpInp = liFdInp ;
+        if (liFdInp >= 0 && liFdInp == miKcpInp) {
+            if (ufWrite(null, 0) != EXI_OK) {
+                fprintf(stderr, "Error writing output file.\n");
+                return (EXI_WRI);
+            }
+            lzLen = ufKcopy(liFdInp, azPos, azLen) ;
+            if (lzLen < 0) {
+                miErr = EXI_WRI ;
+                fprintf(stderr, "Error writing output file.\n");
+                return (EXI_WRI);
+            }
+            azPos += lzLen ;
+            azLen -= lzLen ;
+            if (azLen == 0)
+                return (EXI_OK);
+        }
+    }
+#endif // JDIFF_KCOPY
+
     // First try buffered copying
     lpBuf = apFilInp.getbuf(azPos, lzLen);
     if (lpBuf != null ){
@@ -44,7 +253,9 @@ int JFileOut::copyfrom( JFile &apFilInp, off_t azPos, off_t azLen){
             }
             if (lzLen > azLen)
                 lzLen = azLen ;
-            if (fwrite(lpBuf, sizeof(jchar), lzLen, mpFil) != (size_t) lzLen) {
+            if (lzLen > LONG_MAX)
+                lzLen = LONG_MAX ;
+            if (write(lpBuf, (long) lzLen) != EXI_OK) {
                 fprintf(stderr, "Error writing output file.\n");
                 return (EXI_WRI);
             }
@@ -80,7 +291,10 @@ int JFileOut::copyfrom( JFile &apFilInp, off_t azPos, off_t azLen){
 * @return   EOF on error
 */
 int JFileOut::putc(const int aiDta){
-    return fputc(aiDta, mpFil) ;
+    if (mlBufLen == mlBufSze && ufWrite(null, 0) != EXI_OK)
+        return EOF ;
+    mpBuf[mlBufLen++] = (jchar) aiDta ;
+    return aiDta ;
 } /* putc */
 
 
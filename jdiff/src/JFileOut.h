@@ -26,6 +26,9 @@
 #include "JDefs.h"
 #include "JFile.h"
 
+#define FILOUTBUF 0x40000   /**< Default output buffer size (256kB) */
+#define FILOUTKCP 0x10000   /**< Minimum length to copy within the kernel (64kB) */
+
 namespace JojoDiff {
 
 /**
@@ -38,13 +41,24 @@ class JFileOut
     JFileOut& operator=(JFileOut const&) = delete;
 
     public:
-        virtual ~JFileOut(){};
+        /** Flushes the output buffer */
+        virtual ~JFileOut();
 
         /**
         * @brief    Create JFileOut on a stdio file.
-        * @param    apFile  Stdio file, opened and ready for writing
+        *
+        * Output is collected in a buffer of alBufSze bytes and written to
+        * the file in large blocks, bypassing the stdio buffer.
+        *
+        * With azPos >= 0, output is written at position azPos onwards (pwrite),
+        * leaving the file offset untouched, so that several JFileOuts can write
+        * disjoint parts of the same file.
+        *
+        * @param    apFile      Stdio file, opened and ready for writing
+        * @param    alBufSze    Size of the output buffer
+        * @param    azPos       Position to write at (-1 = at the file offset)
         */
-        JFileOut(FILE * const apFil) ;
+        JFileOut(FILE * const apFil, const long alBufSze = FILOUTBUF, const off_t azPos = -1) ;
 
         /**
         * @brief    Write a byte to the output.
@@ -53,6 +67,14 @@ class JFileOut
         */
         virtual int putc(const int aiDta) ;
 
+        /**
+        * @brief    Write a series of bytes to the output.
+        * @param    apDta   data to write
+        * @param    alLen   number of bytes to write
+        * @return   EXI_OK or EXI_WRI
+        */
+        virtual int write(jchar const *apDta, long alLen) ;
+
         /**
         * @brief    Copy a series of bytes from input to output.
         * @param    apFilInp    Input file
@@ -62,10 +84,43 @@ class JFileOut
         */
         virtual int copyfrom(JFile &apFilInp, off_t azPos, off_t azLen) ;
 
+        /**
+        * @brief    Write the output buffer to the file.
+        * @return   EXI_OK or EXI_WRI, also when an earlier write failed
+        */
+        virtual int flush() ;
+
     protected:
+        /**
+        * @brief    Create JFileOut without a file, for subclasses that write elsewhere.
+        */
+        JFileOut() ;
+
+        int   miErr ;          /* First write error (sticky), EXI_OK = none */
 
     private:
-        FILE * const mpFil ;   /* File to read from */
+        FILE * const mpFil ;   /* File to write to                          */
+        int   miFd ;           /* File descriptor of mpFil (-1 = use stdio) */
+        jchar *mpBuf ;         /* Output buffer                             */
+        long  mlBufSze ;       /* Output buffer size                        */
+        long  mlBufLen ;       /* Number of bytes in the output buffer      */
+        off_t mzPos ;          /* Position to write at (-1 = file offset)   */
+#ifdef JDIFF_KCOPY
+        int   miKcp ;          /* Kernel copy: 2=copy_file_range, 1=sendfile, 0=none */
+        int   miKcpInp ;       /* Last input descriptor found to be a regular file   */
+#endif // JDIFF_KCOPY
+
+        /**
+        * @brief    Write the output buffer followed by apDta to the file.
+        */
+        int ufWrite(jchar const *apDta, long alLen) ;
+
+#ifdef JDIFF_KCOPY
+        /**
+        * @brief    Copy a series of bytes from a file descriptor within the kernel.
+        */
+        off_t ufKcopy(int aiFdInp, off_t azPos, off_t azLen) ;
+#endif // JDIFF_KCOPY
 };
 } /* namespace */
 #endif // JFILEOUT_H
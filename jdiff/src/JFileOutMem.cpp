@@ -0,0 +1,112 @@
+/*
+ * JFileOutMem.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "JFileOutMem.h"
+
+namespace JojoDiff {
+
+JFileOutMem::JFileOutMem()
+: JFileOut()
+{
+}
+
+JFileOutMem::~JFileOutMem()
+{
+}
+
+/**
+* @brief    Write a byte to the buffer.
+* @param    aiDta   data to write
+* @return   EOF when the buffer is full
+*/
+int JFileOutMem::putc(const int aiDta){
+    if (mlLen >= mlSze) {
+        miErr = EXI_WRI ;
+        return EOF ;
+    }
+    mpBuf[mlLen++] = (jchar) aiDta ;
+    return aiDta ;
+} /* putc */
+
+/**
+* @brief    Write a series of bytes to the buffer.
+* @param    apDta   data to write
+* @param    alLen   number of bytes to write
+* @return   EXI_OK or EXI_WRI when the buffer is full
+*/
+int JFileOutMem::write(jchar const *apDta, long alLen){
+    if (alLen > mlSze - mlLen) {
+        miErr = EXI_WRI ;
+        return EXI_WRI ;
+    }
+    memcpy(mpBuf + mlLen, apDta, alLen) ;
+    mlLen += alLen ;
+    return EXI_OK ;
+} /* write */
+
+/**
+* @brief    Copy a series of bytes from input to the buffer.
+* @param    apFilInp    Input file
+* @param    azPos       Position to copy from
+* @param    azLen       Number of bytes to copy
+* @return   EXI_OK, EXI_RED or EXI_WRI
+*/
+int JFileOutMem::copyfrom(JFile &apFilInp, off_t azPos, off_t azLen){
+    jchar *lpBuf ;
+    off_t lzLen ;
+    int lcVal ;
+
+    if (azLen > mlSze - mlLen) {
+        miErr = EXI_WRI ;
+        return EXI_WRI ;
+    }
+    while (azLen > 0) {
+        lpBuf = apFilInp.getbuf(azPos, lzLen);
+        if (lpBuf != null) {
+            if (lzLen > azLen)
+                lzLen = azLen ;
+            memcpy(mpBuf + mlLen, lpBuf, (size_t) lzLen) ;
+        } else {
+            // Not buffered: copy character by character
+            lcVal = apFilInp.get(azPos);
+            if (lcVal <= EOF)
+                return EXI_RED ;
+            mpBuf[mlLen] = (jchar) lcVal ;
+            lzLen = 1 ;
+        }
+        mlLen += (long) lzLen ;
+        azLen -= lzLen ;
+        azPos += lzLen ;
+    }
+    return EXI_OK ;
+} /* copyfrom */
+
+/**
+* @brief    Nothing to flush, but report a buffer overflow.
+* @return   EXI_OK or EXI_WRI when data did not fit in the buffer
+*/
+int JFileOutMem::flush(){
+    return miErr ;
+} /* flush */
+
+} /* namespace */
@@ -0,0 +1,70 @@
+/*
+ * JFileOutMem.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JFILEOUTMEM_H
+#define JFILEOUTMEM_H
+
+#include "JDefs.h"
+#include "JFileOut.h"
+
+namespace JojoDiff {
+
+/**
+* @brief Output into a memory buffer of fixed size.
+*
+* Writing beyond the end of the buffer fails with EOF or EXI_WRI.
+*/
+class JFileOutMem : public JFileOut
+{
+    JFileOutMem(JFileOutMem const&) = delete;
+    JFileOutMem& operator=(JFileOutMem const&) = delete;
+
+    public:
+        /** Create JFileOutMem without a buffer: set_buffer before writing */
+        JFileOutMem() ;
+
+        virtual ~JFileOutMem() ;
+
+        /**
+        * @brief    Set the buffer to write into and restart writing at its start.
+        *
+        * @param    apBuf   buffer
+        * @param    alSze   size of the buffer
+        */
+        void set_buffer(jchar *apBuf, long alSze) { mpBuf = apBuf ; mlSze = alSze ; mlLen = 0 ; miErr = EXI_OK ; }
+
+        /**
+        * @brief    Return the number of bytes written into the buffer.
+        */
+        long get_length() const { return mlLen ; }
+
+        virtual int putc(const int aiDta) ;
+        virtual int write(jchar const *apDta, long alLen) ;
+        virtual int copyfrom(JFile &apFilInp, off_t azPos, off_t azLen) ;
+        virtual int flush() ;
+
+    private:
+        jchar *mpBuf = null ;   /* Buffer to write into          */
+        long  mlSze = 0 ;       /* Size of the buffer            */
+        long  mlLen = 0 ;       /* Number of bytes written       */
+};
+} /* namespace */
+#endif // JFILEOUTMEM_H
@@ -0,0 +1,226 @@
+/*
+ * JFileOutMmap.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JDefs.h"
+#include "JFileOutMmap.h"
+
+#ifdef JDIFF_MMAP
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+/**
+* @brief Map an output file into memory.
+*
+* The base JFileOut only gets a minimal buffer as all output goes to the mapping.
+*/
+JFileOutMmap::JFileOutMmap(FILE * const apFil, const off_t azSze)
+: JFileOut(apFil, 16), miFd(-1), mpMap(null), mzMapSze(0), mzLen(0)
+{
+    struct stat lsSta ;
+
+    if (fflush(apFil) != 0)
+        return ;
+    miFd = fileno(apFil) ;
+    if (fstat(miFd, &lsSta) != 0 || ! S_ISREG(lsSta.st_mode)) {
+        miFd = -1 ;
+        return ;
+    }
+    ufGrow(azSze < FILOUTMAP ? FILOUTMAP : azSze) ;
+
+#if debug
+    if (JDebug::gbDbg[DBGBUF])
+        fprintf(JDebug::stddbg, "JFileOutMmap(map=%p,size=" P8zd ")\n", mpMap, mzMapSze);
+#endif
+}
+
+JFileOutMmap::~JFileOutMmap()
+{
+    flush() ;
+}
+
+/**
+* @brief    Grow the file and the mapping to hold at least azSze bytes.
+*
+* The file is grown geometrically. Where possible, its blocks are allocated
+* with fallocate, so that running out of disk space shows up here as an
+* error rather than as a SIGBUS when writing into the mapping. File systems
+* without fallocate get a sparse file.
+*
+* @param    azSze   minimum size
+* @return   EXI_OK or EXI_WRI
+*/
+int JFileOutMmap::ufGrow(off_t azSze){
+    off_t lzSze ;
+    void *lpMap ;
+
+    if (miFd < 0)
+        return EXI_WRI ;
+
+    lzSze = mzMapSze * 2 ;
+    if (lzSze < azSze)
+        lzSze = azSze ;
+    if (lzSze < FILOUTMAP)
+        lzSze = FILOUTMAP ;
+    if ((off_t) (size_t) lzSze != lzSze)
+        return EXI_WRI ;    // too large for the address space
+
+    #ifdef __linux__
+    if (fallocate(miFd, 0, mzMapSze, lzSze - mzMapSze) != 0
+            && errno != EOPNOTSUPP && errno != ENOSYS) {
+        ftruncate(miFd, mzMapSze) ;     // release a partial allocation
+        return EXI_WRI ;
+    }
+    #endif // __linux__
+    if (ftruncate(miFd, lzSze) != 0) {
+        ftruncate(miFd, mzLen) ;
+        return EXI_WRI ;
+    }
+
+    if (mpMap == null) {
+        lpMap = mmap(null, (size_t) lzSze, PROT_READ | PROT_WRITE, MAP_SHARED, miFd, 0) ;
+    } else {
+        #ifdef __linux__
+        lpMap = mremap(mpMap, (size_t) mzMapSze, (size_t) lzSze, MREMAP_MAYMOVE) ;
+        #else
+        munmap(mpMap, (size_t) mzMapSze) ;
+        lpMap = mmap(null, (size_t) lzSze, PROT_READ | PROT_WRITE, MAP_SHARED, miFd, 0) ;
+        #endif // __linux__
+    }
+    if (lpMap == MAP_FAILED) {
+        if (mpMap != null)
+            munmap(mpMap, (size_t) mzMapSze) ;
+        ftruncate(miFd, mzLen) ;
+        mpMap = null ;
+        mzMapSze = 0 ;
+        miFd = -1 ;
+        return EXI_WRI ;
+    }
+    mpMap = (jchar *) lpMap ;
+    mzMapSze = lzSze ;
+    return EXI_OK ;
+} /* ufGrow */
+
+/**
+* @brief    Write a byte to the output.
+* @param    aiDta   data to write
+* @return   EOF on error
+*/
+int JFileOutMmap::putc(const int aiDta){
+    if (mzLen >= mzMapSze && ufGrow(mzLen + 1) != EXI_OK) {
+        miErr = EXI_WRI ;
+        return EOF ;
+    }
+    mpMap[mzLen++] = (jchar) aiDta ;
+    return aiDta ;
+} /* putc */
+
+/**
+* @brief    Write a series of bytes to the output.
+* @param    apDta   data to write
+* @param    alLen   number of bytes to write
+* @return   EXI_OK or EXI_WRI
+*/
+int JFileOutMmap::write(jchar const *apDta, long alLen){
+    if (mzLen + alLen > mzMapSze && ufGrow(mzLen + alLen) != EXI_OK) {
+        miErr = EXI_WRI ;
+        return EXI_WRI ;
+    }
+    memcpy(mpMap + mzLen, apDta, alLen) ;
+    mzLen += alLen ;
+    return EXI_OK ;
+} /* write */
+
+/**
+* @brief    Copy a series of bytes from input to output.
+*
+* Copies straight from the input's buffer (the whole file for a JFileMmap)
+* into the mapping.
+*
+* @param    apFilInp    Input file
+* @param    azPos       Position to copy from
+* @param    azLen       Number of bytes to copy
+* @return   <> 0 = error
+*/
+int JFileOutMmap::copyfrom(JFile &apFilInp, off_t azPos, off_t azLen){
+    jchar *lpBuf ;
+    off_t lzLen ;
+    int lcVal ;
+
+    if (mzLen + azLen > mzMapSze && ufGrow(mzLen + azLen) != EXI_OK) {
+        miErr = EXI_WRI ;
+        fprintf(stderr, "Error writing output file.\n");
+        return (EXI_WRI);
+    }
+
+    while (azLen > 0) {
+        lpBuf = apFilInp.getbuf(azPos, lzLen);
+        if (lpBuf != null) {
+            if (lzLen > azLen)
+                lzLen = azLen ;
+            memcpy(mpMap + mzLen, lpBuf, (size_t) lzLen) ;
+        } else {
+            // Not buffered: copy character by character
+            lcVal = apFilInp.get(azPos);
+            if (lcVal <= EOF) {
+                fprintf(stderr, "Error reading source file.\n");
+                return (EXI_RED);
+            }
+            mpMap[mzLen] = (jchar) lcVal ;
+            lzLen = 1 ;
+        }
+        mzLen += lzLen ;
+        azLen -= lzLen ;
+        azPos += lzLen ;
+    }
+    return (EXI_OK);
+} /* copyfrom */
+
+/**
+* @brief    Unmap the file and truncate it to the number of bytes written.
+*
+* Further output will map the file again.
+*
+* @return   EXI_OK or EXI_WRI, also when an earlier write failed
+*/
+int JFileOutMmap::flush(){
+    int liRet = miErr ;
+
+    if (mpMap != null) {
+        if (munmap(mpMap, (size_t) mzMapSze) != 0)
+            liRet = EXI_WRI ;
+        mpMap = null ;
+        mzMapSze = 0 ;
+    }
+    if (miFd >= 0 && ftruncate(miFd, mzLen) != 0)
+        liRet = EXI_WRI ;
+    return liRet ;
+} /* flush */
+
+} /* namespace */
+#endif // JDIFF_MMAP
@@ -0,0 +1,83 @@
+/*
+ * JFileOutMmap.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JFILEOUTMMAP_H
+#define JFILEOUTMMAP_H
+
+#include "JDefs.h"
+#include "JFileOut.h"
+
+#ifdef JDIFF_MMAP
+
+#define FILOUTMAP 0x100000  /**< Minimum growth of the output mapping (1MB) */
+
+namespace JojoDiff {
+
+/**
+* @brief Memory mapped output file: all output is copied straight into a
+* shared mapping of the file.
+*
+* The file is preallocated to an estimated size and grown (and remapped)
+* when the estimate is exceeded. flush() truncates the file to the number of
+* bytes written. Only usable on regular files, check is_mapped() after
+* construction.
+*/
+class JFileOutMmap : public JFileOut
+{
+    JFileOutMmap(JFileOutMmap const&) = delete;
+    JFileOutMmap& operator=(JFileOutMmap const&) = delete;
+
+    public:
+        /**
+        * @brief    Map an output file into memory.
+        *
+        * @param    apFil   Stdio file, opened for reading and writing (not closed by JFileOutMmap)
+        * @param    azSze   Estimated size of the output
+        */
+        JFileOutMmap(FILE * const apFil, const off_t azSze) ;
+
+        /** Unmaps the file and truncates it to the number of bytes written */
+        virtual ~JFileOutMmap();
+
+        /**
+        * @brief Return whether the file could be mapped.
+        */
+        bool is_mapped() const { return mpMap != null ; }
+
+        virtual int putc(const int aiDta) ;
+        virtual int write(jchar const *apDta, long alLen) ;
+        virtual int copyfrom(JFile &apFilInp, off_t azPos, off_t azLen) ;
+        virtual int flush() ;
+
+    private:
+        int   miFd ;           /* File descriptor of the output file        */
+        jchar *mpMap ;         /* Mapping of the output file                */
+        off_t mzMapSze ;       /* Size of the mapping (and the file)        */
+        off_t mzLen ;          /* Number of bytes written                   */
+
+        /**
+        * @brief    Grow the file and the mapping to hold at least azSze bytes.
+        */
+        int ufGrow(off_t azSze) ;
+};
+} /* namespace */
+#endif // JDIFF_MMAP
+#endif // JFILEOUTMMAP_H
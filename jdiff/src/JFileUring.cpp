@@ -0,0 +1,539 @@
+/*
+ * JFileUring.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JDefs.h"
+#include "JFileUring.h"
+
+#ifdef JDIFF_URING
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "JDebug.h"
+
+#define URGMAX 256      /**< Maximum number of reads in flight */
+#define URGANY -2       /**< ufWait: wait for a free place in the ring */
+#define URGSEQ 8        /**< Blocks to read ahead on sequential access (advise) */
+
+namespace JojoDiff {
+
+/**
+ * @brief Create a block cache on a file.
+ *
+ * The cache holds alBufSze / aiBlkSze blocks (at least 4), at most half of
+ * them can be in flight at any time.
+ */
+JFileUring::JFileUring(int const aiFd, char const * const asJid,
+                       long const alBufSze, int const aiBlkSze)
+: JFile(asJid, false)
+, miFd(aiFd)
+, miBlkSze(aiBlkSze < 4096 ? 4096 : aiBlkSze)
+{
+    miBlkCnt = (int) (alBufSze / miBlkSze) ;
+    if (miBlkCnt < 4)
+        miBlkCnt = 4 ;
+    mpBlkDta = (jchar *) malloc((size_t) miBlkSze * miBlkCnt) ;
+    mzBlkNum = (off_t *) malloc(sizeof(off_t) * miBlkCnt) ;
+    miBlkLen = (int *) malloc(sizeof(int) * miBlkCnt) ;
+    mlBlkUse = (unsigned long *) malloc(sizeof(unsigned long) * miBlkCnt) ;
+    miBlkSta = (char *) malloc(sizeof(char) * miBlkCnt) ;
+    for (miHshMsk = 1; miHshMsk < 2 * miBlkCnt; miHshMsk <<= 1) ;
+    miBlkHsh = (int *) malloc(sizeof(int) * miHshMsk--) ;
+    #ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpBlkDta == null || mzBlkNum == null || miBlkLen == null || mlBlkUse == null
+            || miBlkSta == null || miBlkHsh == null)
+        throw std::bad_alloc() ;
+    #endif // JDIFF_THROW_BAD_ALLOC
+    for (int liBlk = 0; liBlk < miBlkCnt; liBlk++) {
+        mzBlkNum[liBlk] = -1 ;
+        miBlkLen[liBlk] = 0 ;
+        mlBlkUse[liBlk] = 0 ;
+        miBlkSta[liBlk] = Free ;
+    }
+    for (int liHsh = 0; liHsh <= miHshMsk; liHsh++)
+        miBlkHsh[liHsh] = 0 ;
+
+    mzPosEof = jeofpos() ;
+    if (mzPosEof < 0) {
+        mzPosEof = MAX_OFF_T ;
+        mbSeq = true ;
+    } else {
+        miPndMax = miBlkCnt / 2 ;
+        if (miPndMax > URGMAX)
+            miPndMax = URGMAX ;
+        ufRngOpn(miPndMax) ;
+    }
+
+#if debug
+    if (JDebug::gbDbg[DBGBUF])
+        fprintf(JDebug::stddbg, "JFileUring(%s):(eof=" P8zd ",blocks=%d,uring=%d)\n",
+                asJid, mzPosEof, miBlkCnt, miRng >= 0);
+#endif
+}
+
+/**
+ * @brief Wait for the reads in flight (they target the cache), then free everything.
+ */
+JFileUring::~JFileUring()
+{
+    if (miRng >= 0) {
+        while (miPndCnt > 0) {
+            if (syscall(__NR_io_uring_enter, miRng, miSqeTdo, 1, IORING_ENTER_GETEVENTS, null, 0) >= 0)
+                miSqeTdo = 0 ;
+            else if (errno != EINTR && errno != EAGAIN)
+                break ;
+            ufReap() ;
+        }
+        if (mpSqe != null)
+            munmap(mpSqe, miSqe) ;
+        if (mpCqMap != null && mpCqMap != mpSqMap)
+            munmap(mpCqMap, miCqMap) ;
+        if (mpSqMap != null)
+            munmap(mpSqMap, miSqMap) ;
+        close(miRng) ;
+    }
+    free(mpBlkDta) ;
+    free(mzBlkNum) ;
+    free(miBlkLen) ;
+    free(mlBlkUse) ;
+    free(miBlkSta) ;
+    free(miBlkHsh) ;
+}
+
+/**
+ * @brief Set up the io_uring and map its rings, leave miRng at -1 on failure.
+ *
+ * @param aiCnt     number of submission queue entries
+ */
+void JFileUring::ufRngOpn(unsigned aiCnt) {
+    struct io_uring_params lsPar ;
+    void *lpMap ;
+
+    memset(&lsPar, 0, sizeof(lsPar)) ;
+    miRng = (int) syscall(__NR_io_uring_setup, aiCnt, &lsPar) ;
+    if (miRng < 0) {
+        miRng = -1 ;
+        return ;
+    }
+
+    miSqMap = lsPar.sq_off.array + lsPar.sq_entries * sizeof(unsigned) ;
+    miCqMap = lsPar.cq_off.cqes + lsPar.cq_entries * sizeof(struct io_uring_cqe) ;
+    if (lsPar.features & IORING_FEAT_SINGLE_MMAP) {
+        if (miCqMap > miSqMap)
+            miSqMap = miCqMap ;
+        miCqMap = miSqMap ;
+    }
+    miSqe = lsPar.sq_entries * sizeof(struct io_uring_sqe) ;
+
+    lpMap = mmap(null, miSqMap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, miRng, IORING_OFF_SQ_RING) ;
+    if (lpMap != MAP_FAILED) {
+        mpSqMap = lpMap ;
+        if (lsPar.features & IORING_FEAT_SINGLE_MMAP)
+            lpMap = mpSqMap ;
+        else
+            lpMap = mmap(null, miCqMap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, miRng, IORING_OFF_CQ_RING) ;
+    }
+    if (lpMap != MAP_FAILED) {
+        mpCqMap = lpMap ;
+        lpMap = mmap(null, miSqe, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, miRng, IORING_OFF_SQES) ;
+    }
+    if (lpMap == MAP_FAILED) {
+        // fall back to pread
+        if (mpCqMap != null && mpCqMap != mpSqMap)
+            munmap(mpCqMap, miCqMap) ;
+        if (mpSqMap != null)
+            munmap(mpSqMap, miSqMap) ;
+        mpSqMap = null ;
+        mpCqMap = null ;
+        close(miRng) ;
+        miRng = -1 ;
+        return ;
+    }
+    mpSqe = lpMap ;
+
+    mpSqTal = (unsigned *) ((char *) mpSqMap + lsPar.sq_off.tail) ;
+    mpSqMsk = (unsigned *) ((char *) mpSqMap + lsPar.sq_off.ring_mask) ;
+    mpSqArr = (unsigned *) ((char *) mpSqMap + lsPar.sq_off.array) ;
+    mpCqHed = (unsigned *) ((char *) mpCqMap + lsPar.cq_off.head) ;
+    mpCqTal = (unsigned *) ((char *) mpCqMap + lsPar.cq_off.tail) ;
+    mpCqMsk = (unsigned *) ((char *) mpCqMap + lsPar.cq_off.ring_mask) ;
+    mpCqe   = (char *) mpCqMap + lsPar.cq_off.cqes ;
+
+    if (miPndMax > (int) lsPar.sq_entries)
+        miPndMax = (int) lsPar.sq_entries ;
+}
+
+/**
+ * @brief Return EOF position: size of a regular file.
+ */
+off_t JFileUring::jeofpos() {
+    struct stat lsSta ;
+    if (fstat(miFd, &lsSta) != 0 || ! S_ISREG(lsSta.st_mode))
+        return EXI_SEK ;
+    return lsSta.st_size ;
+}
+
+/**
+ * @brief Set lookahead base: soft lookahead fails on uncached blocks beyond base + cache size.
+ */
+void JFileUring::set_lookahead_base (const off_t azBse) {
+    mzPosBse = azBse ;
+}
+
+/**
+ * @brief Hint the expected access pattern: read further ahead on sequential access.
+ */
+void JFileUring::advise(const eAdvice aiAdv) {
+    miAhdSeq = (aiAdv == Sequential) ? URGSEQ : 1 ;
+}
+
+/**
+ * @brief Return the slot holding block azBlk, -1 = none.
+ *
+ * Tries the slot hinted for the block first, then searches all slots.
+ */
+int JFileUring::ufFind(off_t const azBlk) {
+    int liBlk = miBlkHsh[azBlk & miHshMsk] ;
+
+    if (mzBlkNum[liBlk] == azBlk)
+        return liBlk ;
+    for (liBlk = 0; liBlk < miBlkCnt; liBlk++)
+        if (mzBlkNum[liBlk] == azBlk) {
+            miBlkHsh[azBlk & miHshMsk] = liBlk ;
+            return liBlk ;
+        }
+    return -1 ;
+}
+
+/**
+ * @brief Return the least recently used slot that is not being read, -1 = none.
+ *
+ * The slot is about to be overwritten: JFile::get must not continue reading from it.
+ */
+int JFileUring::ufLru() {
+    int liLru = -1 ;
+
+    for (int liBlk = 0; liBlk < miBlkCnt; liBlk++)
+        if (miBlkSta[liBlk] != Pending && (liLru < 0 || mlBlkUse[liBlk] < mlBlkUse[liLru]))
+            liLru = liBlk ;
+    if (liLru >= 0 && mpRed >= mpBlkDta + (size_t) liLru * miBlkSze
+                   && mpRed < mpBlkDta + (size_t) (liLru + 1) * miBlkSze)
+        miRedSze = 0 ;
+    return liLru ;
+}
+
+/**
+ * @brief Queue a read of block azBlk into slot aiBlk.
+ *
+ * The read is only submitted by the next ufWait, together with all other queued reads.
+ * Queued reads never exceed miPndMax (at most the number of submission queue
+ * entries), so a full ring is first emptied by ufWait.
+ *
+ * @return EXI_OK or EXI_RED
+ */
+int JFileUring::ufQueue(int const aiBlk, off_t const azBlk) {
+    struct io_uring_sqe *lpSqe ;
+    unsigned liTal ;
+    unsigned liIdx ;
+
+    if (miPndCnt >= miPndMax && ufWait(URGANY) != EXI_OK)
+        return EXI_RED ;
+
+    mzBlkNum[aiBlk] = azBlk ;
+    miBlkHsh[azBlk & miHshMsk] = aiBlk ;
+    miBlkLen[aiBlk] = 0 ;
+    miBlkSta[aiBlk] = Pending ;
+    mlBlkUse[aiBlk] = ++mlUse ;
+
+    liTal = *mpSqTal ;          // only written by us
+    liIdx = liTal & *mpSqMsk ;
+    lpSqe = (struct io_uring_sqe *) mpSqe + liIdx ;
+    memset(lpSqe, 0, sizeof(*lpSqe)) ;
+    lpSqe->opcode    = IORING_OP_READ ;
+    lpSqe->fd        = miFd ;
+    lpSqe->off       = (unsigned long long) azBlk * miBlkSze ;
+    lpSqe->addr      = (unsigned long long) (uintptr_t) (mpBlkDta + (size_t) aiBlk * miBlkSze) ;
+    lpSqe->len       = (unsigned) miBlkSze ;
+    lpSqe->user_data = (unsigned long long) aiBlk ;
+    mpSqArr[liIdx] = liIdx ;
+    __atomic_store_n(mpSqTal, liTal + 1, __ATOMIC_RELEASE) ;
+
+    miSqeTdo++ ;
+    miPndCnt++ ;
+    return EXI_OK ;
+}
+
+/**
+ * @brief Read (the remainder of) a slot synchronously.
+ *
+ * @param aiBlk     slot, holding block mzBlkNum[aiBlk]
+ * @param aiDne     number of bytes already read
+ * @return EXI_OK or EXI_RED
+ */
+int JFileUring::ufPread(int const aiBlk, int const aiDne) {
+    off_t lzPos = mzBlkNum[aiBlk] * miBlkSze ;
+    off_t lzEnd = lzPos + miBlkSze ;
+    ssize_t liRed ;
+    int liDne = aiDne ;
+
+    if (lzEnd > mzPosEof)
+        lzEnd = mzPosEof ;
+    while (lzPos + liDne < lzEnd) {
+        liRed = pread(miFd, mpBlkDta + (size_t) aiBlk * miBlkSze + liDne,
+                      (size_t) (lzEnd - lzPos - liDne), lzPos + liDne) ;
+        if (liRed < 0 && errno == EINTR)
+            continue ;
+        if (liRed <= 0)
+            break ;
+        liDne += (int) liRed ;
+    }
+    miBlkLen[aiBlk] = liDne ;
+    if (lzPos + liDne < lzEnd) {
+        mzBlkNum[aiBlk] = -1 ;
+        miBlkSta[aiBlk] = Free ;
+        return EXI_RED ;
+    }
+    miBlkSta[aiBlk] = Ready ;
+    return EXI_OK ;
+}
+
+/**
+ * @brief Process available completions, in whatever order they arrive.
+ *
+ * Failed or short reads (other than at EOF) are completed synchronously.
+ */
+void JFileUring::ufReap() {
+    struct io_uring_cqe *lpCqe ;
+    unsigned liHed = *mpCqHed ;
+    unsigned liTal = __atomic_load_n(mpCqTal, __ATOMIC_ACQUIRE) ;
+    off_t lzLen ;
+    int liBlk ;
+    int liRes ;
+
+    while (liHed != liTal) {
+        lpCqe = (struct io_uring_cqe *) mpCqe + (liHed & *mpCqMsk) ;
+        liBlk = (int) lpCqe->user_data ;
+        liRes = lpCqe->res ;
+        liHed++ ;
+        miPndCnt-- ;
+
+        lzLen = mzPosEof - mzBlkNum[liBlk] * miBlkSze ;
+        if (lzLen > miBlkSze)
+            lzLen = miBlkSze ;
+        if (liRes == lzLen) {
+            miBlkLen[liBlk] = liRes ;
+            miBlkSta[liBlk] = Ready ;
+        } else {
+            ufPread(liBlk, liRes < 0 ? 0 : liRes) ;
+        }
+    }
+    __atomic_store_n(mpCqHed, liHed, __ATOMIC_RELEASE) ;
+}
+
+/**
+ * @brief Submit queued reads and wait till slot aiBlk (-1 = none) is ready,
+ * or with URGANY, till less than miPndMax reads are pending.
+ *
+ * @return EXI_OK or EXI_RED
+ */
+int JFileUring::ufWait(int const aiBlk) {
+    bool lbWat ;    /**< wait for a completion ? */
+    long liRet ;
+
+    for (;;) {
+        ufReap() ;
+        lbWat = (aiBlk >= 0 && miBlkSta[aiBlk] == Pending)
+             || (aiBlk == URGANY && miPndCnt >= miPndMax) ;
+        if (miSqeTdo == 0 && ! lbWat)
+            break ;
+        liRet = syscall(__NR_io_uring_enter, miRng, miSqeTdo, lbWat ? 1 : 0,
+                        lbWat ? IORING_ENTER_GETEVENTS : 0, null, 0) ;
+        if (liRet >= 0)
+            miSqeTdo -= (int) liRet ;
+        else if (errno != EINTR && errno != EAGAIN)
+            return EXI_RED ;
+    }
+    if (aiBlk >= 0 && miBlkSta[aiBlk] != Ready)
+        return EXI_RED ;
+    return EXI_OK ;
+}
+
+/**
+ * @brief Return the slot holding block azBlk, reading it when needed.
+ *
+ * On sequential access, the next blocks are queued too. Blocks already being
+ * read are waited for. The least recently used slot is overwritten.
+ *
+ * @return slot, EOB (soft ahead on a block not cached) or < 0 = error
+ */
+int JFileUring::ufGetBlk(off_t const azBlk, const eAhead aiSft) {
+    int liBlk ;
+    bool lbSeq ;
+
+    if (mzBlkNum[miBlkLst] == azBlk)
+        liBlk = miBlkLst ;
+    else
+        liBlk = ufFind(azBlk) ;
+
+    // soft reading does not read beyond the lookahead range
+    if (liBlk < 0 && aiSft == SoftAhead
+        && (azBlk * miBlkSze < mzPosBse
+            || azBlk * miBlkSze > mzPosBse + (off_t) (miBlkCnt - 1) * miBlkSze))
+        return EOB ;
+
+    lbSeq = (azBlk == mzBlkPrv + 1) ;
+    mzBlkPrv = azBlk ;
+    if (liBlk >= 0) {
+        mlBlkUse[liBlk] = ++mlUse ;     // keep it while reading ahead
+    } else {
+        if (! lbSeq)
+            mlFabSek++ ;
+        liBlk = ufLru() ;
+        if (liBlk < 0)
+            return EXI_RED ;    // cannot occur: at most half of the slots are pending
+        if (miRng < 0) {
+            mzBlkNum[liBlk] = azBlk ;
+            miBlkHsh[azBlk & miHshMsk] = liBlk ;
+            if (ufPread(liBlk, 0) != EXI_OK)
+                return EXI_RED ;
+        } else if (ufQueue(liBlk, azBlk) != EXI_OK) {
+            return EXI_RED ;
+        }
+    }
+
+    // sequential access: keep the next blocks in flight
+    if (lbSeq && miRng >= 0)
+        readahead((azBlk + 1) * miBlkSze, (long) miAhdSeq * miBlkSze) ;
+
+    if (miBlkSta[liBlk] == Pending && ufWait(liBlk) != EXI_OK)
+        return EXI_RED ;
+    mlBlkUse[liBlk] = ++mlUse ;
+    miBlkLst = liBlk ;
+    return liBlk ;
+}
+
+/**
+ * @brief Announce a read: queue reads for the blocks not yet cached.
+ *
+ * Reads are submitted together on the next read that has to wait, and no
+ * more than half of the cache is read ahead. Without io_uring, the range is
+ * passed on to the kernel as a hint.
+ *
+ * @param azPos     position of the read
+ * @param alLen     length of the read
+ */
+void JFileUring::readahead(const off_t azPos, const long alLen) {
+    off_t lzEnd = azPos + alLen ;
+    off_t lzBlk ;
+    int liBlk ;
+
+    if (azPos < 0 || alLen <= 0 || azPos >= mzPosEof)
+        return ;
+    if (lzEnd > mzPosEof)
+        lzEnd = mzPosEof ;
+    if (miRng < 0) {
+        posix_fadvise(miFd, azPos, lzEnd - azPos, POSIX_FADV_WILLNEED) ;
+        return ;
+    }
+
+    for (lzBlk = azPos / miBlkSze; lzBlk * miBlkSze < lzEnd && miPndCnt < miPndMax; lzBlk++) {
+        if (ufFind(lzBlk) >= 0)
+            continue ;  // cached or in flight
+        liBlk = ufLru() ;
+        if (liBlk < 0)
+            break ;
+        if (ufQueue(liBlk, lzBlk) != EXI_OK)
+            break ;
+    }
+}
+
+/**
+ * @brief Get access to a cached block.
+ *
+ * @param   azPos   in:  position to get access to
+ * @param   azLen   out: number of bytes available, EOF, EOB or error
+ * @param   aiSft   in:  0=read, 1=hard read ahead, 2=soft read ahead
+ *
+ * @return  buffer, null = azPos beyond EOF, not available or error
+ */
+jchar * JFileUring::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft) {
+    off_t lzBlk ;
+    off_t lzOff ;
+    int liBlk ;
+
+    if (azPos >= mzPosEof || azPos < 0) {
+        azLen = EOF ;
+        return null ;
+    }
+    lzBlk = azPos / miBlkSze ;
+    lzOff = azPos - lzBlk * miBlkSze ;
+    liBlk = ufGetBlk(lzBlk, aiSft) ;
+    if (liBlk < 0) {
+        azLen = liBlk ;
+        return null ;
+    }
+    if (lzOff >= miBlkLen[liBlk]) {
+        azLen = EXI_RED ;   // file shorter than expected
+        return null ;
+    }
+    azLen = miBlkLen[liBlk] - lzOff ;
+    return mpBlkDta + (size_t) liBlk * miBlkSze + lzOff ;
+}
+
+/**
+ * @brief Get data from the cached blocks and prepare JFile::get for the next positions.
+ *
+ * @param azPos     position to read from
+ * @param aiSft     0=read, 1=hard ahead, 2=soft ahead
+ * @return data at requested position, EOF, EOB or error.
+ */
+int JFileUring::get_frombuffer (
+    const off_t azPos,     /* position to read from                */
+    const eAhead aiSft     /* 0=read, 1=hard ahead, 2=soft ahead   */
+){
+    jchar *lpDta ;
+    off_t lzLen ;
+
+    lpDta = getbuf(azPos, lzLen, aiSft) ;
+    if (lpDta == null) {
+        mzPosRed = -1 ;
+        mpRed = null ;
+        miRedSze = 0 ;
+        return (int) lzLen ;
+    }
+
+    // prepare next reading position
+    mzPosRed = azPos + 1 ;
+    mpRed = lpDta + 1 ;
+    miRedSze = (long) lzLen - 1 ;
+    return *lpDta ;
+}
+
+} /* namespace */
+#endif // JDIFF_URING
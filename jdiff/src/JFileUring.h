@@ -0,0 +1,213 @@
+/*
+ * JFileUring.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JFILEURING_H_
+#define JFILEURING_H_
+
+#include "JDefs.h"
+#include "JFile.h"
+
+#ifdef JDIFF_URING
+
+namespace JojoDiff {
+
+/**
+ * @brief Random access JFile on a cache of blocks read with io_uring.
+ *
+ * Meant for a source file that is read at random positions (backtracking,
+ * out-of-buffer compares): reads are positional, so there is no file position
+ * to seek, and reads announced with readahead() are queued and submitted
+ * together on the next read that has to wait. Completions are processed in
+ * whatever order they arrive.
+ *
+ * When io_uring is not available, blocks are read with pread and readahead()
+ * is passed on to the kernel as a hint (posix_fadvise).
+ *
+ * Only regular files are supported, check is_ready() after construction.
+ */
+class JFileUring : public JFile
+{
+    JFileUring(JFileUring const&) = delete;
+    JFileUring& operator=(JFileUring const&) = delete;
+
+public:
+    /**
+     * @brief Create a block cache on a file.
+     *
+     * @param aiFd      file descriptor, opened for reading (not closed by JFileUring)
+     * @param asJid     JFile-id: Org for source file, New for destination file
+     * @param alBufSze  size of the cache
+     * @param aiBlkSze  size of a block
+     */
+    JFileUring(int const aiFd, char const * const asJid,
+               long const alBufSze, int const aiBlkSze);
+
+    /** Wait for the reads in flight and free the cache */
+    virtual ~JFileUring();
+
+    /**
+     * @brief Return whether the file can be read (a regular file).
+     */
+    bool is_ready() const { return ! mbSeq ; }
+
+    /**
+     * @brief Return whether io_uring is used (or pread as fallback).
+     */
+    bool is_uring() const { return miRng >= 0 ; }
+
+	 /**
+	 * @brief Get access to a cached block.
+	 *
+	 * @param   azPos   in:  position to get access to
+	 * @param   azLen   out: number of bytes available, EOF, EOB or error
+	 * @param   aiSft   in:  0=read, 1=hard read ahead, 2=soft read ahead
+	 *
+	 * @return  buffer, null = azPos beyond EOF, not available or error
+	 */
+	virtual jchar *getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft = Read) ;
+
+	/**
+	 * @brief Set lookahead base: soft lookahead fails on uncached blocks beyond base + cache size.
+	 */
+	virtual void set_lookahead_base (
+	    const off_t azBse	/* new base position for soft lookahead */
+	) ;
+
+	/**
+	 * @brief Announce a read: queue reads for the blocks not yet cached.
+	 */
+	virtual void readahead(const off_t azPos, const long alLen) ;
+
+	/**
+	 * @brief Hint the expected access pattern: read further ahead on sequential access.
+	 */
+	virtual void advise(const eAdvice aiAdv) ;
+
+	/**
+	* @brief Get underlying file descriptor.
+	*/
+	virtual int get_fd() const { return miFd ; }
+
+protected:
+    /**
+    * @brief Return EOF position: size of a regular file.
+    */
+    virtual off_t jeofpos() ;
+
+    /**
+     * @brief Get data from the cached blocks.
+     *
+     * @param azPos		position to read from
+     * @param aiSft		0=read, 1=hard ahead, 2=soft ahead
+     * @return data at requested position, EOF, EOB or error.
+     */
+    virtual int get_frombuffer(
+        const off_t azPos,    /* position to read from                */
+        const eAhead aiSft    /* 0=read, 1=hard ahead, 2=soft ahead   */
+    ) ;
+
+private:
+    enum eBlkSta { Free, Pending, Ready } ;
+
+    int const miFd ;            /**< File descriptor                            */
+    int  const miBlkSze ;       /**< Size of a block                            */
+    int  miBlkCnt ;             /**< Number of cached blocks                    */
+    jchar *mpBlkDta ;           /**< Cached blocks' data                        */
+    off_t *mzBlkNum ;           /**< Block number held in each slot (-1 = none) */
+    int   *miBlkLen ;           /**< Number of bytes in each slot               */
+    unsigned long *mlBlkUse ;   /**< Last use of each slot (LRU)                */
+    char  *miBlkSta ;           /**< State of each slot (eBlkSta)               */
+    int   *miBlkHsh ;           /**< Block number to slot hints                 */
+    int   miHshMsk ;            /**< Size of the hints - 1 (power of 2)         */
+    unsigned long mlUse = 0 ;   /**< Use counter                                */
+    int   miBlkLst = 0 ;        /**< Last slot used                             */
+    off_t mzBlkPrv = -1 ;       /**< Last block read (to detect sequential access) */
+    int   miAhdSeq = 1 ;        /**< Blocks to read ahead on sequential access  */
+    off_t mzPosBse = 0 ;        /**< Base position for soft reading             */
+
+    /* io_uring */
+    int miRng = -1 ;            /**< io_uring file descriptor, -1 = use pread   */
+    int miPndMax = 0 ;          /**< Maximum number of queued and pending reads */
+    int miPndCnt = 0 ;          /**< Number of queued and pending reads         */
+    int miSqeTdo = 0 ;          /**< Number of queued reads (not yet submitted) */
+    void *mpSqMap = null ;      /**< Submission queue ring                      */
+    void *mpCqMap = null ;      /**< Completion queue ring                      */
+    size_t miSqMap = 0 ;        /**< Size of the submission queue ring          */
+    size_t miCqMap = 0 ;        /**< Size of the completion queue ring          */
+    void *mpSqe = null ;        /**< Submission queue entries                   */
+    size_t miSqe = 0 ;          /**< Size of the submission queue entries       */
+    unsigned *mpSqTal, *mpSqMsk, *mpSqArr ;
+    unsigned *mpCqHed, *mpCqTal, *mpCqMsk ;
+    void *mpCqe ;
+
+    /**
+     * @brief Set up the io_uring, leave miRng at -1 on failure.
+     */
+    void ufRngOpn(unsigned aiCnt) ;
+
+    /**
+     * @brief Return the slot holding block azBlk, reading it when needed.
+     *
+     * @return slot, EOB (soft ahead on a block not cached) or < 0 = error
+     */
+    int ufGetBlk(off_t const azBlk, const eAhead aiSft) ;
+
+    /**
+     * @brief Return the slot holding block azBlk, -1 = none.
+     */
+    int ufFind(off_t const azBlk) ;
+
+    /**
+     * @brief Return the least recently used slot that is not being read, -1 = none.
+     */
+    int ufLru() ;
+
+    /**
+     * @brief Queue a read of block azBlk into slot aiBlk, waiting for a
+     * completion first when miPndMax reads are queued or pending.
+     *
+     * @return EXI_OK or EXI_RED
+     */
+    int ufQueue(int const aiBlk, off_t const azBlk) ;
+
+    /**
+     * @brief Submit queued reads and wait till slot aiBlk (-1 = none) is ready,
+     * or with URGANY, till less than miPndMax reads are pending.
+     *
+     * @return EXI_OK or EXI_RED
+     */
+    int ufWait(int const aiBlk) ;
+
+    /**
+     * @brief Process available completions.
+     */
+    void ufReap() ;
+
+    /**
+     * @brief Read (the remainder of) a slot synchronously.
+     *
+     * @return EXI_OK or EXI_RED
+     */
+    int ufPread(int const aiBlk, int const aiDne) ;
+};
+} /* namespace */
+#endif // JDIFF_URING
+#endif /* JFILEURING_H_ */
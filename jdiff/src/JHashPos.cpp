@@ -30,10 +30,6 @@ using namespace std;
 
 namespace JojoDiff {
 
-const int COLLISION_THRESHOLD = 4 ; /* override when collision counter exceeds threshold  */
-const int COLLISION_HIGH = 4 ;      /* rate at which high quality samples should override */
-const int COLLISION_LOW = 1 ;       /* rate at which low quality samples should override  */
-
 /**
   * @brief Create a new hash-table with size (number of elements) not larger that the given size.
   *
@@ -42,12 +38,14 @@ const int COLLISION_LOW = 1 ;       /* rate at which low quality samples should
   * of 8191 elements.
   *
   * One element may be 4, 6 or 8 bytes.
+  * With buckets, the prime applies to the number of buckets.
   *
   * @param aiSze   size, in number of elements.
+  * @param abBkt   use cache-line sized buckets instead of flat arrays ?
   */
-JHashPos::JHashPos(int aiSze)
-:  miHshColMax(COLLISION_THRESHOLD), miHshColCnt(COLLISION_THRESHOLD),
-   miHshRlb(SMPSZE + SMPSZE / 2), miHshHit(0)
+JHashPos::JHashPos(int aiSze, bool abBkt)
+:  mbBkt(abBkt), miHshColMax(COLLISION_THRESHOLD), miHshColCnt(COLLISION_THRESHOLD),
+   miHshRlb(SMPSZE + SMPSZE / 2)
 {
     /* get largest prime < aiSze */
     int liSzeIdx ;
@@ -55,36 +53,67 @@ JHashPos::JHashPos(int aiSze)
         liSzeIdx = 1 ;
     else
         liSzeIdx = aiSze ;
-    liSzeIdx = (liSzeIdx * 1024 * 1024) /                   // convert Mb to number of elements
-                    (sizeof(hkey)+sizeof(off_t));
-    liSzeIdx = getLowerPrime(liSzeIdx);                     // find nearest lower prime
-
-    /* allocate hashtable */
-    miHshPme = liSzeIdx ;                                   // keep for reference
-    miHshSze = miHshPme * (sizeof(off_t) + sizeof(hkey));   // convert to bytes
-    mzHshTblPos = (off_t *) malloc(miHshPme *               // allocate and initialize
-                        (sizeof(off_t) + sizeof(hkey))) ;
-    mkHshTblHsh = (hkey *) &mzHshTblPos[miHshPme] ;         // set address of hashes
-    miLodCnt = miHshPme ;
-
-    #if debug
-      if (JDebug::gbDbg[DBGHSH])
-        fprintf(JDebug::stddbg, "Hash Ini sizeof=%2ld+%2ld=%2ld, %d samples, %d bytes, address=%p-%p,%p-%p.\n",
-            sizeof(hkey), sizeof(off_t), sizeof(hkey) + sizeof(off_t),
-            miHshPme, miHshSze,
-            mzHshTblPos, &mzHshTblPos[miHshPme], mkHshTblHsh, &mkHshTblHsh[miHshPme]) ;
-    #endif
-    #ifdef JDIFF_THROW_BAD_ALLOC
-      if ( mzHshTblPos == null ) {
-          throw bad_alloc() ;
-      }
-    #endif // JDIFF_THROW_BAD_ALLOC
+    if (mbBkt) {
+        liSzeIdx = (liSzeIdx * 1024 * 1024) / HSHBKTSZE ;      // convert Mb to number of buckets
+        liSzeIdx = getLowerPrime(liSzeIdx);                     // find nearest lower prime
+
+        /* allocate hashtable, aligned on a cache line, with all slots empty */
+        miHshPme = liSzeIdx ;                                   // keep for reference
+        miHshCap = miHshPme * HSHBKTSLT ;                       // number of slots
+        miHshSze = miHshPme * HSHBKTSZE ;                       // convert to bytes
+        mpHshMem = malloc(miHshSze + HSHBKTSZE) ;
+        if (mpHshMem != null) {
+            mpHshBkt = (rHshBkt *) (((uintptr_t) mpHshMem + HSHBKTSZE - 1) & ~ (uintptr_t) (HSHBKTSZE - 1)) ;
+            memset(mpHshBkt, 0, miHshSze) ;
+        }
+        miLodCnt = miHshCap ;
+
+        #if debug
+          if (JDebug::gbDbg[DBGHSH])
+            fprintf(JDebug::stddbg, "Hash Ini buckets=%d*%d slots, %d bytes, address=%p-%p.\n",
+                miHshPme, HSHBKTSLT, miHshSze, mpHshBkt, &mpHshBkt[miHshPme]) ;
+        #endif
+        #ifdef JDIFF_THROW_BAD_ALLOC
+          if ( mpHshMem == null ) {
+              throw bad_alloc() ;
+          }
+        #endif // JDIFF_THROW_BAD_ALLOC
+    } else {
+        liSzeIdx = (liSzeIdx * 1024 * 1024) /                   // convert Mb to number of elements
+                        (sizeof(hkey)+sizeof(off_t));
+        liSzeIdx = getLowerPrime(liSzeIdx);                     // find nearest lower prime
+
+        /* allocate hashtable */
+        miHshPme = liSzeIdx ;                                   // keep for reference
+        miHshCap = miHshPme ;
+        miHshSze = miHshPme * (sizeof(off_t) + sizeof(hkey));   // convert to bytes
+        mzHshTblPos = (off_t *) malloc(miHshPme *               // allocate and initialize
+                            (sizeof(off_t) + sizeof(hkey))) ;
+        mkHshTblHsh = (hkey *) &mzHshTblPos[miHshPme] ;         // set address of hashes
+        miLodCnt = miHshPme ;
+
+        #if debug
+          if (JDebug::gbDbg[DBGHSH])
+            fprintf(JDebug::stddbg, "Hash Ini sizeof=%2ld+%2ld=%2ld, %d samples, %d bytes, address=%p-%p,%p-%p.\n",
+                sizeof(hkey), sizeof(off_t), sizeof(hkey) + sizeof(off_t),
+                miHshPme, miHshSze,
+                mzHshTblPos, &mzHshTblPos[miHshPme], mkHshTblHsh, &mkHshTblHsh[miHshPme]) ;
+        #endif
+        #ifdef JDIFF_THROW_BAD_ALLOC
+          if ( mzHshTblPos == null ) {
+              throw bad_alloc() ;
+          }
+        #endif // JDIFF_THROW_BAD_ALLOC
+    }
 }
 
 /*
  * Destructor
  */
 JHashPos::~JHashPos() {
+	free(mpHshMem);
+	mpHshMem = null ;
+	mpHshBkt = null ;
 	free(mzHshTblPos);
 	mzHshTblPos = null ;
 	mkHshTblHsh = null ;
@@ -97,6 +126,21 @@ JHashPos::~JHashPos() {
  * @param aiEqlCnt      Quality of the sample
  */
 void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
+    /* With anchors, store anchors only
+     * Every time the load factor increases by 1, anchors start to overwrite each other
+     * and the distance between the anchors left in the table grows by about 2^miAncBit.
+     */
+    if (miAncBit >= 0) {
+        if (anchor(akCurHsh)) {
+            storeanchor(akCurHsh, azPos) ;
+            if (-- miLodCnt <= 0) {
+                miLodCnt = miHshCap ;
+                miHshRlb += 2 << miAncBit ;
+            }
+        }
+        return ;
+    }
+
     /* Every time the load factor increases by 1
      * - increase miHshColMax: the ratio at which we store values to achieve a uniform distribution of samples
      * - increase miHshRlb: the number of bytes to verify (reliability range) to be sure there is no match
@@ -104,9 +148,12 @@ void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
     if ( miLodCnt > 0 ) {
         miLodCnt -- ;
     } else {
-        miLodCnt = miHshPme ;
-        miHshColMax += COLLISION_THRESHOLD ;
-        miHshRlb += 4 ;
+        miLodCnt = miHshCap ;
+        /* with a sliding window, expired entries do not count: stop once the window is covered */
+        if (! mbWin || (off_t) (miHshColMax / COLLISION_THRESHOLD) * miHshCap < azPos - mzWinBse) {
+            miHshColMax += COLLISION_THRESHOLD ;
+            miHshRlb += 4 ;
+        }
     }
 
     /* Increase the collision strategy counter
@@ -120,32 +167,186 @@ void JHashPos::add (hkey akCurHsh, off_t azPos, int aiEqlCnt ){
 
     /* store key and value when the collision counter reaches the collision threshold */
     if (miHshColCnt <= 0 ) {
-        /* calculate the index in the hashtable for the given key */
-        int liIdx = (akCurHsh % miHshPme) ;
-
         /* debug */
         #if debug
         if (JDebug::gbDbg[DBGHSH])
-            fprintf(JDebug::stddbg, "Hash Add %8d " P8zd " %8" PRIhkey " %c\n",
-                    liIdx, azPos, akCurHsh,
-                    (mkHshTblHsh[liIdx] == 0)?'.':'!');
+            fprintf(JDebug::stddbg, "Hash Add %8d " P8zd " %8" PRIhkey "\n",
+                    (int) (akCurHsh % miHshPme), azPos, akCurHsh);
         #endif
 
         /* store */
-        mkHshTblHsh[liIdx] = akCurHsh ;
-        mzHshTblPos[liIdx] = azPos ;
+        store(akCurHsh, azPos) ;
         miHshColCnt = miHshColMax ; // reset subsequent lost collisions counter
     }
 } /* ufHshAdd */
 
+/**
+* @brief Store an anchor, unless its slot holds an anchor of lower rank.
+*
+* Empty slots (key 0), expired slots and slots holding the same key are
+* always taken. In a full bucket, the anchor of highest rank is replaced.
+*/
+void JHashPos::storeanchor (hkey const akCurHsh, off_t const azPos) {
+    int liIdx = (akCurHsh % miHshPme) ;
+
+    if (mbBkt) {
+        uint32_t lkKey = (uint32_t) (akCurHsh / miHshPme) | 1 ;
+        rHshBkt &lrBkt = mpHshBkt[liIdx] ;
+        int liMax = 0 ;
+        int liSlt ;
+        for (liSlt = 0; liSlt < HSHBKTSLT; liSlt++) {
+            if (lrBkt.ikKey[liSlt] == lkKey || lrBkt.ikKey[liSlt] == 0
+                    || lrBkt.izPos[liSlt] < mzWinBse)
+                break ;
+            if (rankbkt(lrBkt.ikKey[liSlt]) > rankbkt(lrBkt.ikKey[liMax]))
+                liMax = liSlt ;
+        }
+        if (liSlt == HSHBKTSLT) {
+            if (rankbkt(lkKey) > rankbkt(lrBkt.ikKey[liMax]))
+                return ;
+            liSlt = liMax ;
+        }
+        lrBkt.ikKey[liSlt] = lkKey ;
+        lrBkt.izPos[liSlt] = azPos ;
+    } else {
+        hkey lkOld = mkHshTblHsh[liIdx] ;
+        if (lkOld != 0 && lkOld != akCurHsh && mzHshTblPos[liIdx] >= mzWinBse
+                && rank(akCurHsh) > rank(lkOld))
+            return ;
+        mkHshTblHsh[liIdx] = akCurHsh ;
+        mzHshTblPos[liIdx] = azPos ;
+    }
+} /* storeanchor */
+
+/**
+* @brief Use content-defined anchors instead of the collision strategy.
+*
+* Anchors are one every 2^aiBit bytes on average, so a match should be found
+* within about twice that distance: that is the reliability range.
+*
+* @param aiBit  number of bits in the anchor mask, -1 = collision strategy
+*/
+void JHashPos::set_anchors (int aiBit) {
+    if (aiBit > SMPSZE / 2)
+        aiBit = SMPSZE / 2 ;
+    miAncBit = aiBit ;
+    if (aiBit > 0)
+        mkAncMsk = ~ (hkey) 0 << (SMPSZE - aiBit) ;
+    else
+        mkAncMsk = 0 ;
+    if (aiBit >= 0 && ! mbBkt && mzHshTblPos != null)
+        memset(mzHshTblPos, 0, miHshSze) ;     // empty slots: storeanchor compares ranks
+    reset() ;
+}
+
+/**
+* @brief Get the state of the collision strategy.
+*/
+void JHashPos::getstate(rSmpSte &arSte) const {
+    arSte.iiColMax = miHshColMax ;
+    arSte.iiColCnt = miHshColCnt ;
+    arSte.iiRlb    = miHshRlb ;
+    arSte.iiLodCnt = miLodCnt ;
+}
+
+/**
+* @brief Set the state of the collision strategy.
+*/
+void JHashPos::setstate(rSmpSte const &arSte) {
+    miHshColMax = arSte.iiColMax ;
+    miHshColCnt = arSte.iiColCnt ;
+    miHshRlb    = arSte.iiRlb ;
+    miLodCnt    = arSte.iiLodCnt ;
+}
+
+/**
+* @brief Advance the collision strategy over a number of high quality samples.
+*
+* Between two load increments, the collision counter decreases by COLLISION_HIGH
+* for every sample and is reset to miHshColMax on every store, so the state
+* can be calculated without visiting every sample.
+*
+* @param arSte      in/out: state of the collision strategy
+* @param azCnt      number of samples to skip
+*/
+void JHashPos::skip(rSmpSte &arSte, off_t azCnt) const {
+    off_t lzRun ;   /**< number of samples before the next load increment */
+    off_t lzCyc ;   /**< number of samples between two stores             */
+
+    while (azCnt > 0) {
+        // samples that only decrement the load counter
+        lzRun = (azCnt < arSte.iiLodCnt) ? azCnt : arSte.iiLodCnt ;
+        if (lzRun > 0) {
+            arSte.iiLodCnt -= lzRun ;
+            azCnt -= lzRun ;
+            if (arSte.iiColCnt > lzRun * COLLISION_HIGH) {
+                arSte.iiColCnt -= lzRun * COLLISION_HIGH ;
+            } else {
+                // first store, then cycle
+                lzRun -= (arSte.iiColCnt + COLLISION_HIGH - 1) / COLLISION_HIGH ;
+                lzCyc  = (arSte.iiColMax + COLLISION_HIGH - 1) / COLLISION_HIGH ;
+                arSte.iiColCnt = arSte.iiColMax - (lzRun % lzCyc) * COLLISION_HIGH ;
+            }
+        }
+
+        // sample that increments the load
+        if (azCnt > 0) {
+            sample(arSte, 0) ;
+            azCnt -- ;
+        }
+    }
+}
+
+/**
+* @brief Write the hashtable and its state to a file.
+*
+* @param  apFil     file to write to
+* @return EXI_OK or EXI_WRI
+*/
+int JHashPos::save (FILE *apFil) const {
+    int liHdr[8] = { miHshPme, miHshCap, miHshColMax, miHshColCnt, miHshRlb, miLodCnt, miAncBit, mbBkt } ;
+
+    if (fwrite(liHdr, sizeof(liHdr), 1, apFil) != 1)
+        return EXI_WRI ;
+    if (fwrite(mbBkt ? (void *) mpHshBkt : (void *) mzHshTblPos, miHshSze, 1, apFil) != 1)
+        return EXI_WRI ;
+    return EXI_OK ;
+}
+
+/**
+* @brief Read the hashtable and its state from a file written by save().
+*
+* @param  apFil     file to read from
+* @return EXI_OK, EXI_RED on read errors, EXI_ERR if the table size, layout or anchors differ
+*/
+int JHashPos::load (FILE *apFil) {
+    int liHdr[8] ;
+
+    if (fread(liHdr, sizeof(liHdr), 1, apFil) != 1)
+        return EXI_RED ;
+    if (liHdr[0] != miHshPme || liHdr[1] != miHshCap || liHdr[6] != miAncBit || liHdr[7] != mbBkt)
+        return EXI_ERR ;
+    if (fread(mbBkt ? (void *) mpHshBkt : (void *) mzHshTblPos, miHshSze, 1, apFil) != 1)
+        return EXI_RED ;
+
+    miHshColMax = liHdr[2] ;
+    miHshColCnt = liHdr[3] ;
+    miHshRlb    = liHdr[4] ;
+    miLodCnt    = liHdr[5] ;
+    return EXI_OK ;
+}
+
 /**
 * @brief  Hashtable reset: consider table to be empty
 */
 void JHashPos::reset () {
-    miLodCnt = miHshPme ;
+    miLodCnt = miHshCap ;
     miHshColMax = COLLISION_THRESHOLD;
     miHshColCnt = COLLISION_THRESHOLD;
-    miHshRlb = SMPSZE + SMPSZE / 2;
+    if (miAncBit >= 0)
+        miHshRlb = SMPSZE + (2 << miAncBit) ;
+    else
+        miHshRlb = SMPSZE + SMPSZE / 2;
 };
 
 
@@ -155,31 +356,68 @@ void JHashPos::reset () {
  * @param lzPos     out: position found
  * @return true=found, false=notfound
  */
-bool JHashPos::get (const hkey akCurHsh, off_t &azPos)
+bool JHashPos::get (const hkey akCurHsh, off_t &azPos) const
 { int   liIdx ;
 
+  /* with anchors, other keys are never stored */
+  if (miAncBit >= 0 && ! anchor(akCurHsh))
+    return false ;
+
   /* calculate key and the corresponding entries' address */
   liIdx    = (akCurHsh % miHshPme) ;
 
-  /* lookup value into hashtable for new file */
-  if (mkHshTblHsh[liIdx] == akCurHsh)  {
-    miHshHit++;
-    azPos = mzHshTblPos[liIdx];
-    return true ;
+  if (mbBkt) {
+    /* lookup key fragment within the bucket */
+    uint32_t lkKey = (uint32_t) (akCurHsh / miHshPme) | 1 ;
+    rHshBkt const &lrBkt = mpHshBkt[liIdx] ;
+    for (int liSlt = 0; liSlt < HSHBKTSLT; liSlt++) {
+      if (lrBkt.ikKey[liSlt] == lkKey) {
+        azPos = lrBkt.izPos[liSlt] ;
+        return azPos >= mzWinBse ;
+      }
+    }
+  } else {
+    /* lookup value into hashtable for new file */
+    if (mkHshTblHsh[liIdx] == akCurHsh)  {
+      azPos = mzHshTblPos[liIdx];
+      return azPos >= mzWinBse ;
+    }
   }
   return false ;
 }
 
+/**
+ * @brief Get the content of a slot (for print and dist)
+ * @param aiSlt     slot number, 0 to miHshCap - 1
+ * @param azPos     out: position
+ * @param akKey     out: key (fragment)
+ * @return false = empty slot
+ */
+bool JHashPos::getslot(int aiSlt, off_t &azPos, hkey &akKey) const
+{
+  if (mbBkt) {
+    rHshBkt const &lrBkt = mpHshBkt[aiSlt / HSHBKTSLT] ;
+    azPos = lrBkt.izPos[aiSlt % HSHBKTSLT] ;
+    akKey = lrBkt.ikKey[aiSlt % HSHBKTSLT] ;
+    return akKey != 0 ;
+  }
+  azPos = mzHshTblPos[aiSlt] ;
+  akKey = mkHshTblHsh[aiSlt] ;
+  return azPos != 0 ;
+}
+
 /**
  * @brief Print hashtable content (for debugging or auditing)
  */
 void JHashPos::print(){
     int liHshIdx;
+    off_t lzPos ;
+    hkey lkKey ;
 
-    for (liHshIdx = 0; liHshIdx < miHshPme; liHshIdx ++)  {
-        if (mzHshTblPos[liHshIdx] != 0) {
+    for (liHshIdx = 0; liHshIdx < miHshCap; liHshIdx ++)  {
+        if (getslot(liHshIdx, lzPos, lkKey)) {
             fprintf(JDebug::stddbg, "Hash Pnt %12d " P8zd "-%08" PRIhkey "x\n", liHshIdx,
-                    mzHshTblPos[liHshIdx], mkHshTblHsh[liHshIdx]) ;
+                    lzPos, lkKey) ;
         }
     }
 }
@@ -194,6 +432,8 @@ void JHashPos::dist(off_t azMax, int aiBck){
     int liHshDiv;   // Number of positions by bucket
     int *liBckCnt;  // Number of elements by bucket
     int liIdx;
+    off_t lzPos ;
+    hkey lkKey ;
 
     int liCnt = 0 ;
     int liMin = INT_MAX ;
@@ -209,9 +449,9 @@ void JHashPos::dist(off_t azMax, int aiBck){
 
     	/* Fill the buckets */
     	liHshDiv = (azMax / aiBck) ;
-        for (liHshIdx = 0; liHshIdx < miHshPme; liHshIdx ++)  {
-            if (mzHshTblPos[liHshIdx] > 0 && mzHshTblPos[liHshIdx] <= azMax) {
-            	liIdx =mzHshTblPos[liHshIdx] / liHshDiv ;
+        for (liHshIdx = 0; liHshIdx < miHshCap; liHshIdx ++)  {
+            if (getslot(liHshIdx, lzPos, lkKey) && lzPos > 0 && lzPos <= azMax) {
+            	liIdx = lzPos / liHshDiv ;
             	if (liIdx >= aiBck) {
             		liIdx = 0 ;
             	} else {
@@ -233,7 +473,7 @@ void JHashPos::dist(off_t azMax, int aiBck){
         fprintf(JDebug::stddbg, "Hash Dist Avg/Min/Max/%% = %d/%d/%d/%d%%\n",
                 liCnt / aiBck, liMin, liMax, liMax > 0 ? (100 - (liMin / (liMax / 100))) : -1);
         fprintf(JDebug::stddbg, "Hash Dist Load          = %d/%d=%d%%\n",
-                liCnt, miHshPme, miHshPme > 0 ? (liCnt / (miHshPme / 100)) : -1);
+                liCnt, miHshCap, miHshCap >= 100 ? (liCnt / (miHshCap / 100)) : -1);
     }
 } /* JHasPos::dist */
 
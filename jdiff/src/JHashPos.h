@@ -65,7 +65,14 @@
  * Largest n-bit primes: 251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521,
  *                       131071 (17 bit), ..., 4294967291 (32 bit)
  *
- * Table entries contain a 32-bit hash value and a file position.
+ * Table entries contain a hash value and a file position.
+ *
+ * Optionally (-B), the table consists of buckets of one cache line (64 bytes),
+ * each holding HSHBKTSLT slots. A slot contains a 32-bit key fragment and a file
+ * position: the key selects the bucket and the fragment identifies the key within
+ * the bucket. A lookup therefore costs a single cache miss. A new sample takes
+ * the slot holding the same fragment, else an empty slot, else a slot chosen by
+ * the fragment itself, so that collisions replace entries evenly.
  *
  * The collision strategy tries to create a uniform distributed set of samples
  * over the  investigated  region,  which is  either  the  whole  file or  the
@@ -85,9 +92,33 @@
  * Only samples from the original file are stored.
  * Samples from the new file are looked up.
  *
+ * With content-defined anchors (option -A), the collision strategy is not used.
+ * Instead, a sample is stored only when its key, mixed by a multiplication,
+ * has its high bits (the anchor mask) all zero. The key only depends on the
+ * last SMPSZE bytes, so both files select the same anchors wherever shifted
+ * content ends up, and lookups can skip keys that are not anchors. The number
+ * of mask bits sets the density: one anchor every 2^bits bytes on average.
+ * When anchors collide, the one of lowest rank (its mixed key) keeps the slot,
+ * instead of the last one stored: an overloaded table then keeps an evenly spread
+ * subset of the anchors, as if more mask bits had been used, instead of only
+ * the anchors near the end of the source file.
+ *
+ * Anchors are a trade-off, not a better sampling: lookups are cheaper (most keys
+ * are skipped), but the distance between anchors is random where the collision
+ * strategy spreads samples evenly. With a heavily overloaded table (a small -i
+ * for the source size) sampling finds more matches, with a larger table both
+ * give about the same diff.
+ *
+ * With a sliding window (sequential source file, option -p), positions before
+ * the window base can no longer be read back. Such entries are expired: lookups
+ * ignore them and new samples take their slots. The load then only grows until
+ * the table covers the window, so that the sampling rate stays constant while
+ * streaming through files of any size.
+ *
  * The investigated region is either
  * - the whole file when the prescan option is used (default)
  * - the look-ahead region otherwise (option -ff)
+ * - the sliding window on a sequential source file (option -p)
  *
  * With prescan enabled, the algorithm behaves like a kind of
  * copy/insert algorithm (simulated with insert/delete/modify and backtrace
@@ -98,11 +129,32 @@
 #ifndef JHASHPOS_H_
 #define JHASHPOS_H_
 
+#include <stdint.h>
+
 #include "JDefs.h"
 #include "JDebug.h"
 
 namespace JojoDiff {
 
+const int COLLISION_THRESHOLD = 4 ; /* override when collision counter exceeds threshold  */
+const int COLLISION_HIGH = 4 ;      /* rate at which high quality samples should override */
+const int COLLISION_LOW = 1 ;       /* rate at which low quality samples should override  */
+const hkey ANCHOR_MUL = (hkey) 0x9E3779B97F4A7C15ULL ; /* mixes all key bits into the high bits */
+const uint32_t ANCHOR_MUL32 = 0x9E3779B1U ;          /* same, on the key fragments of buckets */
+
+const int HSHBKTSZE = 64 ;          /* bucket size in bytes: one cache line               */
+const int HSHBKTSLT = HSHBKTSZE / (int) (sizeof(off_t) + sizeof(uint32_t)) ; /* slots     */
+
+/*
+ * Hashtable bucket: positions and key fragments of HSHBKTSLT slots.
+ * A zero key fragment marks an empty slot.
+ */
+typedef struct alignas(HSHBKTSZE) tHshBkt {
+    off_t    izPos[HSHBKTSLT] ;     /**< Positions within the original file   */
+    uint32_t ikKey[HSHBKTSLT] ;     /**< Key fragments, 0 = empty slot        */
+} rHshBkt ;
+static_assert(sizeof(rHshBkt) == HSHBKTSZE, "hashtable bucket must fill one cache line") ;
+
 /*
  * Hashtable of file positions for JDiff.
  */
@@ -116,8 +168,9 @@ public:
      * of 8191 elements.
      *
      * @param aiSze   size, in number of elements.
+     * @param abBkt   use cache-line sized buckets instead of flat arrays ?
      */
-	JHashPos(int aiSze);
+	JHashPos(int aiSze, bool abBkt=false);
 
 	virtual ~JHashPos();
 	JHashPos(JHashPos const&) = delete ;
@@ -139,7 +192,174 @@ public:
 	* @param  &azPos    Output: Associated file position
 	* @return false = key not found, true = key found
 	*/
-	bool get (const hkey akCurHsh, off_t &azPos) ;
+	bool get (const hkey akCurHsh, off_t &azPos) const ;
+
+	/**
+	* @brief Prefetch the table entry of a key ahead of its lookup with get().
+	*
+	* @param  akCurHsh  Input:  Hashkey
+	*/
+	inline void prefetch (const hkey akCurHsh) const {
+#ifdef __GNUC__
+	    if (miAncBit >= 0 && ! anchor(akCurHsh))
+	        return ;
+	    if (mbBkt)
+	        __builtin_prefetch(&mpHshBkt[akCurHsh % miHshPme]) ;
+	    else
+	        __builtin_prefetch(&mkHshTblHsh[akCurHsh % miHshPme]) ;
+#endif // __GNUC__
+	}
+
+	/**
+	* @brief Use content-defined anchors instead of the collision strategy.
+	*
+	* @param aiBit  number of bits in the anchor mask: one anchor every 2^aiBit
+	*               positions on average, -1 = use the collision strategy
+	*/
+	void set_anchors (int aiBit) ;
+
+	/**
+	* @brief Slide the window: expire entries before the given position.
+	*
+	* @param azBse  first position of the window (oldest position to keep)
+	*/
+	inline void set_window (off_t const azBse) {
+	    mbWin = true ;
+	    mzWinBse = azBse ;
+	}
+
+	/**
+	* @brief Return the number of bits in the anchor mask, -1 = no anchors.
+	*/
+	inline int get_anchors() const {
+	    return miAncBit ;
+	}
+
+	/**
+	* @brief Is the key an anchor (see set_anchors) ?
+	*/
+	inline bool anchor (hkey const akCurHsh) const {
+	    return ((hkey) (akCurHsh * ANCHOR_MUL) & mkAncMsk) == 0 ;
+	}
+
+	/**
+	* @brief State of the collision strategy used by add().
+	*
+	* Allows to replay the collision strategy outside of the table, e.g. on
+	* a slice of the source file in a separate thread (see JDiff::buildFullIndex).
+	*/
+	typedef struct tSmpSte {
+	    int iiColMax ;          /**< max number of collisions before override    */
+	    int iiColCnt ;          /**< current number of subsequent collisions     */
+	    int iiRlb ;             /**< reliability range                           */
+	    int iiLodCnt ;          /**< load-counter                                */
+	} rSmpSte ;
+
+	/**
+	* @brief Get/set the state of the collision strategy.
+	*/
+	void getstate(rSmpSte &arSte) const ;
+	void setstate(rSmpSte const &arSte) ;
+
+	/**
+	* @brief Collision strategy of add(): should the next sample be stored ?
+	*
+	* @param arSte      in/out: state of the collision strategy
+	* @param aiEqlCnt   Indication of equal bytes within the sample
+	* @return true = store the sample
+	*/
+	inline bool sample (rSmpSte &arSte, int const aiEqlCnt) const {
+	    if ( arSte.iiLodCnt > 0 ) {
+	        arSte.iiLodCnt -- ;
+	    } else {
+	        arSte.iiLodCnt = miHshCap ;
+	        arSte.iiColMax += COLLISION_THRESHOLD ;
+	        arSte.iiRlb += 4 ;
+	    }
+	    arSte.iiColCnt -= (aiEqlCnt <= SMPSZE * 2) ? COLLISION_HIGH : COLLISION_LOW ;
+	    if (arSte.iiColCnt <= 0) {
+	        arSte.iiColCnt = arSte.iiColMax ;
+	        return true ;
+	    }
+	    return false ;
+	}
+
+	/**
+	* @brief Advance the collision strategy over a number of high quality samples.
+	*
+	* Equivalent to calling sample() azCnt times with aiEqlCnt <= SMPSZE * 2,
+	* which is always the case for samples produced by JDiff::hash.
+	*
+	* @param arSte      in/out: state of the collision strategy
+	* @param azCnt      number of samples to skip
+	*/
+	void skip (rSmpSte &arSte, off_t azCnt) const ;
+
+	/**
+	* @brief Store a sample selected by sample() into the table.
+	*/
+	inline void store (hkey const akCurHsh, off_t const azPos) {
+	    int liIdx = (akCurHsh % miHshPme) ;
+	    if (mbBkt) {
+	        storebkt(akCurHsh, liIdx, azPos) ;
+	    } else {
+	        mkHshTblHsh[liIdx] = akCurHsh ;
+	        mzHshTblPos[liIdx] = azPos ;
+	    }
+	}
+
+	/**
+	* @brief Store an anchor, unless its slot holds an anchor of higher rank (see add).
+	*/
+	void storeanchor (hkey const akCurHsh, off_t const azPos) ;
+
+	/**
+	* @brief Rank of an anchor: the lower, the stronger (see storeanchor).
+	*
+	* The rank only depends on the key, and in the bucket layout on its stored
+	* fragment, so which anchors survive does not depend on the order of insertion.
+	*/
+	static inline hkey rank (hkey const akCurHsh) {
+	    return (hkey) (akCurHsh * ANCHOR_MUL) ;
+	}
+	static inline uint32_t rankbkt (uint32_t const akKey) {
+	    return (uint32_t) (akKey * ANCHOR_MUL32) ;
+	}
+
+	/**
+	* @brief Store a sample into its bucket (see store).
+	*/
+	inline void storebkt (hkey const akCurHsh, int const aiIdx, off_t const azPos) {
+	    uint32_t lkKey = (uint32_t) (akCurHsh / miHshPme) | 1 ;
+	    rHshBkt &lrBkt = mpHshBkt[aiIdx] ;
+	    int liSlt ;
+	    for (liSlt = 0; liSlt < HSHBKTSLT; liSlt++)
+	        if (lrBkt.ikKey[liSlt] == lkKey || lrBkt.ikKey[liSlt] == 0
+	                || lrBkt.izPos[liSlt] < mzWinBse)
+	            break ;
+	    if (liSlt == HSHBKTSLT)
+	        liSlt = (lkKey >> 1) % HSHBKTSLT ;
+	    lrBkt.ikKey[liSlt] = lkKey ;
+	    lrBkt.izPos[liSlt] = azPos ;
+	}
+
+	/**
+	* @brief Write the hashtable and its state to a file (see JDiff::saveIndex).
+	*
+	* @param  apFil     file to write to
+	* @return EXI_OK or EXI_WRI
+	*/
+	int save (FILE *apFil) const ;
+
+	/**
+	* @brief Read the hashtable and its state from a file written by save().
+	*
+	* The table must have the same size (prime) as the saved one.
+	*
+	* @param  apFil     file to read from
+	* @return EXI_OK, EXI_RED on read errors, EXI_ERR if the table size differs
+	*/
+	int load (FILE *apFil) ;
 
 	/**
 	* @brief  Hashtable reset: consider table to be empty
@@ -169,27 +389,49 @@ public:
 	void dist(off_t azMax, int aiBck);
 
 	/**
-    * @brief return hashtable prime number
+    * @brief return hashtable prime number (number of buckets with the bucket layout)
     */
 	int get_hashprime(){return miHshPme;}
 
+	/**
+	* @brief return hashtable capacity in number of samples
+	*/
+	int get_hashcapacity(){return miHshCap;}
+
 	/**
 	* @brief return hashtable size in bytes
 	*/
 	int get_hashsize(){return miHshSze;}
 
+	/**
+	* @brief return whether the table consists of buckets
+	*/
+	bool get_buckets(){return mbBkt;}
+
 	/**
 	* @brief return hastable collision override threshold
 	*/
 	int get_hashcolmax(){return miHshColMax;}
 
+
+private:
 	/**
-	* @brief return number of hits found by this hashtable
+	* @brief Get the content of a slot (for print and dist)
+	*
+	* @param  aiSlt     slot number, 0 to miHshCap - 1
+	* @param  azPos     out: position
+	* @param  akKey     out: key (fragment)
+	* @return false = empty slot
 	*/
-	int get_hashhits(){return miHshHit;}
+	bool getslot(int aiSlt, off_t &azPos, hkey &akKey) const ;
 
-private:
-	/* The hash table. Using a struct causes certain compilers (gcc) to align        */
+	bool     mbBkt ;             /**< Layout: buckets or flat arrays                        */
+
+	/* Bucket layout */
+	void    *mpHshMem=null ;     /**< Allocated memory                                      */
+	rHshBkt *mpHshBkt=null ;     /**< Buckets, aligned on a cache line within mpHshMem      */
+
+	/* Flat layout: the hash table. Using a struct causes certain compilers (gcc) to align        */
 	/* fields on 64-bit boundaries, causing 25% memory loss. Therefore, I use        */
 	/* two arrays instead of an array of structs.                                    */
 	off_t *mzHshTblPos=null ;    /**< Hash values: positions within the original file       */
@@ -197,6 +439,7 @@ private:
 
 	/* Size */
 	int miHshPme=0  ;       /**< prime number for size and hashing              				*/
+	int miHshCap=0 ;        /**< Capacity in number of samples                  				*/
 	int miHshSze=0 ;        /**< Actual size in bytes of the hashtable          				*/
 
     /* State */
@@ -205,8 +448,13 @@ private:
 	int miHshRlb ;          /**< hashtable reliability: decreases as the overloading grows 	  */
     int miLodCnt=0 ;        /**< hashtable load-counter                                       */
 
-    /* Statistics */
-    int miHshHit;           /**< number of hits found by this hashtable                       */
+    /* Content-defined anchors */
+    int  miAncBit=-1 ;      /**< bits in the anchor mask, -1 = collision strategy             */
+    hkey mkAncMsk=0 ;       /**< anchor mask on the mixed key                                 */
+
+    /* Sliding window */
+    bool  mbWin=false ;     /**< sliding window in use (see set_window)                       */
+    off_t mzWinBse=0 ;      /**< entries before this position are expired                     */
 };
 }
 #endif /* JHASHPOS_H_ */
@@ -41,6 +41,11 @@ namespace JojoDiff {
 #define MINDST 1024             // Min compare distance \ on SSD +/- 4ms at 1Gb/s   +  1ms seek time
 #define MAXGLD 128              // Max distance for gliding matches
 
+// Batched verification of matches outside the source buffer
+#define VFYBUF 1024 * 1024      // Scratch buffer: maximum size of a read
+#define VFYGAP 64 * 1024        // Maximum gap between verifications read together
+#define VFYWIN 4 * MINDST       // Maximum distance compared from the scratch buffer
+
 // Fuzzy factor: for differences smaller than this number of bytes, take the longest looking sequence
 // Reason: control bytes consume byte to, so taking the longer one is better
 #define FZY 0
@@ -102,6 +107,16 @@ JMatchTable::JMatchTable (
           throw bad_alloc() ;
       }
     #endif // JDIFF_THROW_BAD_ALLOC
+
+    // allocate the pending verifications
+    if (mbCmpAll) {
+        msVfy = (rVfy *) malloc(sizeof(rVfy) * miMchSze) ;
+        #ifdef JDIFF_THROW_BAD_ALLOC
+        if ( msVfy == null ) {
+            throw bad_alloc() ;
+        }
+        #endif
+    }
 }
 
 /* Destructor */
@@ -109,6 +124,8 @@ JMatchTable::~JMatchTable() {
     free(msMch);
     free(mpCol);
     free(mpGld);
+    free(msVfy);
+    free(mpVfyBuf);
 }
 
 /**
@@ -396,14 +413,21 @@ JMatchTable::eMatchReturn JMatchTable::cleanup ( off_t const azBseOrg, off_t con
     }
     #endif
 
+    // mark very old elements, and elements before the source base, as skipped
+    for (lpCur = mpOld ; lpCur != null; lpCur = lpCur->ipNxt)
+        if (isOld2Skip(lpCur, azRedNew) || lpCur->izNew + lpCur->izDlt < azBseOrg)
+            lpCur->iiCmp = CMPSKP ;
+
+    // verify the elements outside the source buffer together
+    if (mbCmpAll)
+        verify(azRedNew) ;
+
     // evaluate existing entries
     mpBst = null ;  // reset best pointer
     mzOld = azRedNew ;
 
     for (lpCur = mpOld ; lpCur != null; lpCur = lpCur->ipNxt)
-        if (isOld2Skip(lpCur, azRedNew))
-            lpCur->iiCmp = CMPSKP ;         // Mark very old elements as skipped
-        else
+        if (lpCur->iiCmp != CMPSKP)
             isGoodOrBest(azRedNew, lpCur) ;
 
     // prepare the oldlist
@@ -537,6 +561,127 @@ JMatchTable::eMatchReturn JMatchTable::isGoodOrBest(
         return Valid ;
 } /* isGoodOrBest */
 
+/**
+* @brief Verify the matches whose source data is not buffered.
+*
+* Collects the compares that isGoodOrBest would do on source data outside the
+* buffer, sorts them on source position and reads nearby ones together into
+* a scratch buffer. The compares are done on the scratch buffer (or on the
+* file when running out of it) and their results are stored in the matches,
+* so that isGoodOrBest reuses them.
+*/
+void JMatchTable::verify(off_t const azRedNew){
+    rMch *lpCur ;           /**< current element                */
+    rVfy *lpVfy ;           /**< current verification           */
+    int liVfy = 0 ;         /**< number of verifications        */
+    int liBeg ;             /**< first verification of cluster  */
+    int liEnd ;             /**< last verification of cluster   */
+    int liWin ;             /**< source bytes of a verification */
+    int liCmp ;             /**< compare result                 */
+    bool lbGld ;            /**< gliding match                  */
+    off_t lzTstOrg ;        /**< test position in old file      */
+    off_t lzTstNew ;        /**< test position in new file      */
+    off_t lzDst ;           /**< number of bytes to compare     */
+    off_t lzBse ;           /**< start of cluster               */
+    off_t lzLen ;           /**< length of cluster              */
+    long llRed ;            /**< bytes read into the scratch    */
+
+    // collect the compares that isGoodOrBest would do outside the buffer
+    for (lpCur = mpOld ; lpCur != null; lpCur = lpCur->ipNxt){
+        if (lpCur->iiCmp == CMPSKP)
+            continue ;
+
+        lzTstNew = azRedNew ;
+        lbGld = calcPosOrg(lpCur, lzTstOrg, lzTstNew);
+        if (lzTstNew <= lpCur->izTst)
+            continue ;  // previous result will be reused
+        if ((! lbGld) && (lpCur->iiCmp > 0) && (lpCur->izTst - lzTstNew + lpCur->iiCmp > EQLMIN))
+            continue ;  // previous result will be reused
+
+        lzDst = lpCur->izBeg - lzTstNew ;
+        if (lzDst < MINDST)
+            lzDst = MINDST ;
+        else if (lzDst > MAXDST)
+            lzDst = MAXDST ;
+
+        liWin = lbGld ? EQLMAX : min(lzDst, VFYWIN) + EQLMAX ;
+        if (mpFilOrg->getbuf(lzTstOrg, lzLen, JFile::SoftAhead) != null && lzLen >= liWin)
+            continue ;  // source data is buffered
+
+        lpVfy = &msVfy[liVfy++] ;
+        lpVfy->ipMch = lpCur ;
+        lpVfy->izOrg = lzTstOrg ;
+        lpVfy->izNew = lzTstNew ;
+        lpVfy->iiDst = (int) lzDst ;
+        lpVfy->iiGld = lbGld ? lpCur->iiGld : 0 ;
+    }
+    if (liVfy == 0)
+        return ;
+
+    if (mpVfyBuf == null){
+        mpVfyBuf = (jchar *) malloc(VFYBUF) ;
+        #ifdef JDIFF_THROW_BAD_ALLOC
+        if (mpVfyBuf == null) {
+            throw bad_alloc() ;
+        }
+        #endif
+    }
+    qsort(msVfy, liVfy, sizeof(rVfy), cmpVfy) ;
+
+    // announce all clusters, so that a file reading asynchronously can read them at once,
+    // then read each cluster and verify its matches
+    for (int liPas = 0 ; liPas < 2 ; liPas++){
+        for (liBeg = 0 ; liBeg < liVfy ; liBeg = liEnd){
+            lzBse = msVfy[liBeg].izOrg ;
+            lzLen = (msVfy[liBeg].iiGld != 0) ? EQLMAX : min(msVfy[liBeg].iiDst, VFYWIN) + EQLMAX ;
+            for (liEnd = liBeg + 1 ; liEnd < liVfy ; liEnd++){
+                lpVfy = &msVfy[liEnd] ;
+                liWin = (lpVfy->iiGld != 0) ? EQLMAX : min(lpVfy->iiDst, VFYWIN) + EQLMAX ;
+                if (lpVfy->izOrg > lzBse + lzLen + VFYGAP || lpVfy->izOrg + liWin - lzBse > VFYBUF)
+                    break ;
+                if (lpVfy->izOrg + liWin - lzBse > lzLen)
+                    lzLen = lpVfy->izOrg + liWin - lzBse ;
+            }
+
+            if (liPas == 0){
+                mpFilOrg->readahead(lzBse, (long) lzLen) ;
+                continue ;
+            }
+
+            llRed = mpFilOrg->read(lzBse, mpVfyBuf, (long) lzLen) ;
+            for (lpVfy = &msVfy[liBeg] ; lpVfy < &msVfy[liEnd] ; lpVfy++){
+                lzTstOrg = lpVfy->izOrg ;
+                lzTstNew = lpVfy->izNew ;
+                liCmp = check(lzTstOrg, lzTstNew, lpVfy->iiDst, lpVfy->iiGld,
+                              JFile::HardAhead, mpVfyBuf, lzBse, llRed) ;
+                if (liCmp == CMPEOB) {
+                    // ran out of the scratch buffer: compare on the file
+                    lzTstOrg = lpVfy->izOrg ;
+                    lzTstNew = lpVfy->izNew ;
+                    liCmp = check(lzTstOrg, lzTstNew, lpVfy->iiDst, lpVfy->iiGld, JFile::HardAhead) ;
+                }
+
+                // store result, as isGoodOrBest does
+                lpCur = lpVfy->ipMch ;
+                lpCur->izTst = lzTstNew ;
+                if (lpCur->iiCmp == CMPINV && liCmp <= 0)
+                    ; // don't erase an invalid marker
+                else
+                    lpCur->iiCmp = liCmp ;
+            }
+        }
+    }
+} /* verify */
+
+/**
+* @brief Order pending verifications on source position (for qsort).
+*/
+int JMatchTable::cmpVfy(void const * apOne, void const * apTwo){
+    off_t const lzOne = ((rVfy const *) apOne)->izOrg ;
+    off_t const lzTwo = ((rVfy const *) apTwo)->izOrg ;
+    return (lzOne < lzTwo) ? -1 : (lzOne > lzTwo) ? 1 : 0 ;
+}
+
 /**
 * @brief Check if given solution is the best one.
 */
@@ -809,6 +954,9 @@ bool JMatchTable::calcPosOrg(rMch * const lpCur, off_t &azTstOrg, off_t &azTstNe
  * @param   aiLen       in      number of bytes to compare
  * @param   abGld       in      check gliding match ?
  * @param   aiSft       in      1=hard read, 2=soft read
+ * @param   apOrg       in      source data to use instead of the source file (optional)
+ * @param   azOrgBse    in      source position of apOrg
+ * @param   alOrgLen    in      number of bytes in apOrg, beyond is EOB
  *
  * @return  0     : no equal bytes found
  * @return  -1    : EOB reached, no equal bytes found
@@ -816,11 +964,17 @@ bool JMatchTable::calcPosOrg(rMch * const lpCur, off_t &azTstOrg, off_t &azTstNe
  */
 int JMatchTable::check (
     off_t &azPosOrg, off_t &azPosNew,
-    int aiLen, int aiGld, const JFile::eAhead aiSft
+    int aiLen, int aiGld, const JFile::eAhead aiSft,
+    jchar const * const apOrg, off_t const azOrgBse, long const alOrgLen
 ) const {
     int lcOrg=0 ;   /**< Byte from source file */
     int lcNew=0 ;   /**< Byte from destination file */
     int liEql=0 ;   /**< Equal bytes counter */
+    int liByt=0 ;   /**< Bytes to compare one by one before looking for buffers again */
+    jchar const *lpOrg ;    /**< Buffered source data */
+    jchar const *lpNew ;    /**< Buffered destination data */
+    off_t lzOrg ;           /**< Number of bytes in lpOrg */
+    off_t lzNew ;           /**< Number of bytes in lpNew */
 
     #if debug
     if (JDebug::gbDbg[DBGCMP])
@@ -830,9 +984,33 @@ int JMatchTable::check (
     #endif
 
     /* Compare bytes */
-    for ( ; liEql < EQLMAX; aiLen--)
+    while (liEql < EQLMAX)
     {
-        if ((lcOrg = mpFilOrg->get(azPosOrg, aiSft)) < 0){
+        // Compare 64 bytes at a time where both files are buffered (not on gliding matches)
+        if (aiGld == 0 && liByt-- <= 0) {
+            if (apOrg != null) {
+                lpOrg = (azPosOrg >= azOrgBse && azPosOrg < azOrgBse + alOrgLen) ? apOrg + (azPosOrg - azOrgBse) : null ;
+                lzOrg = azOrgBse + alOrgLen - azPosOrg ;
+            } else {
+                lpOrg = mpFilOrg->getbuf(azPosOrg, lzOrg, aiSft) ;
+            }
+            if (lpOrg != null && lzOrg >= 64) {
+                lpNew = mpFilNew->getbuf(azPosNew, lzNew, aiSft) ;
+                if (lpNew != null && lzNew >= 64) {
+                    if (checkBlocks(lpOrg, lpNew, min(lzOrg, lzNew), azPosOrg, azPosNew, aiLen, liEql))
+                        break ;
+                    continue ;
+                }
+            }
+            liByt = 64 ;
+        }
+
+        if (apOrg != null)
+            lcOrg = (azPosOrg >= azOrgBse && azPosOrg < azOrgBse + alOrgLen) ? apOrg[azPosOrg - azOrgBse] : EOB ;
+        else
+            lcOrg = mpFilOrg->get(azPosOrg, aiSft) ;
+
+        if (lcOrg < 0){
             break;
         } else if ((lcNew = mpFilNew->get(azPosNew, aiSft)) < 0) {
             break;
@@ -840,6 +1018,7 @@ int JMatchTable::check (
             azPosOrg ++ ;
             azPosNew ++ ;
             liEql ++ ;
+            aiLen-- ;
         } else if (liEql >= EQLSZE) {
             break ;
         } else if (aiLen <= 0) {
@@ -851,6 +1030,7 @@ int JMatchTable::check (
             else
                 azPosOrg ++ ;
             liEql = 0;
+            aiLen-- ;
         }
     }
 
@@ -863,7 +1043,10 @@ int JMatchTable::check (
                      (lcNew>=32 && lcNew <= 127)?lcNew:' ',(uchar)lcNew);
     #endif
 
-    if (liEql > EQLMIN){
+    if (apOrg != null && lcOrg == EOB){
+        // ran out of the given source data: the result may be incomplete
+        return CMPEOB ;
+    } else if (liEql > EQLMIN){
         azPosOrg -= liEql ;
         azPosNew -= liEql ;
         return liEql ;
@@ -876,6 +1059,65 @@ int JMatchTable::check (
     }
 } /* check() */
 
+/**
+* @brief Compare buffered data 64 bytes at a time, as check does byte per byte.
+*
+* Bitmasks of equal bytes are scanned run by run: a run of equal bytes
+* increments the equal bytes counter, a run of different bytes resets it.
+* Comparing stops as check would: after EQLMAX equal bytes, on a difference
+* after EQLSZE equal bytes, or on a difference after riLen bytes.
+*/
+bool JMatchTable::checkBlocks(
+    jchar const * const apOrg, jchar const * const apNew, off_t const azLen,
+    off_t &azPosOrg, off_t &azPosNew, int &aiLen, int &aiEql
+) const {
+    uint64_t llMsk ;        /**< Equal bytes of current block           */
+    off_t lzDne = 0 ;       /**< Bytes compared                         */
+    int liBit ;             /**< Bytes compared in current block        */
+    int liRun ;             /**< Length of current run                  */
+    bool lbEnd = false ;    /**< Compare is finished                    */
+
+    while (! lbEnd && lzDne + 64 <= azLen) {
+        llMsk = maskEqual(apOrg + lzDne, apNew + lzDne) ;
+        for (liBit = 0 ; liBit < 64 ; ) {
+            // run of equal bytes, up to EQLMAX
+            liRun = (~(llMsk >> liBit) == 0) ? 64 : __builtin_ctzll(~(llMsk >> liBit)) ;
+            if (liRun >= EQLMAX - aiEql) {
+                liRun = EQLMAX - aiEql ;
+                lbEnd = true ;
+            }
+            aiEql += liRun ;
+            aiLen -= liRun ;
+            liBit += liRun ;
+            if (lbEnd || liBit == 64)
+                break ;
+
+            // difference: stop on a run of EQLSZE or at the end of the compare
+            if (aiEql >= EQLSZE || aiLen <= 0) {
+                lbEnd = true ;
+                break ;
+            }
+
+            // run of different bytes, up to the end of the compare
+            liRun = ((llMsk >> liBit) == 0) ? 64 - liBit : __builtin_ctzll(llMsk >> liBit) ;
+            if (liRun > aiLen) {
+                liRun = aiLen ;
+                lbEnd = true ;
+            }
+            aiEql = 0 ;
+            aiLen -= liRun ;
+            liBit += liRun ;
+            if (lbEnd)
+                break ;
+        }
+        lzDne += liBit ;
+    }
+
+    azPosOrg += lzDne ;
+    azPosNew += lzDne ;
+    return lbEnd ;
+} /* checkBlocks */
+
 /**
 * @brief Add element to the newlist
 */
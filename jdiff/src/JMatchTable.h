@@ -118,6 +118,17 @@ private:
 	    int iiCmp ;             /**< result of last compare                             */
 	} rMch ;
 
+	/**
+	* Pending verification: a compare to do on source data that is not buffered
+	*/
+	typedef struct tVfy {
+	    rMch *ipMch ;           /**< match to verify                                    */
+	    off_t izOrg ;           /**< position to compare on the source file             */
+	    off_t izNew ;           /**< position to compare on the destination file        */
+	    int iiDst ;             /**< number of bytes to compare                         */
+	    int iiGld ;             /**< gliding match recurrence                           */
+	} rVfy ;
+
 	/**
 	 * Matchtable elements
 	 */
@@ -147,6 +158,12 @@ private:
 	int  const miAhdMax ;       /**< Lookahead & lookback range                       */
 	int  miRlb=0;               /**< Current reliability range from mpHsh             */
 
+	/**
+	* Batched verification of matches outside the source buffer
+	*/
+	rVfy *msVfy = null ;        /**< Pending verifications                            */
+	jchar *mpVfyBuf = null ;    /**< Scratch buffer for the source data               */
+
 	/**
 	* Statistics
 	*/
@@ -201,6 +218,9 @@ private:
      * @param   aiLen       in      number of bytes to compare
      * @param   aiGld       in      gliding match recurrence
      * @param   aiSft       in      1=hard read, 2=soft read
+     * @param   apOrg       in      source data to use instead of the source file (optional)
+     * @param   azOrgBse    in      source position of apOrg
+     * @param   alOrgLen    in      number of bytes in apOrg, beyond is EOB
      *
      * @return  0    : no run of equal byes found
      * @return  -1   : EOB reached, no equal bytes found
@@ -210,9 +230,41 @@ private:
 	    off_t &rzPosOrg, off_t &rzPosNew,
 	    int aiLen = 0,
 	    int ibGld = 0,
-	    const JFile::eAhead aiSft = JFile::eAhead::HardAhead
+	    const JFile::eAhead aiSft = JFile::eAhead::HardAhead,
+	    jchar const * const apOrg = null, off_t const azOrgBse = 0, long const alOrgLen = 0
     ) const ;
 
+    /**
+    * @brief Verify the matches whose source data is not buffered.
+    *
+    * Compares are sorted on source position and nearby ones are read together
+    * into a scratch buffer, so that each cluster costs one read instead of a
+    * seek and a buffer refill per match. Results are stored in the matches,
+    * as if they were checked by isGoodOrBest.
+    */
+    void verify(off_t const azRedNew) ;
+
+    /**
+    * @brief Order pending verifications on source position (for qsort).
+    */
+    static int cmpVfy(void const * apOne, void const * apTwo) ;
+
+    /**
+    * @brief Compare buffered data 64 bytes at a time, as check does byte per byte.
+    *
+    * @param   apOrg       in      source data at rzPosOrg
+    * @param   apNew       in      destination data at rzPosNew
+    * @param   azLen       in      number of bytes available in both
+    * @param   &rzPosOrg   in/out  position on first file
+    * @param   &rzPosNew   in/out  position on second file
+    * @param   &riLen      in/out  number of bytes to compare
+    * @param   &riEql      in/out  equal bytes counter
+    *
+    * @return  true = compare is finished, false = continue after the compared blocks
+    */
+    bool checkBlocks(jchar const * const apOrg, jchar const * const apNew, off_t const azLen,
+                     off_t &rzPosOrg, off_t &rzPosNew, int &riLen, int &riEql) const ;
+
     /**
     * @brief Prepare next reusable old element
     * @return true=found, false=notfound
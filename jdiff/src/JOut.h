@@ -47,6 +47,39 @@ public:
     virtual bool put(int aiOpr, off_t azLen, int aiOrg, int aiNew,
         off_t azPosOrg, off_t azPosNew) = 0;
 
+    /**
+     * Output routine for JDiff, called to output a run of MOD or INS bytes.
+     *
+     * The default implementation calls put() for every byte.
+     *
+     * @param aiOpr     operand: INS or MOD
+     * @param alLen     number of bytes
+     * @param apOrg     bytes from original file (MOD only, null for INS)
+     * @param apNew     bytes from new file
+     * @param azPosOrg  position of the first byte within original file
+     * @param azPosNew  position of the first byte within new file
+     */
+    virtual void putRun(int aiOpr, long alLen, jchar const *apOrg, jchar const *apNew,
+        off_t azPosOrg, off_t azPosNew) {
+        for (long llIdx = 0; llIdx < alLen; llIdx++) {
+            if (aiOpr == MOD)
+                put(MOD, 1, apOrg[llIdx], apNew[llIdx], azPosOrg + llIdx, azPosNew + llIdx);
+            else
+                put(INS, 1, 0, apNew[llIdx], azPosOrg, azPosNew + llIdx);
+        }
+    }
+
+    /**
+     * Flush the output and report write errors, including earlier ones.
+     *
+     * The default implementation writes directly to its file and has nothing to flush.
+     *
+     * @return EXI_OK or EXI_WRI
+     */
+    virtual int close() {
+        return EXI_OK ;
+    }
+
     /*
      * Statistics about operations
      */
@@ -103,6 +103,25 @@ bool JOutAsc::put (
   return false ;	// we always want details
 } /* put */
 
+/**
+ *@brief Output a run of MOD or INS bytes: one line per byte
+ */
+void JOutAsc::putRun (
+  int   aiOpr,
+  long  alLen,
+  jchar const *apOrg,
+  jchar const *apNew,
+  off_t azPosOrg,
+  off_t azPosNew
+){
+  for (long llIdx = 0; llIdx < alLen; llIdx++) {
+    if (aiOpr == MOD)
+      JOutAsc::put(MOD, 1, apOrg[llIdx], apNew[llIdx], azPosOrg + llIdx, azPosNew + llIdx) ;
+    else
+      JOutAsc::put(INS, 1, 0, apNew[llIdx], azPosOrg, azPosNew + llIdx) ;
+  }
+} /* putRun */
+
 int JOutAsc::ufPutSze ( off_t azLen )
 { if (azLen <= 252) {
     return 1 ;
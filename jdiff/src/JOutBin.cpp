@@ -19,15 +19,75 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
 #include "JDefs.h"
 #include "JOutBin.h"
 
 namespace JojoDiff {
 
-JOutBin::JOutBin(FILE *apFilOut ) : mpFilOut(apFilOut), miOprCur(MOD), mzEqlCnt(0), mbOutEsc(false) {
+JOutBin::JOutBin(FILE *apFilOut, const long alBufSze )
+: mpFilOut(apFilOut), mlBufSze(alBufSze < 16 ? 16 : alBufSze), mlBufLen(0), miErr(EXI_OK)
+, miOprCur(MOD), mzEqlCnt(0), mbOutEsc(false)
+{
+    mpBuf = (jchar *) malloc(mlBufSze) ;
+    #ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpBuf == null)
+        throw std::bad_alloc() ;
+    #endif // JDIFF_THROW_BAD_ALLOC
 }
 
 JOutBin::~JOutBin() {
+    flush() ;
+    free(mpBuf) ;
+}
+
+/* ---------------------------------------------------------------
+ * flush writes the output buffer to the output file.
+ * Data is written in blocks of mlBufSze bytes, which stdio passes on
+ * to the operating system without copying or per-byte locking.
+ * A failed write is remembered, so that close() reports it.
+ * ---------------------------------------------------------------*/
+int JOutBin::flush ()
+{
+  long llLen = mlBufLen ;
+  mlBufLen = 0 ;
+  if (llLen > 0 && fwrite(mpBuf, 1, llLen, mpFilOut) != (size_t) llLen)
+    miErr = EXI_WRI ;
+  return miErr ;
+}
+
+/* ---------------------------------------------------------------
+ * close flushes the output buffer and the output file and reports
+ * any write error that occured.
+ * ---------------------------------------------------------------*/
+int JOutBin::close ()
+{
+  if (flush() == EXI_OK && fflush(mpFilOut) != 0)
+    miErr = EXI_WRI ;
+  return miErr ;
+}
+
+/* ---------------------------------------------------------------
+ * ufPutDta copies a series of data bytes without escapes to
+ * the output buffer.
+ * ---------------------------------------------------------------*/
+void JOutBin::ufPutDta ( jchar const *apDta, long alLen )
+{
+  long llLen ;
+  while (alLen > 0) {
+    if (mlBufLen == mlBufSze)
+      flush() ;
+    llLen = mlBufSze - mlBufLen ;
+    if (llLen > alLen)
+      llLen = alLen ;
+    memcpy(mpBuf + mlBufLen, apDta, llLen) ;
+    mlBufLen += llLen ;
+    apDta += llLen ;
+    alLen -= llLen ;
+  }
 }
 
 /*******************************************************************************
@@ -64,40 +124,40 @@ JOutBin::~JOutBin() {
  * ---------------------------------------------------------------*/
 void JOutBin::ufPutLen ( off_t azLen  )
 { if (azLen <= 252) {
-    putc(azLen - 1, mpFilOut) ;
+    ufPutc(azLen - 1) ;
     gzOutBytCtl += 1;
   } else if (azLen <= 508) {
-    putc(252, mpFilOut);
-    putc((azLen - 253), mpFilOut) ;
+    ufPutc(252) ;
+    ufPutc((azLen - 253)) ;
     gzOutBytCtl += 2;
   } else if (azLen <= 0xffff) {
-    putc(253, mpFilOut);
-    putc((azLen >>  8)       , mpFilOut) ;
-    putc((azLen      ) & 0xff, mpFilOut) ;
+    ufPutc(253) ;
+    ufPutc((azLen >>  8)) ;
+    ufPutc((azLen      ) & 0xff) ;
     gzOutBytCtl += 3;
 #ifdef JDIFF_LARGEFILE
   } else if (azLen <= 0xffffffff) {
 #else
   } else {
 #endif
-    putc(254, mpFilOut);
-    putc((azLen >> 24)       , mpFilOut);
-    putc((azLen >> 16) & 0xff, mpFilOut) ;
-    putc((azLen >>  8) & 0xff, mpFilOut) ;
-    putc((azLen      ) & 0xff, mpFilOut) ;
+    ufPutc(254) ;
+    ufPutc((azLen >> 24)) ;
+    ufPutc((azLen >> 16) & 0xff) ;
+    ufPutc((azLen >>  8) & 0xff) ;
+    ufPutc((azLen      ) & 0xff) ;
     gzOutBytCtl += 5;
   }
 #ifdef JDIFF_LARGEFILE
   else {
-    putc(255, mpFilOut);
-    putc((azLen >> 56)       , mpFilOut) ;
-    putc((azLen >> 48) & 0xff, mpFilOut) ;
-    putc((azLen >> 40) & 0xff, mpFilOut) ;
-    putc((azLen >> 32) & 0xff, mpFilOut) ;
-    putc((azLen >> 24) & 0xff, mpFilOut);
-    putc((azLen >> 16) & 0xff, mpFilOut) ;
-    putc((azLen >>  8) & 0xff, mpFilOut) ;
-    putc((azLen      ) & 0xff, mpFilOut) ;
+    ufPutc(255) ;
+    ufPutc((azLen >> 56)) ;
+    ufPutc((azLen >> 48) & 0xff) ;
+    ufPutc((azLen >> 40) & 0xff) ;
+    ufPutc((azLen >> 32) & 0xff) ;
+    ufPutc((azLen >> 24) & 0xff) ;
+    ufPutc((azLen >> 16) & 0xff) ;
+    ufPutc((azLen >>  8) & 0xff) ;
+    ufPutc((azLen      ) & 0xff) ;
     gzOutBytCtl += 9;
   }
 #endif
@@ -111,8 +171,8 @@ void JOutBin::ufPutOpr ( int aiOpr )
 {   // first output a pending escape
     // as a real escape will follow, the data escape must be protected
     if (mbOutEsc) {
-        putc(ESC, mpFilOut) ;
-        putc(ESC, mpFilOut) ;
+        ufPutc(ESC) ;
+        ufPutc(ESC) ;
         mbOutEsc = false ;
         gzOutBytEsc++ ;
         gzOutBytDta++ ;
@@ -121,8 +181,8 @@ void JOutBin::ufPutOpr ( int aiOpr )
     if ( aiOpr != ESC ) {
         // No need to output a MOD after an EQL, BKT or DEL
         if ( aiOpr != MOD || miOprCur == INS ) {
-            putc(ESC, mpFilOut);
-            putc(aiOpr, mpFilOut);
+            ufPutc(ESC) ;
+            ufPutc(aiOpr) ;
             gzOutBytCtl+=2;
         }
     }
@@ -141,11 +201,11 @@ void JOutBin::ufPutByt ( int aiByt )
     if (aiByt >= BKT && aiByt <= ESC) {
       // an <es><opcode> sequence within the datastrem,
       // is protected by an additional <esc>
-      putc(ESC, mpFilOut) ;
+      ufPutc(ESC) ;
       gzOutBytEsc++ ;
     }
     // write the pending escape
-    putc(ESC, mpFilOut) ;
+    ufPutc(ESC) ;
     gzOutBytDta++;
   }
   // output the incoming byte
@@ -154,11 +214,34 @@ void JOutBin::ufPutByt ( int aiByt )
     mbOutEsc = true ;
   } else {
     // output byte
-    putc(aiByt, mpFilOut) ;
+    ufPutc(aiByt) ;
     gzOutBytDta++;
   }
 }
 
+/* ---------------------------------------------------------------
+ * ufPutEql outputs pending equal bytes before operand aiOpr,
+ * either as an EQL operand or as MOD data.
+ * ---------------------------------------------------------------*/
+void JOutBin::ufPutEql ( int aiOpr )
+{
+  if (mzEqlCnt > MINEQL || (miOprCur != MOD && aiOpr != MOD)) {
+    // as of 3 equal bytes => output as EQL (ESC EQL <cnt>)
+    ufPutOpr(EQL) ;
+    ufPutLen(mzEqlCnt);
+
+    gzOutBytEql+=mzEqlCnt;
+  } else {
+    // less than 3 equal bytes => output as MOD
+    if (miOprCur != MOD) {
+      ufPutOpr(MOD) ;
+    }
+    for (int liCnt=0; liCnt < mzEqlCnt; liCnt++)
+      ufPutByt(miEqlBuf[liCnt]) ;
+  }
+  mzEqlCnt=0;
+}
+
 /* ---------------------------------------------------------------
  * ufOutBytBin: binary output function for generating patch files
  * ---------------------------------------------------------------*/
@@ -172,27 +255,14 @@ bool JOutBin::put (
 )
 { /* Output a pending EQL operand (if MINEQL or more equal bytes) */
   if (aiOpr != EQL && mzEqlCnt > 0) {
-    if (mzEqlCnt > MINEQL || (miOprCur != MOD && aiOpr != MOD)) {
-      // as of 3 equal bytes => output as EQL (ESC EQL <cnt>)
-      ufPutOpr(EQL) ;
-      ufPutLen(mzEqlCnt);
-
-      gzOutBytEql+=mzEqlCnt;
-    } else {
-      // less than 3 equal bytes => output as MOD
-      if (miOprCur != MOD) {
-        ufPutOpr(MOD) ;
-      }
-      for (int liCnt=0; liCnt < mzEqlCnt; liCnt++)
-        ufPutByt(miEqlBuf[liCnt]) ;
-    }
-    mzEqlCnt=0;
+    ufPutEql(aiOpr) ;
   }
 
   /* Handle current operand */
   switch (aiOpr) {
     case ESC : /* before closing the output */
       ufPutOpr(ESC);
+      flush();
       break;
 
     case MOD :
@@ -230,4 +300,46 @@ bool JOutBin::put (
 
   return false ;
 } /* put() */
+
+/* ---------------------------------------------------------------
+ * putRun: output a run of MOD or INS bytes
+ * ---------------------------------------------------------------*/
+void JOutBin::putRun (
+  int   aiOpr,
+  long  alLen,
+  jchar const *apOrg,
+  jchar const *apNew,
+  off_t azPosOrg,
+  off_t azPosNew
+)
+{
+  if (mzEqlCnt > 0) {
+    ufPutEql(aiOpr) ;
+  }
+  if (miOprCur != aiOpr) {
+    ufPutOpr(aiOpr) ;
+  }
+
+  /* copy the bytes up to the next escape in bulk, handle escapes one by one */
+  jchar const *lpEsc ;
+  long llLen ;
+  while (alLen > 0) {
+    if (mbOutEsc) {
+      ufPutByt(*apNew++) ;
+      alLen-- ;
+      continue ;
+    }
+    lpEsc = (jchar const *) memchr(apNew, ESC, alLen) ;
+    llLen = (lpEsc == null) ? alLen : (long) (lpEsc - apNew) ;
+    ufPutDta(apNew, llLen) ;
+    gzOutBytDta += llLen ;
+    apNew += llLen ;
+    alLen -= llLen ;
+    if (lpEsc != null) {
+      ufPutByt(ESC) ;   // becomes a pending escape
+      apNew++ ;
+      alLen-- ;
+    }
+  }
+} /* putRun() */
 } /* namespace */
@@ -25,7 +25,8 @@
 #include <stdio.h>
 #include "JOut.h"
 
-#define MINEQL 2    // start EQL-sequence on 3'rd byte
+#define MINEQL 2            // start EQL-sequence on 3'rd byte
+#define OUTBUFSZE 0x40000   // default output buffer size (256kB)
 
 namespace JojoDiff {
 
@@ -34,7 +35,15 @@ class JOutBin: public JOut {
     JOutBin& operator=(JOutBin const&) = delete;
 
 public:
-    JOutBin(FILE *apFilOut );
+    /**
+     * @brief Create binary output on a stdio file.
+     *
+     * @param apFilOut  output file
+     * @param alBufSze  size of the output buffer
+     */
+    JOutBin(FILE *apFilOut, const long alBufSze = OUTBUFSZE );
+
+    /** Flushes the output buffer */
     virtual ~JOutBin();
 
     virtual bool put (
@@ -46,13 +55,48 @@ public:
       off_t azPosNew
     );
 
+    virtual void putRun (
+      int   aiOpr,
+      long  alLen,
+      jchar const *apOrg,
+      jchar const *apNew,
+      off_t azPosOrg,
+      off_t azPosNew
+    );
+
+    /**
+     * @brief Write the output buffer to the output file.
+     * @return EXI_OK or EXI_WRI (also when an earlier write failed)
+     */
+    int flush() ;
+
+    /**
+     * @brief Flush the output buffer.
+     * @return EXI_OK or EXI_WRI when any write failed
+     */
+    virtual int close() ;
+
 private:
     FILE *mpFilOut ;        /**< output file */
+    jchar *mpBuf ;          /**< output buffer */
+    long  mlBufSze ;        /**< output buffer size */
+    long  mlBufLen ;        /**< number of bytes in the output buffer */
+    int   miErr ;           /**< EXI_WRI once a write failed, else EXI_OK */
 
     int   miOprCur ;        /**< current operand: INS, MOD, EQL or DEL. */
     off_t mzEqlCnt ;        /**< number of pending equal bytes */
     int   miEqlBuf[MINEQL]; /**< first four equal bytes */
     int   mbOutEsc;         /**< Pending escape character in data stream  ?*/
+
+    /**@brief Output one byte to the output buffer */
+    inline void ufPutc ( int aiByt ) {
+        if (mlBufLen == mlBufSze)
+            flush() ;
+        mpBuf[mlBufLen++] = (jchar) aiByt ;
+    }
+
+    /**@brief Output a series of data bytes without escapes to the output buffer */
+    void ufPutDta ( jchar const *apDta, long alLen ) ;
 
     /**@brief Output one byte of data */
     void ufPutByt ( int aiByt ) ;
@@ -60,6 +104,9 @@ private:
     /**@brief Output an operator sequence */
     void ufPutOpr ( int aiOpr ) ;
 
+    /**@brief Output pending equal bytes */
+    void ufPutEql ( int aiOpr ) ;
+
     /**@brief Output an operator offset */
     void ufPutLen ( off_t azLen ) ;
 
@@ -0,0 +1,234 @@
+/*
+ * JOutDedup.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "JDefs.h"
+#include "JOutDedup.h"
+
+#ifdef JDIFF_DEDUP
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+JOutDedup::JOutDedup(JFile &apFilOrg, JFile &apFilNew, const int aiVerbse, const off_t azMin)
+: miFdOrg(apFilOrg.get_fd()), miFdNew(apFilNew.get_fd()), miVerbse(aiVerbse)
+, mzMin(azMin), mlBlkSze(4096), mbDdp(true), mbCln(false)
+, mzEqlOrg(0), mzEqlNew(0), mzEqlLen(0), mzDdpByt(0)
+{
+    struct stat lsSta ;
+
+    if (miFdOrg < 0 || miFdNew < 0) {
+        mbDdp = false ;
+    } else if (fstat(miFdNew, &lsSta) == 0 && lsSta.st_blksize > 0) {
+        mlBlkSze = lsSta.st_blksize ;
+    }
+    if (! mbDdp && miVerbse > 0)
+        fprintf(JDebug::stddbg, "Warning: deduplication needs regular files.\n") ;
+}
+
+JOutDedup::~JOutDedup() {
+    ufDdpEql() ;
+}
+
+/**
+ * @brief Share one block-aligned range of the destination file with the source file.
+ *
+ * @param azPosOrg  position in the source file
+ * @param azPosNew  position in the destination file
+ * @param azLen     length (at most DDPMAX)
+ * @return number of bytes shared, < 0 on error
+ */
+off_t JOutDedup::ufDdpRng ( off_t azPosOrg, off_t azPosNew, off_t azLen )
+{
+    if (! mbCln) {
+        // FIDEDUPERANGE: the kernel verifies that both ranges are equal
+        alignas(8) char lcBuf[sizeof(struct file_dedupe_range) + sizeof(struct file_dedupe_range_info)] ;
+        struct file_dedupe_range *lpRng = (struct file_dedupe_range *) lcBuf ;
+        memset(lcBuf, 0, sizeof(lcBuf)) ;
+        lpRng->src_offset = azPosOrg ;
+        lpRng->src_length = azLen ;
+        lpRng->dest_count = 1 ;
+        lpRng->info[0].dest_fd = miFdNew ;
+        lpRng->info[0].dest_offset = azPosNew ;
+
+        if (ioctl(miFdOrg, FIDEDUPERANGE, lpRng) == 0) {
+            if (lpRng->info[0].status == FILE_DEDUPE_RANGE_SAME)
+                return lpRng->info[0].bytes_deduped ;
+            if (lpRng->info[0].status == FILE_DEDUPE_RANGE_DIFFERS)
+                return 0 ;
+            errno = - lpRng->info[0].status ;
+        }
+        if (errno != EOPNOTSUPP && errno != ENOTTY)
+            return -1 ;
+
+        // Deduplication not supported: fall back to cloning
+        mbCln = true ;
+        if (miVerbse > 1)
+            fprintf(JDebug::stddbg, "Deduplication not supported, cloning instead.\n") ;
+    }
+
+    // FICLONERANGE: JDiff has verified that both ranges are equal
+    struct file_clone_range lsCln ;
+    lsCln.src_fd = miFdOrg ;
+    lsCln.src_offset = azPosOrg ;
+    lsCln.src_length = azLen ;
+    lsCln.dest_offset = azPosNew ;
+    if (ioctl(miFdNew, FICLONERANGE, &lsCln) == 0)
+        return azLen ;
+    return -1 ;
+} /* ufDdpRng */
+
+/**
+ * @brief Deduplicate the pending equal region.
+ *
+ * The region is trimmed to whole blocks of the destination file, and skipped
+ * when the source position does not have the same alignment.
+ */
+void JOutDedup::ufDdpEql ()
+{
+    off_t lzPosOrg = mzEqlOrg ;
+    off_t lzPosNew = mzEqlNew ;
+    off_t lzLen = mzEqlLen ;
+    off_t lzSkp ;
+    off_t lzDdp ;
+
+    mzEqlLen = 0 ;
+    if (! mbDdp || lzLen < mzMin)
+        return ;
+
+    /* align on filesystem blocks */
+    if (lzPosOrg % mlBlkSze != lzPosNew % mlBlkSze)
+        return ;
+    lzSkp = (mlBlkSze - lzPosNew % mlBlkSze) % mlBlkSze ;
+    lzPosOrg += lzSkp ;
+    lzPosNew += lzSkp ;
+    lzLen -= lzSkp ;
+    lzLen -= lzLen % mlBlkSze ;
+    if (lzLen < mzMin)
+        return ;
+
+    /* share in chunks of at most DDPMAX bytes */
+    while (lzLen > 0) {
+        lzDdp = ufDdpRng(lzPosOrg, lzPosNew, (lzLen > DDPMAX) ? DDPMAX : lzLen) ;
+        if (lzDdp < 0) {
+            if (miVerbse > 0)
+                fprintf(JDebug::stddbg, "Warning: deduplication failed at " P8zd ": %s.\n",
+                        lzPosNew, strerror(errno)) ;
+            mbDdp = false ;
+            return ;
+        }
+        if (lzDdp == 0)
+            return ;
+
+        if (miVerbse > 2)
+            fprintf(JDebug::stddbg, P8zd " " P8zd " DDP %" PRIzd "\n", lzPosOrg, lzPosNew, lzDdp) ;
+        mzDdpByt += lzDdp ;
+        lzPosOrg += lzDdp ;
+        lzPosNew += lzDdp ;
+        lzLen -= lzDdp ;
+    }
+} /* ufDdpEql */
+
+/**
+ * @brief Collect equal regions and deduplicate them, count the others.
+ */
+bool JOutDedup::put (
+  int   aiOpr,
+  off_t azLen,
+  int   aiOrg,
+  int   aiNew,
+  off_t azPosOrg,
+  off_t azPosNew
+)
+{
+  switch (aiOpr) {
+    case EQL :
+      // extend the pending region when contiguous
+      if (mzEqlLen > 0 && (mzEqlOrg + mzEqlLen != azPosOrg || mzEqlNew + mzEqlLen != azPosNew))
+        ufDdpEql() ;
+      if (mzEqlLen == 0) {
+        mzEqlOrg = azPosOrg ;
+        mzEqlNew = azPosNew ;
+      }
+      mzEqlLen += azLen ;
+      gzOutBytEql += azLen ;
+      return true ;
+
+    case ESC :
+      ufDdpEql() ;
+      break ;
+
+    case MOD :
+    case INS :
+      ufDdpEql() ;
+      gzOutBytDta++ ;
+      break ;
+
+    case DEL :
+      ufDdpEql() ;
+      gzOutBytDel += azLen ;
+      break ;
+
+    case BKT :
+      ufDdpEql() ;
+      gzOutBytBkt += azLen ;
+      break ;
+  }
+  return false ;
+} /* put */
+
+/**
+ * @brief Count a run of MOD or INS bytes: the destination file already holds them.
+ */
+void JOutDedup::putRun (
+  int   aiOpr,
+  long  alLen,
+  jchar const *apOrg,
+  jchar const *apNew,
+  off_t azPosOrg,
+  off_t azPosNew
+)
+{
+  ufDdpEql() ;
+  gzOutBytDta += alLen ;
+} /* putRun */
+
+/**
+ * @brief Share the pending region. Equal regions that were all too small or
+ * misaligned leave nothing reflinked, which deserves a word in verbose mode.
+ */
+int JOutDedup::close ()
+{
+  ufDdpEql() ;
+  if (mbDdp && mzDdpByt == 0 && gzOutBytEql > 0 && miVerbse > 0)
+    fprintf(JDebug::stddbg, "\nWarning: nothing reflinked, equal regions are smaller than %" PRIzd
+            " KB (-y) or not aligned on %ld byte blocks.\n", mzMin / 1024, mlBlkSze) ;
+  return EXI_OK ;
+} /* close */
+
+} /* namespace */
+#endif // JDIFF_DEDUP
@@ -0,0 +1,112 @@
+/*
+ * JOutDedup.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOUTDEDUP_H_
+#define JOUTDEDUP_H_
+
+#include "JDefs.h"
+#include "JOut.h"
+#include "JFile.h"
+
+#ifdef JDIFF_DEDUP
+#define DDPMIN 0x10000      // default minimum length of a region to deduplicate (64kB)
+#define DDPMAX 0x1000000    // maximum length to deduplicate in one call (16MB)
+
+namespace JojoDiff {
+
+/**
+ * @brief Deduplication output: share equal regions of the destination file
+ *        with the source file instead of writing a difference file.
+ *
+ * Equal regions of at least DDPMIN bytes are handed to the filesystem with
+ * FIDEDUPERANGE (or FICLONERANGE when deduplication is not supported), so that
+ * the destination file shares the extents of the source file (btrfs, XFS, ...).
+ * Only whole filesystem blocks are shared: the region is trimmed to block
+ * boundaries and skipped when both files are not aligned the same way.
+ *
+ * Nothing is written: the destination file keeps its contents.
+ */
+class JOutDedup: public JOut {
+    JOutDedup(JOutDedup const&) = delete;
+    JOutDedup& operator=(JOutDedup const&) = delete;
+
+public:
+    /**
+     * @param apFilOrg  source file
+     * @param apFilNew  destination file, opened for reading and writing
+     * @param aiVerbse  verbosity level
+     * @param azMin     minimum length of a region to deduplicate
+     */
+    JOutDedup(JFile &apFilOrg, JFile &apFilNew, const int aiVerbse=0, const off_t azMin=DDPMIN);
+    virtual ~JOutDedup();
+
+    virtual bool put (
+      int   aiOpr,
+      off_t azLen,
+      int   aiOrg,
+      int   aiNew,
+      off_t azPosOrg,
+      off_t azPosNew
+    );
+
+    virtual void putRun (
+      int   aiOpr,
+      long  alLen,
+      jchar const *apOrg,
+      jchar const *apNew,
+      off_t azPosOrg,
+      off_t azPosNew
+    );
+
+    /**
+     * @brief Share the pending region, warn (verbose) when nothing could be shared.
+     */
+    virtual int close() ;
+
+    /**
+     * @brief Number of bytes shared with the source file.
+     */
+    off_t getDdpByt() const { return mzDdpByt ; }
+
+private:
+    int const miFdOrg ;     /**< source file descriptor                         */
+    int const miFdNew ;     /**< destination file descriptor                    */
+    int const miVerbse ;    /**< verbosity level                                */
+    off_t const mzMin ;     /**< minimum length of a region to deduplicate      */
+    long  mlBlkSze ;        /**< filesystem block size                          */
+    bool  mbDdp ;           /**< deduplication still possible ?                 */
+    bool  mbCln ;           /**< clone instead of deduplicate ?                 */
+
+    off_t mzEqlOrg ;        /**< pending equal region: source position          */
+    off_t mzEqlNew ;        /**< pending equal region: destination position     */
+    off_t mzEqlLen ;        /**< pending equal region: length                   */
+    off_t mzDdpByt ;        /**< number of bytes shared                         */
+
+    /**@brief Deduplicate the pending equal region */
+    void ufDdpEql () ;
+
+    /**@brief Share one aligned range, return number of bytes shared or < 0 on error */
+    off_t ufDdpRng ( off_t azPosOrg, off_t azPosNew, off_t azLen ) ;
+};
+
+} /* namespace */
+#endif // JDIFF_DEDUP
+#endif /* JOUTDEDUP_H_ */
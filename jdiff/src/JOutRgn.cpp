@@ -107,6 +107,31 @@ bool JOutRgn::put (
   return true ; // we never need details
 } /* ufOutBytRgn */
 
+/**
+*@brief Output a run of MOD or INS bytes: accumulated as one region
+*/
+void JOutRgn::putRun (
+  int   aiOpr,
+  long  alLen,
+  jchar const *apOrg,
+  jchar const *apNew,
+  off_t azPosOrg,
+  off_t azPosNew
+)
+{
+  if (alLen <= 0)
+    return ;
+
+  /* the first byte accounts for the operator change and its escape */
+  JOutRgn::put(aiOpr, alLen, 0, apNew[0], azPosOrg, azPosNew) ;
+
+  /* count escapes of the other bytes */
+  for (long llIdx = 1; llIdx < alLen; llIdx++) {
+    if (apNew[llIdx] == ESC)
+      gzOutBytEsc++ ;
+  }
+} /* putRun */
+
 /* ---------------------------------------------------------------
  * ufPutLen returns a length as follows
  * byte1  following      formula              if number is
@@ -47,6 +47,15 @@ public:
       off_t azPosNew
     );
 
+    virtual void putRun (
+      int   aiOpr,
+      long  alLen,
+      jchar const *apOrg,
+      jchar const *apNew,
+      off_t azPosOrg,
+      off_t azPosNew
+    );
+
 private:
     FILE *mpFilOut ;    // output file
 
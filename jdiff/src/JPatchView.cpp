@@ -0,0 +1,183 @@
+/*
+ * JPatchView.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <new>
+
+#include "JPatchView.h"
+#include "JDebug.h"
+
+namespace JojoDiff {
+
+/**
+ * @brief Create a view: prepare the patch and allocate the block cache.
+ */
+JPatchView::JPatchView(JFile &apFilOrg, JFile &apFilPch, char const * const asJid,
+                       long const alBlkSze, int const aiBlkCnt)
+: JFile(asJid, false)
+, moPch(apFilOrg, apFilPch, moOut)
+, mlBlkSze(alBlkSze < 16 ? 16 : alBlkSze)
+, miBlkCnt(aiBlkCnt < 2 ? 2 : aiBlkCnt)
+{
+    mpBlkDta = (jchar *) malloc((size_t) mlBlkSze * miBlkCnt) ;
+    mzBlkNum = (off_t *) malloc(sizeof(off_t) * miBlkCnt) ;
+    mlBlkLen = (long *) malloc(sizeof(long) * miBlkCnt) ;
+    mlBlkUse = (unsigned long *) malloc(sizeof(unsigned long) * miBlkCnt) ;
+    #ifdef JDIFF_THROW_BAD_ALLOC
+    if (mpBlkDta == null || mzBlkNum == null || mlBlkLen == null || mlBlkUse == null)
+        throw std::bad_alloc() ;
+    #endif // JDIFF_THROW_BAD_ALLOC
+    for (int liBlk = 0; liBlk < miBlkCnt; liBlk++) {
+        mzBlkNum[liBlk] = -1 ;
+        mlBlkLen[liBlk] = 0 ;
+        mlBlkUse[liBlk] = 0 ;
+    }
+
+    // one restart point per block keeps a reconstruction within two blocks
+    if (moPch.prepare(mlBlkSze) == EXI_OK)
+        mzPosEof = moPch.get_outsize() ;
+
+#if debug
+    if (JDebug::gbDbg[DBGBUF])
+        fprintf(JDebug::stddbg, "JPatchView(%s):(eof=" P8zd ",seekable=%d)\n",
+                asJid, mzPosEof, moPch.is_seekable());
+#endif
+}
+
+JPatchView::~JPatchView()
+{
+    free(mpBlkDta) ;
+    free(mzBlkNum) ;
+    free(mlBlkLen) ;
+    free(mlBlkUse) ;
+}
+
+/**
+ * @brief Return EOF position: the size of the reconstructed file.
+ */
+off_t JPatchView::jeofpos() {
+    return mzPosEof ;
+}
+
+/**
+ * @brief Return the slot holding block azBlk, reconstructing it when needed.
+ *
+ * The least recently used slot is overwritten.
+ *
+ * @return slot, < 0 = error
+ */
+int JPatchView::ufGetBlk(off_t const azBlk) {
+    int liBlk ;
+    int liLru = 0 ;
+    int liRet ;
+
+    if (mzBlkNum[miBlkLst] == azBlk) {
+        mlBlkUse[miBlkLst] = ++mlUse ;
+        return miBlkLst ;
+    }
+    for (liBlk = 0; liBlk < miBlkCnt; liBlk++) {
+        if (mzBlkNum[liBlk] == azBlk) {
+            mlBlkUse[liBlk] = ++mlUse ;
+            miBlkLst = liBlk ;
+            return liBlk ;
+        }
+        if (mlBlkUse[liBlk] < mlBlkUse[liLru])
+            liLru = liBlk ;
+    }
+
+    // reconstruct the block in the least recently used slot
+    moOut.set_buffer(mpBlkDta + (size_t) liLru * mlBlkSze, mlBlkSze) ;
+    mzBlkNum[liLru] = -1 ;
+    liRet = moPch.jpatch_range(azBlk * mlBlkSze, mlBlkSze) ;
+    if (liRet != EXI_OK)
+        return liRet < 0 ? liRet : EXI_RED ;
+    mlDecCnt++ ;
+    mzBlkNum[liLru] = azBlk ;
+    mlBlkLen[liLru] = moOut.get_length() ;
+    mlBlkUse[liLru] = ++mlUse ;
+    miBlkLst = liLru ;
+    return liLru ;
+}
+
+/**
+ * @brief Get access to a reconstructed block.
+ *
+ * @param   azPos   in:  position to get access to
+ * @param   azLen   out: number of bytes available, EOF beyond EOF, < 0 on error
+ * @param   aiSft   in:  ignored: data is always reconstructed
+ *
+ * @return  buffer, null = azPos beyond EOF or error
+ */
+jchar * JPatchView::getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft) {
+    off_t lzBlk ;
+    off_t lzOff ;
+    int liBlk ;
+
+    if (azPos >= mzPosEof || azPos < 0) {
+        azLen = EOF ;
+        return null ;
+    }
+    lzBlk = azPos / mlBlkSze ;
+    lzOff = azPos - lzBlk * mlBlkSze ;
+    liBlk = ufGetBlk(lzBlk) ;
+    if (liBlk < 0) {
+        azLen = liBlk ;
+        return null ;
+    }
+    if (lzOff >= mlBlkLen[liBlk]) {
+        azLen = EXI_RED ;   // patch shorter than announced
+        return null ;
+    }
+    azLen = mlBlkLen[liBlk] - lzOff ;
+    return mpBlkDta + (size_t) liBlk * mlBlkSze + lzOff ;
+}
+
+/**
+ * @brief Get data from the reconstructed blocks and prepare JFile::get for the next positions.
+ *
+ * @param azPos     position to read from
+ * @param aiSft     ignored
+ * @return data at requested position, EOF or error.
+ */
+int JPatchView::get_frombuffer (
+    const off_t azPos,     /* position to read from                */
+    const eAhead aiSft     /* 0=read, 1=hard ahead, 2=soft ahead   */
+){
+    jchar *lpDta ;
+    off_t lzLen ;
+
+    lpDta = getbuf(azPos, lzLen, aiSft) ;
+    if (lpDta == null) {
+        mzPosRed = -1 ;
+        mpRed = null ;
+        miRedSze = 0 ;
+        return (int) lzLen ;
+    }
+
+    // prepare next reading position
+    mzPosRed = azPos + 1 ;
+    mpRed = lpDta + 1 ;
+    miRedSze = (long) lzLen - 1 ;
+    return *lpDta ;
+}
+
+} /* namespace */
@@ -0,0 +1,132 @@
+/*
+ * JPatchView.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JPATCHVIEW_H_
+#define JPATCHVIEW_H_
+
+#include "JDefs.h"
+#include "JFile.h"
+#include "JFileOutMem.h"
+#include "JPatcht.h"
+
+#define PCHVIEWBLK 0x10000  /**< Default block size (64kB)          */
+#define PCHVIEWCNT 64       /**< Default number of cached blocks    */
+
+namespace JojoDiff {
+
+/**
+ * @brief Read-only view on the file a patch recreates from a source file.
+ *
+ * Data is reconstructed on demand, by blocks, with JPatcht::jpatch_range and
+ * kept in a small LRU cache of blocks. Seekable patches start decoding from
+ * their index, other patches are scanned once for restart points on creation.
+ *
+ * The source and patch JFile are used exclusively by the view.
+ * Check is_ready() after construction.
+ */
+class JPatchView : public JFile
+{
+    JPatchView(JPatchView const&) = delete;
+    JPatchView& operator=(JPatchView const&) = delete;
+
+public:
+    /**
+     * @brief Create a view on the result of applying apFilPch to apFilOrg.
+     *
+     * @param apFilOrg  source file (random access)
+     * @param apFilPch  patch file (random access)
+     * @param asJid     JFile-id
+     * @param alBlkSze  size of a cached block
+     * @param aiBlkCnt  number of cached blocks
+     */
+    JPatchView(JFile &apFilOrg, JFile &apFilPch, char const * const asJid,
+               long const alBlkSze = PCHVIEWBLK, int const aiBlkCnt = PCHVIEWCNT);
+
+    /** Free the block cache */
+    virtual ~JPatchView();
+
+    /**
+     * @brief Return whether the patch could be prepared (scanned or index loaded).
+     */
+    bool is_ready() const { return mzPosEof != MAX_OFF_T ; }
+
+    /**
+     * @brief Return the number of blocks reconstructed so far.
+     */
+    long get_decodes() const { return mlDecCnt ; }
+
+	 /**
+	 * @brief Get access to a reconstructed block.
+	 *
+	 * @param   azPos   in:  position to get access to
+	 * @param   azLen   out: number of bytes available, EOF beyond EOF, < 0 on error
+	 * @param   aiSft   in:  ignored: data is always reconstructed
+	 *
+	 * @return  buffer, null = azPos beyond EOF or error
+	 */
+	virtual jchar *getbuf(const off_t azPos, off_t &azLen, const eAhead aiSft = Read) ;
+
+	/**
+	 * @brief Set lookahead base: has no effect.
+	 */
+	virtual void set_lookahead_base (const off_t azBse) { }
+
+protected:
+    /**
+    * @brief Return EOF position: the size of the reconstructed file.
+    */
+    virtual off_t jeofpos() ;
+
+    /**
+     * @brief Get data from the reconstructed blocks.
+     *
+     * @param azPos		position to read from
+     * @param aiSft		ignored
+     * @return data at requested position, EOF or error.
+     */
+    virtual int get_frombuffer(
+        const off_t azPos,    /* position to read from                */
+        const eAhead aiSft    /* 0=read, 1=hard ahead, 2=soft ahead   */
+    ) ;
+
+private:
+    JFileOutMem moOut ;         /**< Output into a cached block                 */
+    JPatcht moPch ;             /**< Decoder                                    */
+
+    long const mlBlkSze ;       /**< Size of a block                            */
+    int  const miBlkCnt ;       /**< Number of cached blocks                    */
+    jchar *mpBlkDta ;           /**< Cached blocks' data                        */
+    off_t *mzBlkNum ;           /**< Block number held in each slot (-1 = none) */
+    long  *mlBlkLen ;           /**< Number of bytes in each slot               */
+    unsigned long *mlBlkUse ;   /**< Last use of each slot (LRU)                */
+    unsigned long mlUse = 0 ;   /**< Use counter                                */
+    int   miBlkLst = 0 ;        /**< Last slot used                             */
+    long  mlDecCnt = 0 ;        /**< Number of blocks reconstructed             */
+
+    /**
+     * @brief Return the slot holding block azBlk, reconstructing it when needed.
+     *
+     * @return slot, < 0 = error
+     */
+    int ufGetBlk(off_t const azBlk) ;
+};
+} /* namespace */
+#endif /* JPATCHVIEW_H_ */
@@ -20,6 +20,8 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <new>
 #include "JPatcht.h"
 #include "JDebug.h"
@@ -34,7 +36,23 @@ JPatcht::JPatcht(JFile &apFilOrg, JFile &apFilPch, JFileOut &apFilOut,
 : mpFilOrg(apFilOrg), mpFilPch(apFilPch), mpFilOut(apFilOut)
 , miVerbse(aiVerbse)
 {
-
+    off_t lzEof = mpFilPch.geteof() ;
+    off_t lzIdxPos ;
+    off_t lzIdxCnt ;
+
+    // Seekable patch ? Then the operations end where the index starts.
+    if (lzEof != MAX_OFF_T && lzEof >= PCHIDXTRL
+            && ufGetI64(lzEof - 8) == PCHIDXMAG) {
+        lzIdxPos = ufGetI64(lzEof - PCHIDXTRL) ;
+        lzIdxCnt = ufGetI64(lzEof - PCHIDXTRL + 8) ;
+        if (lzIdxPos >= 0 && lzIdxCnt > 0
+                && lzIdxCnt <= (lzEof - PCHIDXTRL) / PCHIDXENT
+                && lzIdxPos + lzIdxCnt * PCHIDXENT + PCHIDXTRL == lzEof) {
+            mzPchEnd = lzIdxPos ;
+            mzIdxCnt = lzIdxCnt ;
+        }
+    }
+    mpFilPch.setpos(0) ;
 }
 
 JPatcht::~JPatcht()
@@ -84,6 +102,34 @@ off_t JPatcht::ufGetInt( JFile &apFil){
   }
 }
 
+/** @brief Read a 64-bit big-endian number from the patch file
+*
+* @param  azPos  position to read from
+* @return number (garbage at EOF)
+*/
+off_t JPatcht::ufGetI64( off_t const azPos ){
+    off_t lzVal ;
+    int liByt ;
+
+    lzVal = mpFilPch.get(azPos) & 0xff ;
+    for (liByt = 1; liByt < 8; liByt++)
+        lzVal = (lzVal << 8) | (mpFilPch.get() & 0xff) ;
+    return lzVal ;
+}
+
+/** @brief Write a 64-bit big-endian number to the output
+*
+* @param  azVal  number to write
+* @return EOF on error
+*/
+int JPatcht::ufPutI64( off_t const azVal ){
+    int liByt ;
+    for (liByt = 56; liByt >= 0; liByt -= 8)
+        if (mpFilOut.putc((int) (azVal >> liByt) & 0xff) == EOF)
+            return EOF ;
+    return 0 ;
+}
+
 /** @brief Put one byte of output data
 *
 * @param    azPosOrg    position on source file
@@ -96,7 +142,8 @@ off_t JPatcht::ufGetInt( JFile &apFil){
 int JPatcht::ufPutDta( off_t const lzPosOrg, off_t const lzPosOut,
                        int liOpr, int const aiDta, off_t azOff )
 {
-    mpFilOut.putc(aiDta) ;
+    if (lzPosOut + azOff >= mzWinBeg && lzPosOut + azOff < mzWinEnd)
+        mpFilOut.putc(aiDta) ;
     if (miVerbse > 1) {
         fprintf(JDebug::stddbg, P8zd " " P8zd " %s %02x %c\n",
                   lzPosOrg + ((liOpr == MOD) ? azOff : 0),
@@ -108,6 +155,52 @@ int JPatcht::ufPutDta( off_t const lzPosOrg, off_t const lzPosOut,
     return 1 ;
 }
 
+/** @brief Output the run of escape-free data at the patch's read position
+*
+* The run is located within the patch file's buffer and written with a
+* single bulk write. Not used at verbosity levels that list every byte.
+*
+* @param    azPosOut    position on output file
+* @param    azMod       in/out: offset counter, incremented with the run's length
+* @return   next byte from the patch file (ESC, EOF or a byte after the buffer)
+*/
+int JPatcht::ufGetRun(off_t const azPosOut, off_t &azMod)
+{
+    off_t lzPos = mpFilPch.getpos() ;
+    off_t lzLen ;
+    off_t lzBeg ;
+    off_t lzEnd ;
+    jchar *lpDta ;
+    jchar *lpEsc ;
+
+    if (miVerbse > 1 || lzPos < 0)
+        return mpFilPch.get() ;
+
+    lpDta = mpFilPch.getbuf(lzPos, lzLen) ;
+    if (lpDta == null)
+        return mpFilPch.get() ;
+    if (lzLen > LONG_MAX)
+        lzLen = LONG_MAX ;
+
+    lpEsc = (jchar *) memchr(lpDta, ESC, (size_t) lzLen) ;
+    if (lpEsc != null)
+        lzLen = lpEsc - lpDta ;
+    if (lzLen > 0) {
+        // write the part within the output window
+        lzBeg = azPosOut + azMod ;
+        lzEnd = lzBeg + lzLen ;
+        if (lzBeg < mzWinBeg)
+            lzBeg = mzWinBeg ;
+        if (lzEnd > mzWinEnd)
+            lzEnd = mzWinEnd ;
+        if (lzBeg < lzEnd && mpFilOut.write(lpDta + (lzBeg - azPosOut - azMod), (long) (lzEnd - lzBeg)) != EXI_OK)
+            return EOF ;    // stop here: the final flush reports the error
+        azMod += lzLen ;
+        lzPos += lzLen ;
+    }
+    return mpFilPch.get(lzPos) ;
+} /* ufGetRun */
+
 /** @brief Read a data sequence (INS or MOD)
 *
 * @param    azPosOrg    position on source file
@@ -139,7 +232,7 @@ int JPatcht::ufGetDta(off_t const lzPosOrg, off_t const lzPosOut,
     }
 
     /* Read loop */
-    while ((liInp = mpFilPch.get()) != EOF) {
+    while (lzPosOut + lzMod < mzWinEnd && (liInp = ufGetRun(lzPosOut, lzMod)) != EOF) {
         // Handle ESC-code
         if (liInp == ESC) {
             liNew = mpFilPch.get();
@@ -207,6 +300,139 @@ int JPatcht::ufGetDta(off_t const lzPosOrg, off_t const lzPosOut,
 *   <ESC><ESC> yields one <ESC> byte
 *******************************************************************************/
 int JPatcht::jpatch ()
+{
+    rPchPnt lrBeg = { 0, 0, 0, 0 } ;
+    return jpatch(lrBeg, mzPchEnd) ;
+} /* jpatch */
+
+/*******************************************************************************
+* Patch a range of the output
+*******************************************************************************/
+int JPatcht::jpatch_range ( off_t const azPos, off_t const azLen )
+{
+    rPchPnt lrBeg = { 0, 0, 0, 0 } ;
+    int liRet ;
+
+    // start from the last restart point before the range
+    if (mzIdxCnt > 0 && moIdx.empty())
+        ufLoadIdx() ;
+    if (! moIdx.empty()) {
+        size_t liLow = 0 ;
+        size_t liHgh = moIdx.size() ;
+        while (liHgh - liLow > 1) {
+            size_t liMid = (liLow + liHgh) / 2 ;
+            if (moIdx[liMid].izPosOut <= azPos)
+                liLow = liMid ;
+            else
+                liHgh = liMid ;
+        }
+        lrBeg = moIdx[liLow] ;
+    }
+
+    mzWinBeg = azPos ;
+    mzWinEnd = (azLen < MAX_OFF_T - azPos) ? azPos + azLen : MAX_OFF_T ;
+    liRet = jpatch(lrBeg, mzPchEnd) ;
+    mzWinBeg = 0 ;
+    mzWinEnd = MAX_OFF_T ;
+    return liRet ;
+} /* jpatch_range */
+
+/*******************************************************************************
+* Load the restart points of a seekable patch
+*******************************************************************************/
+int JPatcht::ufLoadIdx ()
+{
+    off_t lzPos = mzPchEnd ;
+    off_t lzCnt ;
+
+    moIdx.clear() ;
+    moIdx.reserve((size_t) mzIdxCnt) ;
+    for (lzCnt = 0; lzCnt < mzIdxCnt; lzCnt++, lzPos += PCHIDXENT) {
+        rPchPnt lrPnt ;
+        lrPnt.izPosOut = ufGetI64(lzPos) ;
+        lrPnt.izPosPch = ufGetI64(lzPos + 8) ;
+        lrPnt.izPosOrg = ufGetI64(lzPos + 16) ;
+        lrPnt.iiOpr = (int) ufGetI64(lzPos + 24) ;
+        if (lrPnt.izPosPch < 0 || lrPnt.izPosPch > mzPchEnd) {
+            moIdx.clear() ;     // corrupt index: decode from the start
+            return EXI_ERR ;
+        }
+        moIdx.push_back(lrPnt) ;
+    }
+    return EXI_OK ;
+} /* ufLoadIdx */
+
+/*******************************************************************************
+* Prepare for jpatch_range
+*******************************************************************************/
+int JPatcht::prepare ( off_t const azStp )
+{
+    if (! moIdx.empty())
+        return EXI_OK ;
+    if (mzIdxCnt > 0 && ufLoadIdx() == EXI_OK)
+        return EXI_OK ;
+    int liRet = index(moIdx, azStp) ;
+    if (liRet != EXI_OK)
+        moIdx.clear() ;
+    return liRet ;
+} /* prepare */
+
+/*******************************************************************************
+* Make the patch seekable
+*******************************************************************************/
+int JPatcht::seekable ( off_t const azStp )
+{
+    std::vector<rPchPnt> loPnt ;
+    off_t lzIdxPos ;
+    int liRet ;
+
+    if (mzIdxCnt > 0)
+        return EXI_OK ;     // already seekable
+
+    liRet = index(loPnt, azStp) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+
+    // terminate the last operation (a MOD or INS would run on into the index)
+    if (mpFilOut.putc(ESC) == EOF || mpFilOut.putc(DEL) == EOF || mpFilOut.putc(0) == EOF)
+        return EXI_WRI ;
+    lzIdxPos = mpFilPch.geteof() + 3 ;
+    loPnt.back().izPosPch = lzIdxPos ;
+
+    for (rPchPnt const &lrPnt : loPnt) {
+        if (ufPutI64(lrPnt.izPosOut) == EOF || ufPutI64(lrPnt.izPosPch) == EOF
+                || ufPutI64(lrPnt.izPosOrg) == EOF || ufPutI64(lrPnt.iiOpr) == EOF)
+            return EXI_WRI ;
+    }
+    if (ufPutI64(lzIdxPos) == EOF || ufPutI64((off_t) loPnt.size()) == EOF
+            || ufPutI64(PCHIDXMAG) == EOF)
+        return EXI_WRI ;
+    return mpFilOut.flush() ;
+} /* seekable */
+
+/*******************************************************************************
+* Scan the patch and collect restart points
+*******************************************************************************/
+int JPatcht::index ( std::vector<rPchPnt> &arPnt, off_t const azStp )
+{
+    rPchPnt lrBeg = { 0, 0, 0, 0 } ;
+    int liRet ;
+
+    // no output window: scan only
+    mzWinBeg = MAX_OFF_T ;
+    mzWinEnd = MAX_OFF_T ;
+    mpPnt = &arPnt ;
+    mzPntStp = (azStp > 0) ? azStp : 1 ;
+    liRet = jpatch(lrBeg, mzPchEnd) ;
+    mzWinBeg = 0 ;
+    mpPnt = null ;
+    return liRet ;
+} /* index */
+
+/*******************************************************************************
+* Patch from a restart point up to a patch position
+*******************************************************************************/
+int JPatcht::jpatch ( rPchPnt const &arBeg, off_t const azPchEnd )
 {
     int liInp ;         /**< 1st Pending byte (EOF = no pending bye)*/
     int liDbl = EOF ;   /**< 2nd Pending byte (EOF = no pending bye)*/
@@ -214,11 +440,26 @@ int JPatcht::jpatch ()
     int liRet;          /**< Return code from output file           */
 
     off_t lzOff ;       /**< Current operand's offset               */
-    off_t lzPosOrg=0;   /**< Position in source file                */
-    off_t lzPosOut=0;   /**< Position in destination file           */
+    off_t lzPosOrg=arBeg.izPosOrg;  /**< Position in source file    */
+    off_t lzPosOut=arBeg.izPosOut;  /**< Position in destination file */
+    off_t lzPosPch ;                /**< Position in patch file     */
+    off_t lzPntNxt=0;               /**< Next restart point (index) */
+
+    // position the patch file at the restart point
+    mpFilPch.setpos(arBeg.izPosPch) ;
 
-    liOpr = 0 ;   // no operator
+    liOpr = arBeg.iiOpr ;
     while (liOpr != EOF) {
+        // Collect a restart point or stop at the end position
+        lzPosPch = mpFilPch.getpos() ;
+        if (mpPnt != null && lzPosOut >= lzPntNxt && lzPosPch >= 0) {
+            rPchPnt lrPnt = { lzPosPch, lzPosOrg, lzPosOut, liOpr } ;
+            mpPnt->push_back(lrPnt) ;
+            lzPntNxt = lzPosOut + mzPntStp ;
+        }
+        if (lzPosPch >= azPchEnd || lzPosPch >= mzPchEnd || lzPosOut >= mzWinEnd)
+            break ;
+
         // Read operator from input, unless this has already been done
         if (liOpr == 0) {
             liInp = mpFilPch.get();
@@ -303,10 +544,14 @@ int JPatcht::jpatch ()
                         lzPosOrg, lzPosOut, lzOff) ;
             }
 
-            /* execute operation */
-            liRet = mpFilOut.copyfrom(mpFilOrg, lzPosOrg, lzOff) ;
-            if (liRet != EXI_OK){
-                return liRet ;
+            /* execute operation: the part within the output window */
+            if (lzPosOut + lzOff > mzWinBeg && lzPosOut < mzWinEnd) {
+                off_t lzBeg = (lzPosOut < mzWinBeg) ? mzWinBeg - lzPosOut : 0 ;
+                off_t lzEnd = (lzPosOut + lzOff > mzWinEnd) ? mzWinEnd - lzPosOut : lzOff ;
+                liRet = mpFilOut.copyfrom(mpFilOrg, lzPosOrg + lzBeg, lzEnd - lzBeg) ;
+                if (liRet != EXI_OK){
+                    return liRet ;
+                }
             }
             lzPosOrg += lzOff ;
             lzPosOut += lzOff ;
@@ -329,11 +574,22 @@ int JPatcht::jpatch ()
         }
     } /* while ! EOF */
 
-    if (miVerbse >= 1) {
+    if (mpPnt != null) {
+        // final point: end of patch
+        rPchPnt lrPnt = { MAX_OFF_T, lzPosOrg, lzPosOut, EOF } ;
+        mpPnt->push_back(lrPnt) ;
+        return EXI_OK ;
+    }
+
+    if (miVerbse >= 1 && azPchEnd >= mzPchEnd && mzWinEnd == MAX_OFF_T) {
         fprintf(JDebug::stddbg, P8zd " " P8zd " EOF\n",
                 lzPosOrg, lzPosOut)  ;
     }
 
+    if (mpFilOut.flush() != EXI_OK) {
+        fprintf(stderr, "Error writing output file.\n");
+        return (EXI_WRI);
+    }
     return EXI_OK ;
 } /* jpatch */
 
@@ -22,11 +22,33 @@
 #ifndef JPATCHT_H
 #define JPATCHT_H
 
+#include <vector>
 #include "JFile.h"
 #include "JFileOut.h"
 
+/*
+ * Seekable patch: the operations are followed by an index of restart points
+ *   <operations> <ESC><DEL><0> <entry>* <index position> <entry count> <magic>
+ * where an <entry> holds output, patch and source position and the pending
+ * operator. All numbers are 64-bit big-endian.
+ */
+#define PCHIDXMAG 0x4A44464944583031LL  /**< Magic number of a seekable patch: "JDFIDX01" */
+#define PCHIDXENT 32                    /**< Size of an index entry                      */
+#define PCHIDXTRL 24                    /**< Size of the index trailer                   */
+
 namespace JojoDiff {
 
+/**
+* @brief Restart point within a patch file: the state of JPatcht::jpatch at
+* the start of an operation. Patching can be resumed from any restart point.
+*/
+typedef struct {
+    off_t izPosPch ;    /**< Position in the patch file                     */
+    off_t izPosOrg ;    /**< Position in the source file                    */
+    off_t izPosOut ;    /**< Position in the output file                    */
+    int   iiOpr ;       /**< Pending operator (0 = read from the patch)     */
+} rPchPnt ;
+
 /**
 * @brief Apply patch file generated by jdiff to a source file.
 *
@@ -72,6 +94,70 @@ class JPatcht
         */
         int jpatch ( ) ;
 
+        /**
+        * @brief Apply part of a patch, from a restart point up to a patch position.
+        *
+        * @param    arBeg       Restart point to start from
+        * @param    azPchEnd    Position in the patch file to stop at (a restart point's izPosPch)
+        * @return   see jpatch()
+        */
+        int jpatch ( rPchPnt const &arBeg, off_t const azPchEnd ) ;
+
+        /**
+        * @brief Scan the patch without producing output and collect restart points.
+        *
+        * A restart point is collected about every azStp output bytes, the first
+        * one being the start of the patch. A final point marks the end of the patch.
+        *
+        * @param    arPnt       out: restart points
+        * @param    azStp       number of output bytes between restart points
+        * @return   see jpatch()
+        */
+        int index ( std::vector<rPchPnt> &arPnt, off_t const azStp ) ;
+
+        /**
+        * @brief Reconstruct a range of the output only.
+        *
+        * On a seekable patch, decoding starts from the last restart point
+        * before the range. Otherwise the patch is decoded from the start.
+        *
+        * @param    azPos       Output position to start from
+        * @param    azLen       Number of bytes to output
+        * @return   see jpatch()
+        */
+        int jpatch_range ( off_t const azPos, off_t const azLen ) ;
+
+        /**
+        * @brief Prepare for jpatch_range: load the index of a seekable patch,
+        * or scan the patch and keep its restart points in memory.
+        *
+        * @param    azStp       number of output bytes between restart points when scanning
+        * @return   see jpatch()
+        */
+        int prepare ( off_t const azStp ) ;
+
+        /**
+        * @brief Return the size of the output (after prepare).
+        *
+        * @return size, -1 when unknown
+        */
+        off_t get_outsize() const { return moIdx.empty() ? -1 : moIdx.back().izPosOut ; }
+
+        /**
+        * @brief Make the patch seekable: append an index of restart points.
+        *
+        * The output file must be the patch file itself, positioned at its end.
+        *
+        * @param    azStp       number of output bytes between restart points
+        * @return   EXI_OK, EXI_WRI or see jpatch()
+        */
+        int seekable ( off_t const azStp ) ;
+
+        /**
+        * @brief Return whether the patch is seekable (has an index).
+        */
+        bool is_seekable() const { return mzIdxCnt > 0 ; }
+
     protected:
 
     private:
@@ -79,6 +165,13 @@ class JPatcht
         JFile       &mpFilPch;      //!< Patch  file
         JFileOut    &mpFilOut;      //!< Output file
         const int   miVerbse;      //!< Verbosity level
+        off_t       mzWinBeg = 0 ;              //!< Output window: first position to output
+        off_t       mzWinEnd = MAX_OFF_T ;      //!< Output window: end position
+        off_t       mzPchEnd = MAX_OFF_T ;      //!< End of the operations in the patch file
+        off_t       mzIdxCnt = 0 ;              //!< Number of index entries (seekable patch)
+        std::vector<rPchPnt> moIdx ;            //!< Index entries (when loaded)
+        std::vector<rPchPnt> *mpPnt = null ;    //!< Restart points to collect (index)
+        off_t       mzPntStp = 0 ;              //!< Output bytes between restart points
 
         /** @brief Get an offset from the input file
         *
@@ -87,6 +180,15 @@ class JPatcht
         */
         off_t ufGetInt( JFile &lpFil ) ;
 
+        /** @brief Read a 64-bit big-endian number from the patch file */
+        off_t ufGetI64( off_t const azPos ) ;
+
+        /** @brief Write a 64-bit big-endian number to the output */
+        int ufPutI64( off_t const azVal ) ;
+
+        /** @brief Load the index entries of a seekable patch */
+        int ufLoadIdx( ) ;
+
         /** @brief Put one byte of output data
         *
         * @param    azPosOrg    position on source file
@@ -99,6 +201,14 @@ class JPatcht
         int ufPutDta( off_t const azPosOrg, off_t const azPosNew,
                       int liOpr, int const aiDta, off_t aiOff );
 
+        /** @brief Output the run of escape-free data at the patch's read position
+        *
+        * @param    azPosOut    position on output file
+        * @param    azMod       in/out: offset counter
+        * @return   next byte from the patch file
+        */
+        int ufGetRun( off_t const azPosOut, off_t &azMod );
+
         /** @brief Read a data sequence (INS or MOD)
         *
         * @param    azPosOrg    position on source file
@@ -0,0 +1,378 @@
+/*
+ * JSuffixArray.cpp
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "JSuffixArray.h"
+
+namespace JojoDiff {
+
+#define SFXCND 64           /**< Number of equally long matches to choose the closest from */
+#define SFXDPT 1024         /**< Depth to narrow down to, longer matches are compared directly */
+
+/*
+ * Helpers for SA-IS.
+ * Types are kept in a bitmap: 1 = S-type, 0 = L-type.
+ * At level 0, characters are the bytes plus one, followed by a sentinel 0.
+ */
+#define tget(i)     ((lpTyp[(i) / 8] >> ((i) % 8)) & 1)
+#define tset(i, b)  (lpTyp[(i) / 8] = (b) ? (lpTyp[(i) / 8] | (1 << ((i) % 8))) \
+                                          : (lpTyp[(i) / 8] & ~(1 << ((i) % 8))))
+#define chr(i)      ((aiChs == (int) sizeof(int)) ? ((int const *) apStr)[i] \
+                                                  : ((i) < aiLen - 1 ? ((jchar const *) apStr)[i] + 1 : 0))
+#define isLMS(i)    ((i) > 0 && tget(i) && ! tget((i) - 1))
+
+/**
+ * @brief Calculate the start (or end) of the bucket of every character.
+ */
+#define getBuckets(abEnd) {                                         \
+    int liSum = 0 ;                                                 \
+    for (liIdx = 0; liIdx <= aiMax; liIdx++) lpBkt[liIdx] = 0 ;     \
+    for (liIdx = 0; liIdx < aiLen; liIdx++) lpBkt[chr(liIdx)]++ ;   \
+    for (liIdx = 0; liIdx <= aiMax; liIdx++) {                      \
+        liSum += lpBkt[liIdx] ;                                     \
+        lpBkt[liIdx] = (abEnd) ? liSum : liSum - lpBkt[liIdx] ;     \
+    }                                                               \
+}
+
+/**
+ * @brief Induce the order of L-type suffixes, then of S-type suffixes.
+ */
+#define induce() {                                                  \
+    getBuckets(false) ;                                             \
+    for (liIdx = 0; liIdx < aiLen; liIdx++) {                       \
+        liPos = apSfx[liIdx] - 1 ;                                  \
+        if (liPos >= 0 && ! tget(liPos))                            \
+            apSfx[lpBkt[chr(liPos)]++] = liPos ;                    \
+    }                                                               \
+    getBuckets(true) ;                                              \
+    for (liIdx = aiLen - 1; liIdx >= 0; liIdx--) {                  \
+        liPos = apSfx[liIdx] - 1 ;                                  \
+        if (liPos >= 0 && tget(liPos))                              \
+            apSfx[--lpBkt[chr(liPos)]] = liPos ;                    \
+    }                                                               \
+}
+
+/*
+ * Constructor/destructor
+ */
+JSuffixArray::JSuffixArray() {
+}
+
+JSuffixArray::~JSuffixArray() {
+    free(mpDta) ;
+    free(mpSfx) ;
+    free(mpBkt) ;
+}
+
+/**
+ * @brief Load the source file into memory and sort its suffixes.
+ *
+ * @param apFil     source file, must not be sequential
+ * @return EXI_OK, EXI_LRG when the file is too large or sequential,
+ *         EXI_MEM when out of memory, EXI_RED on read errors
+ */
+int JSuffixArray::build (JFile * const apFil) {
+    off_t lzSze = apFil->geteof() ;
+
+    if (lzSze >= SFXMAXSZE)
+        return EXI_LRG ;
+    miSze = (int) lzSze ;
+
+    mpDta = (jchar *) malloc(miSze + 1) ;
+    mpSfx = (int *) malloc(sizeof(int) * (miSze + 1)) ;
+    mpBkt = (int *) malloc(sizeof(int) * 0x10001) ;
+    if (mpDta == null || mpSfx == null || mpBkt == null)
+        return EXI_MEM ;
+
+    if (apFil->read(0, mpDta, miSze) != miSze)
+        return EXI_RED ;
+
+    int liRet = sais(mpDta, mpSfx, miSze + 1, 256, 1) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+
+    /* first suffix starting with each two bytes: the last suffix, a single byte,
+     * may end up at the end of the previous range (see find) */
+    int liKey = 0 ;
+    for (int liIdx = 1; liIdx <= miSze; liIdx++) {
+        int liPos = mpSfx[liIdx] ;
+        int liNxt = (liPos + 1 < miSze) ? (mpDta[liPos] << 8 | mpDta[liPos + 1]) + 1 : mpDta[liPos] << 8 ;
+        while (liKey < liNxt)
+            mpBkt[liKey++] = liIdx ;
+    }
+    while (liKey <= 0x10000)
+        mpBkt[liKey++] = miSze + 1 ;
+
+    return EXI_OK ;
+} /* build */
+
+/**
+ * @brief Sort the suffixes of a string (SA-IS), recursively.
+ *
+ * 1. Classify suffixes as S-type or L-type and sort the LMS-substrings
+ *    (left-most S-type) by inducing from their unsorted positions.
+ * 2. Name the LMS-substrings: if all names differ, their order is known,
+ *    otherwise sort the reduced string of names recursively.
+ * 3. Induce the order of all suffixes from the sorted LMS-suffixes.
+ *
+ * The reduced string and its suffix array are kept within apSfx.
+ *
+ * @param apStr     string: bytes (level 0) or integers (reduced string)
+ * @param apSfx     out: suffix array, aiLen entries
+ * @param aiLen     length of the string, including the sentinel
+ * @param aiMax     largest character in the string
+ * @param aiChs     size of a character: 1 = bytes + implicit sentinel, sizeof(int) = integers
+ * @return EXI_OK or EXI_MEM
+ */
+int JSuffixArray::sais (void const * const apStr, int * const apSfx, int const aiLen, int const aiMax, int const aiChs) {
+    jchar *lpTyp ;      /**< Types: 1 = S-type, 0 = L-type      */
+    int   *lpBkt ;      /**< Buckets                            */
+    int   *lpRed ;      /**< Reduced string                     */
+    int   liLms ;       /**< Number of LMS-substrings           */
+    int   liNam ;       /**< Number of names                    */
+    int   liPrv ;       /**< Previous LMS-substring             */
+    int   liPos ;
+    int   liIdx ;
+    int   liJdx ;
+    int   liDpt ;
+    bool  lbDif ;
+    int   liRet = EXI_OK ;
+
+    lpTyp = (jchar *) calloc(aiLen / 8 + 1, 1) ;
+    lpBkt = (int *) malloc(sizeof(int) * (aiMax + 1)) ;
+    if (lpTyp == null || lpBkt == null) {
+        free(lpTyp) ;
+        free(lpBkt) ;
+        return EXI_MEM ;
+    }
+
+    /* classify: the sentinel is S-type, the character before it L-type */
+    tset(aiLen - 1, 1) ;
+    if (aiLen > 1)
+        tset(aiLen - 2, 0) ;
+    for (liIdx = aiLen - 3; liIdx >= 0; liIdx--)
+        tset(liIdx, (chr(liIdx) < chr(liIdx + 1)
+                 || (chr(liIdx) == chr(liIdx + 1) && tget(liIdx + 1))) ? 1 : 0) ;
+
+    /* stage 1: sort LMS-substrings */
+    getBuckets(true) ;
+    for (liIdx = 0; liIdx < aiLen; liIdx++)
+        apSfx[liIdx] = -1 ;
+    for (liIdx = 1; liIdx < aiLen; liIdx++)
+        if (isLMS(liIdx))
+            apSfx[--lpBkt[chr(liIdx)]] = liIdx ;
+    induce() ;
+
+    /* compact the sorted LMS-substrings into the first liLms entries */
+    liLms = 0 ;
+    for (liIdx = 0; liIdx < aiLen; liIdx++)
+        if (isLMS(apSfx[liIdx]))
+            apSfx[liLms++] = apSfx[liIdx] ;
+
+    /* name the LMS-substrings */
+    for (liIdx = liLms; liIdx < aiLen; liIdx++)
+        apSfx[liIdx] = -1 ;
+    liNam = 0 ;
+    liPrv = -1 ;
+    for (liIdx = 0; liIdx < liLms; liIdx++) {
+        liPos = apSfx[liIdx] ;
+        lbDif = false ;
+        for (liDpt = 0; liDpt < aiLen; liDpt++) {
+            if (liPrv == -1 || chr(liPos + liDpt) != chr(liPrv + liDpt)
+                    || tget(liPos + liDpt) != tget(liPrv + liDpt)) {
+                lbDif = true ;
+                break ;
+            } else if (liDpt > 0 && (isLMS(liPos + liDpt) || isLMS(liPrv + liDpt))) {
+                break ;
+            }
+        }
+        if (lbDif) {
+            liNam++ ;
+            liPrv = liPos ;
+        }
+        apSfx[liLms + liPos / 2] = liNam - 1 ;
+    }
+    for (liIdx = aiLen - 1, liJdx = aiLen - 1; liIdx >= liLms; liIdx--)
+        if (apSfx[liIdx] >= 0)
+            apSfx[liJdx--] = apSfx[liIdx] ;
+
+    /* stage 2: sort the reduced string */
+    lpRed = apSfx + aiLen - liLms ;
+    if (liNam < liLms) {
+        liRet = sais(lpRed, apSfx, liLms, liNam - 1, (int) sizeof(int)) ;
+    } else {
+        for (liIdx = 0; liIdx < liLms; liIdx++)
+            apSfx[lpRed[liIdx]] = liIdx ;
+    }
+
+    /* stage 3: induce the order of all suffixes */
+    if (liRet == EXI_OK) {
+        getBuckets(true) ;
+        for (liIdx = 1, liJdx = 0; liIdx < aiLen; liIdx++)
+            if (isLMS(liIdx))
+                lpRed[liJdx++] = liIdx ;
+        for (liIdx = 0; liIdx < liLms; liIdx++)
+            apSfx[liIdx] = lpRed[apSfx[liIdx]] ;
+        for (liIdx = liLms; liIdx < aiLen; liIdx++)
+            apSfx[liIdx] = -1 ;
+        for (liIdx = liLms - 1; liIdx >= 0; liIdx--) {
+            liPos = apSfx[liIdx] ;
+            apSfx[liIdx] = -1 ;
+            apSfx[--lpBkt[chr(liPos)]] = liPos ;
+        }
+        induce() ;
+    }
+
+    free(lpBkt) ;
+    free(lpTyp) ;
+    return liRet ;
+} /* sais */
+
+/**
+ * @brief Count equal bytes between data and the source file at a position.
+ */
+int JSuffixArray::match (jchar const * const apDta, int const aiLen, off_t const azPos) const {
+    if (azPos < 0 || azPos >= miSze)
+        return 0 ;
+    return (int) countEqual(apDta, &mpDta[azPos], (aiLen < miSze - azPos) ? aiLen : (long) (miSze - azPos)) ;
+}
+
+/**
+ * @brief Count equal bytes between data and the source file before a position.
+ */
+int JSuffixArray::matchback (jchar const * const apDta, int const aiLen, off_t const azPos) const {
+    int liMax = (azPos < aiLen) ? (int) azPos : aiLen ;
+    int liLen = 0 ;
+
+    if (azPos > miSze)
+        return 0 ;
+    while (liLen < liMax && apDta[- liLen - 1] == mpDta[azPos - liLen - 1])
+        liLen ++ ;
+    return liLen ;
+}
+
+/**
+ * @brief Find the longest match of some data within the source file.
+ *
+ * The range of suffixes starting with the first two bytes of the data is taken
+ * from mpBkt. Then the range of suffixes starting with the first liDpt bytes is
+ * narrowed down byte per byte: within the range, suffixes are sorted on their
+ * byte at depth liDpt (shorter suffixes first), so two binary searches give
+ * the sub-range continuing with the next byte of the data. Once a single
+ * suffix remains, or SFXDPT bytes match, the match is extended by comparing
+ * directly, so long repeated regions do not cost a binary search per byte.
+ *
+ * @param apDta     data to find
+ * @param aiLen     number of bytes in apDta (longer matches are not needed)
+ * @param azPrf     preferred source position
+ * @param azPos     out: source position of the match
+ * @return length of the match, 0 = not found
+ */
+int JSuffixArray::find (jchar const * const apDta, int const aiLen, off_t const azPrf, off_t &azPos) const {
+    int liLow = 1 ;             /**< First suffix of the range (0 is the sentinel)  */
+    int liHgh = miSze + 1 ;     /**< End of the range                               */
+    int liDpt = 0 ;             /**< Number of bytes matched by the range           */
+    int liBeg ;
+    int liEnd ;
+    int liMid ;
+    int lcVal ;
+    int lcSfx ;
+
+    if (miSze == 0)
+        return 0 ;
+
+    if (aiLen >= 2) {
+        int liKey = apDta[0] << 8 | apDta[1] ;
+        liBeg = mpBkt[liKey] ;
+        liEnd = mpBkt[liKey + 1] ;
+        if (liEnd > liBeg && mpSfx[liEnd - 1] == miSze - 1)
+            liEnd -- ;      // the single byte suffix
+        if (liEnd > liBeg) {
+            liLow = liBeg ;
+            liHgh = liEnd ;
+            liDpt = 2 ;
+        }
+    }
+
+    while (liDpt < aiLen && liDpt < SFXDPT && liHgh - liLow > 1) {
+        lcVal = apDta[liDpt] ;
+
+        // first suffix with a byte >= lcVal at depth liDpt
+        liBeg = liLow ;
+        liEnd = liHgh ;
+        while (liBeg < liEnd) {
+            liMid = liBeg + (liEnd - liBeg) / 2 ;
+            lcSfx = (mpSfx[liMid] + liDpt < miSze) ? mpDta[mpSfx[liMid] + liDpt] : -1 ;
+            if (lcSfx < lcVal)
+                liBeg = liMid + 1 ;
+            else
+                liEnd = liMid ;
+        }
+        liMid = liBeg ;
+
+        // first suffix with a byte > lcVal at depth liDpt
+        liEnd = liHgh ;
+        while (liBeg < liEnd) {
+            int liTst = liBeg + (liEnd - liBeg) / 2 ;
+            lcSfx = (mpSfx[liTst] + liDpt < miSze) ? mpDta[mpSfx[liTst] + liDpt] : -1 ;
+            if (lcSfx <= lcVal)
+                liBeg = liTst + 1 ;
+            else
+                liEnd = liTst ;
+        }
+
+        if (liMid == liBeg)
+            break ;     // no suffix continues with lcVal
+        liLow = liMid ;
+        liHgh = liBeg ;
+        liDpt ++ ;
+    }
+
+    if (liHgh - liLow == 1) {
+        // a single suffix remains: extend the match directly
+        azPos = mpSfx[liLow] ;
+        return liDpt + match(apDta + liDpt, aiLen - liDpt, azPos + liDpt) ;
+    }
+    if (liDpt == 0)
+        return 0 ;
+
+    // several matches: take the longest, then the one closest to the preferred position
+    int liLen = -1 ;
+    int liCur ;
+    if (liHgh - liLow > SFXCND)
+        liHgh = liLow + SFXCND ;
+    for (liMid = liLow; liMid < liHgh; liMid++) {
+        liCur = liDpt ;
+        if (liDpt == SFXDPT)
+            liCur += match(apDta + liDpt, aiLen - liDpt, mpSfx[liMid] + liDpt) ;
+        off_t lzDst = mpSfx[liMid] - azPrf ;
+        if (liCur > liLen || (liCur == liLen
+                && (lzDst < 0 ? - lzDst : lzDst) < (azPos - azPrf < 0 ? azPrf - azPos : azPos - azPrf))) {
+            liLen = liCur ;
+            azPos = mpSfx[liMid] ;
+        }
+    }
+    return liLen ;
+} /* find */
+
+} /* namespace JojoDiff */
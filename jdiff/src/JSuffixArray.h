@@ -0,0 +1,124 @@
+/*
+ * JSuffixArray.h
+ *
+ * Copyright (C) 2002-2020 Joris Heirbaut
+ *
+ * This file is part of JojoDiff.
+ *
+ * JojoDiff is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *******************************************************************************
+ * Suffix array on the source file, an exact alternative to JHashPos/JMatchTable.
+ *
+ * The whole source file is loaded into memory and all its suffixes are sorted
+ * with SA-IS (Nong, Zhang and Chan, "Two efficient algorithms for linear time
+ * suffix array construction", 2009). The longest match of any data within the
+ * source file is then found by narrowing down the range of suffixes that start
+ * with that data, one byte at a time, using binary searches. A table on the
+ * first two bytes gives the starting range without searching.
+ *
+ * Memory use is about five times the size of the source file (data and 32-bit
+ * positions), so it is limited to source files smaller than SFXMAXSZE.
+ *******************************************************************************/
+
+#ifndef JSUFFIXARRAY_H_
+#define JSUFFIXARRAY_H_
+
+#include "JDefs.h"
+#include "JFile.h"
+
+namespace JojoDiff {
+
+const off_t SFXMAXSZE = 0x40000000 ;    /* largest source file for a suffix array (1GB)    */
+
+/*
+ * Suffix array on the source file for JDiff.
+ */
+class JSuffixArray {
+public:
+    JSuffixArray();
+    virtual ~JSuffixArray();
+    JSuffixArray(JSuffixArray const&) = delete ;
+    JSuffixArray& operator=(JSuffixArray const&) = delete ;
+
+    /**
+     * @brief Load the source file into memory and sort its suffixes.
+     *
+     * @param apFil     source file, must not be sequential
+     * @return EXI_OK, EXI_LRG when the file is too large or sequential,
+     *         EXI_MEM when out of memory, EXI_RED on read errors
+     */
+    int build (JFile * const apFil) ;
+
+    /**
+     * @brief Find the longest match of some data within the source file.
+     *
+     * When several source positions match equally long, the one closest to
+     * azPrf is returned (among the first few candidates).
+     *
+     * @param apDta     data to find
+     * @param aiLen     number of bytes in apDta (longer matches are not needed)
+     * @param azPrf     preferred source position
+     * @param azPos     out: source position of the match
+     * @return length of the match, 0 = not found
+     */
+    int find (jchar const * const apDta, int const aiLen, off_t const azPrf, off_t &azPos) const ;
+
+    /**
+     * @brief Count equal bytes between data and the source file at a position.
+     *
+     * @param apDta     data to compare
+     * @param aiLen     number of bytes in apDta
+     * @param azPos     source position
+     * @return number of leading equal bytes
+     */
+    int match (jchar const * const apDta, int const aiLen, off_t const azPos) const ;
+
+    /**
+     * @brief Count equal bytes between data and the source file before a position.
+     *
+     * @param apDta     data to compare backwards: apDta[-1] is compared first
+     * @param aiLen     number of bytes before apDta
+     * @param azPos     source position: byte azPos - 1 is compared first
+     * @return number of trailing equal bytes
+     */
+    int matchback (jchar const * const apDta, int const aiLen, off_t const azPos) const ;
+
+    /**
+     * @brief Return the size of the source file.
+     */
+    inline off_t size() const {
+        return miSze ;
+    }
+
+private:
+    /**
+     * @brief Sort the suffixes of s (SA-IS), recursively.
+     *
+     * @param apStr     string: bytes (level 0) or integers (reduced string)
+     * @param apSfx     out: suffix array, n entries
+     * @param aiLen     n: length of the string, including the sentinel
+     * @param aiMax     largest character in the string
+     * @param aiChs     size of a character: 1 = bytes + implicit sentinel, sizeof(int) = integers
+     * @return EXI_OK or EXI_MEM
+     */
+    static int sais (void const * const apStr, int * const apSfx, int const aiLen, int const aiMax, int const aiChs) ;
+
+    jchar *mpDta=null ;     /**< Source file data                                  */
+    int   *mpSfx=null ;     /**< Suffix array: mpSfx[0] is the sentinel            */
+    int   *mpBkt=null ;     /**< First suffix starting with each two bytes (64k+1) */
+    int   miSze=0 ;         /**< Size of the source file                           */
+};
+}
+#endif /* JSUFFIXARRAY_H_ */
@@ -34,6 +34,14 @@
  *   -i size     Index table size in Mb (default 32Mb).
  *   -n count    Minimum number of solutions to find before choosing one.
  *   -x count    Maximum number of solutions to find before choosing one.
+ *   -w count    Number of threads for indexing the source file (0=all cores).
+ *   -e file     Index cache file: reuse the source index of a previous run.
+ *   -A [bits]   Content-defined anchors: index positions where the hash hits a mask.
+ *               Faster lookups, but fewer matches than sampling with a small index.
+ *   -S          Search with a suffix array on the source file instead of the index.
+ *   -B          Index table of cache-line sized buckets instead of flat arrays.
+ *   -M size     Memory limit in Mb for buffers and index table together.
+ *   -O file     Additional source file (repeatable), also needed to undiff.
  *
  * Exit codes
  * ----------
@@ -218,9 +226,24 @@ using namespace std ;
 #include "JOutRgn.h"
 #include "JFile.h"
 #include "JFileOut.h"
+#include "JFileMulti.h"
+#include "JPatchView.h"
 #ifdef JDIFF_DEDUP
 #include "JOutDedup.h"
 #endif // JDIFF_DEDUP
+#ifdef JDIFF_THREADS
+#include <thread>
+#include <atomic>
+#include <vector>
+#endif // JDIFF_THREADS
+#ifdef JDIFF_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "JFileMmap.h"
+#include "JFileUring.h"
+#include "JFileOutMmap.h"
+#endif // JDIFF_MMAP
 
 #ifdef _WIN32
 #include <io.h>
@@ -233,33 +256,565 @@ using namespace JojoDiff ;
 /*********************************************************************************
 * Options parsing
 *********************************************************************************/
-const char *gcOptSht = "a:bcd:fhi:jk:lm:n:pqrst::uvx:y"; /* u:: for optional aruments */
+const char *gcOptSht = "A::a:Bbcd:e:fghi:jk:lM:m:n:O:opqR:rSst::uUvw:x:y::z::Z:"; /* u:: for optional aruments */
 
 struct option gsOptLng [] = {
+    {"anchors",           optional_argument,NULL,'A'},
     {"better",            no_argument,      NULL,'b'},
+    {"buckets",           no_argument,      NULL,'B'},
+    {"batch",             no_argument,      NULL,'g'},
     {"lazy",              no_argument,      NULL,'f'},
     {"console",           no_argument,      NULL,'c'},
     {"debug",             required_argument,NULL,'d'},
     {"help",              no_argument,      NULL,'h'},
     {"listing",           no_argument,      NULL,'l'},
+    {"mmap",              no_argument,      NULL,'o'},
+    {"read-ahead",        required_argument,NULL,'R'},
     {"regions",           no_argument,      NULL,'r'},
     {"sequential-source", no_argument,      NULL,'p'},
     {"sequential-dest",   no_argument,      NULL,'q'},
+    {"source",            required_argument,NULL,'O'},
+    {"suffix-array",      no_argument,      NULL,'S'},
     {"stdio",             no_argument,      NULL,'s'},
     {"test",              optional_argument,NULL,'t'},
     {"jdiff",             no_argument,      NULL,'j'},
     {"undiff",            no_argument,      NULL,'u'},
+    {"uring",             no_argument,      NULL,'U'},
     {"index-size",        required_argument,NULL,'i'},
+    {"index-cache",       required_argument,NULL,'e'},
     {"block-size",        required_argument,NULL,'k'},
     {"buffer-size",       required_argument,NULL,'m'},
+    {"memory-limit",      required_argument,NULL,'M'},
     {"search-size",       required_argument,NULL,'a'},
     {"search-min",        required_argument,NULL,'n'},
     {"search-max",        required_argument,NULL,'x'},
-    {"reflink",           no_argument,      NULL,'y'},
+    {"reflink",           optional_argument,NULL,'y'},
+    {"seekable",          optional_argument,NULL,'z'},
+    {"range",             required_argument,NULL,'Z'},
+    {"threads",           required_argument,NULL,'w'},
     {"verbose",           no_argument,      NULL,'v'},
     {NULL,0,NULL,0}
 };
 
+/************************************************************************************
+* Is the file a stream (pipe, terminal, ...) rather than a regular file or device ?
+* Known before opening the file, so that streams get the sequential defaults (-p/-q).
+*************************************************************************************/
+static bool isStream(const char * const asFilNam, const char * const asStdNam)
+{
+#ifdef JDIFF_MMAP
+    struct stat lsStt ;
+    int liRet = (strcmp(asFilNam, asStdNam) == 0) ? fstat(0, &lsStt) : stat(asFilNam, &lsStt) ;
+    return liRet == 0 && ! S_ISREG(lsStt.st_mode) && ! S_ISBLK(lsStt.st_mode) ;
+#else
+    return false ;
+#endif // JDIFF_MMAP
+}
+
+/************************************************************************************
+* Exit with the exit code corresponding to a return code
+*************************************************************************************/
+static void jexit(const int aiRet, const int aiVerbse)
+{
+    switch (aiRet) {
+    case EXI_FRT:
+        exit (- EXI_FRT);
+    case EXI_SCD:
+        exit (- EXI_SCD);
+    case EXI_OUT:
+        exit (- EXI_OUT);
+    case EXI_SEK:
+        fprintf(JDebug::stddbg, "\nSeek error !\n");
+        exit (- EXI_SEK);
+    case EXI_LRG:
+        fprintf(JDebug::stddbg, "\nError: 64-bit offsets not supported !\n");
+        exit (- EXI_LRG);
+    case EXI_RED:
+        fprintf(JDebug::stddbg, "\nError reading file !\n");
+        exit (- EXI_RED);
+    case EXI_WRI:
+        fprintf(JDebug::stddbg, "\nError writing file !\n");
+        exit (- EXI_WRI);
+    case EXI_MEM:
+        fprintf(JDebug::stddbg, "\nError allocating memory !\n");
+        exit (- EXI_MEM);
+    case EXI_ARG:
+        fprintf(JDebug::stddbg, "\nError in arguments !\n");
+        exit (- EXI_ARG);
+    case EXI_ERR:
+        fprintf(JDebug::stddbg, "\nError occurred !\n");
+        exit (- EXI_ERR);
+    case EXI_OK:
+        exit (EXI_OK) ;
+    case EXI_EQL:
+        if (aiVerbse > 1)
+            fprintf(JDebug::stddbg, "\nFound all data within source file.\n");
+        exit(EXI_OK) ;
+    case EXI_DIF:
+        if (aiVerbse > 1)
+            fprintf(JDebug::stddbg, "\nNot all data has been found in source file.\n");
+        exit(EXI_DIF) ;
+    default:
+        fprintf(JDebug::stddbg, "\nUnknown exit code %d\n", aiRet);
+        exit (- EXI_ERR);
+    }
+}
+
+/************************************************************************************
+* Batch mode: one source file, many destination files
+*************************************************************************************/
+/**
+ * @brief Settings shared by all batch jobs.
+ */
+typedef struct tBchCtx {
+    const char *icFilNamOrg ;   /**< Source filename                                  */
+    char **icFilNamNew ;        /**< Destination filenames                            */
+    int  iiFilCnt ;             /**< Number of destination files                      */
+    long ilBufOrg ;             /**< Source-file buffer size                          */
+    long ilBufNew ;             /**< Destination-file buffer size                     */
+    int  iiBlkSze ;             /**< Block size                                       */
+    int  iiPftCnt ;             /**< Blocks to read ahead                             */
+    bool ibStdio ;              /**< Use stdio (no memory mapped files)               */
+    int  iiHshMbt ;             /**< Hashtable size in MB                             */
+    int  ibSrcBkt ;             /**< Backtrace on sourcefile allowed?                 */
+    int  iiMchMax ;             /**< Maximum entries in matching table                */
+    int  iiMchMin ;             /**< Minimum entries in matching table                */
+    int  iiAhdMax ;             /**< Lookahead range                                  */
+    bool ibCmpAll ;             /**< Compare even if data not in buffer?              */
+    int  iiThrCnt ;             /**< Number of threads                                */
+    int  iiAncBit ;             /**< Anchor mask bits (-1=no anchors, 0=automatic)    */
+    bool ibHshBkt ;             /**< Hashtable of buckets                             */
+    const char *icIdxCch ;      /**< Index cache file                                 */
+    JHashPos *ipHsh ;           /**< Hashtable shared by all jobs                     */
+#ifdef JDIFF_THREADS
+    std::atomic<int> iiNxt ;    /**< Next job to process                              */
+#else
+    int iiNxt ;                 /**< Next job to process                              */
+#endif // JDIFF_THREADS
+} rBchCtx ;
+
+/**
+ * @brief One batch job: diff the source file with one destination file.
+ */
+typedef struct tBchJob {
+    JFile *ipJflOrg ;           /**< Source file                                      */
+    JFile *ipJflNew ;           /**< Destination file                                 */
+    FILE  *ifFilOrg ;           /**< Source file (stdio)                              */
+    FILE  *ifFilNew ;           /**< Destination file (stdio)                         */
+    FILE  *ifFilOut ;           /**< Output file                                      */
+    int    iiFdOrg ;            /**< Source file (memory mapped)                      */
+    int    iiFdNew ;            /**< Destination file (memory mapped)                 */
+    JOut  *ipOut ;              /**< Output                                           */
+    JDiff *ipDif ;              /**< JDiff                                            */
+    int    iiRet ;              /**< Result                                           */
+    off_t  izOutBytDta ;        /**< Data bytes written                               */
+    off_t  izOutBytCtl ;        /**< Control and escape bytes written                 */
+} rBchJob ;
+
+/**
+ * @brief Open a seekable file for a batch job or an additional source file:
+ * memory mapped when possible, stdio otherwise.
+ */
+static JFile *bchOpen(const char *acFilNam, char const * const asJid, const long alBufSze,
+                      const int aiBlkSze, const bool abStdio, FILE *&apFil, int &aiFd)
+{
+    apFil = NULL ;
+    aiFd  = -1 ;
+    #ifdef JDIFF_MMAP
+    if (! abStdio) {
+        aiFd = open(acFilNam, O_RDONLY) ;
+        if (aiFd >= 0) {
+            JFileMmap *lpMap = new JFileMmap(aiFd, asJid) ;
+            if (lpMap->is_mapped())
+                return lpMap ;
+            delete lpMap ;
+            close(aiFd) ;
+            aiFd = -1 ;
+        }
+    }
+    #endif // JDIFF_MMAP
+    apFil = jfopen(acFilNam, "rb") ;
+    if (apFil == NULL)
+        return NULL ;
+    return new JFileAheadStdio(apFil, asJid, alBufSze, aiBlkSze, false);
+}
+
+/**
+ * @brief Open the files of a batch job and create its JDiff.
+ *
+ * The differences for destination file <file> are written to <file>.jdf.
+ *
+ * @return EXI_OK, EXI_FRT, EXI_SCD or EXI_OUT
+ */
+static int bchJobOpen(rBchCtx &arCtx, rBchJob &arJob, const int aiJob)
+{
+    const char *lcFilNamNew = arCtx.icFilNamNew[aiJob] ;
+    char *lcFilNamOut ;
+
+    memset(&arJob, 0, sizeof(arJob)) ;
+    arJob.iiFdNew = -1 ;
+    arJob.ipJflOrg = bchOpen(arCtx.icFilNamOrg, "Org", arCtx.ilBufOrg, arCtx.iiBlkSze,
+                             arCtx.ibStdio, arJob.ifFilOrg, arJob.iiFdOrg) ;
+    if (arJob.ipJflOrg == NULL)
+        return EXI_FRT ;
+    arJob.ipJflNew = bchOpen(lcFilNamNew, "New", arCtx.ilBufNew, arCtx.iiBlkSze,
+                             arCtx.ibStdio, arJob.ifFilNew, arJob.iiFdNew) ;
+    if (arJob.ipJflNew == NULL)
+        return EXI_SCD ;
+    arJob.ipJflOrg->prefetch(arCtx.iiPftCnt) ;
+    arJob.ipJflNew->prefetch(arCtx.iiPftCnt) ;
+
+    lcFilNamOut = (char *) malloc(strlen(lcFilNamNew) + 5) ;
+    if (lcFilNamOut == NULL)
+        return EXI_MEM ;
+    strcpy(lcFilNamOut, lcFilNamNew) ;
+    strcat(lcFilNamOut, ".jdf") ;
+    arJob.ifFilOut = fopen(lcFilNamOut, "wb") ;
+    free(lcFilNamOut) ;
+    if (arJob.ifFilOut == NULL)
+        return EXI_OUT ;
+
+    arJob.ipOut = new JOutBin(arJob.ifFilOut) ;
+    arJob.ipDif = new JDiff(arJob.ipJflOrg, arJob.ipJflNew, arJob.ipOut,
+                            arCtx.iiHshMbt, 0,
+                            arCtx.ibSrcBkt, 1, arCtx.iiMchMax, arCtx.iiMchMin, arCtx.iiAhdMax,
+                            arCtx.ibCmpAll, arCtx.iiThrCnt, arCtx.iiAncBit, false, arCtx.ibHshBkt, arCtx.icIdxCch, arCtx.ipHsh) ;
+    return EXI_OK ;
+}
+
+/**
+ * @brief Open the source file and create the JDiff that indexes it.
+ *
+ * No destination is involved, so that the index does not depend on any job:
+ * the source file stands in for the destination and there is no output.
+ *
+ * @return EXI_OK or EXI_FRT
+ */
+static int bchIdxOpen(rBchCtx &arCtx, rBchJob &arJob)
+{
+    memset(&arJob, 0, sizeof(arJob)) ;
+    arJob.iiFdNew = -1 ;
+    arJob.ipJflOrg = bchOpen(arCtx.icFilNamOrg, "Org", arCtx.ilBufOrg, arCtx.iiBlkSze,
+                             arCtx.ibStdio, arJob.ifFilOrg, arJob.iiFdOrg) ;
+    if (arJob.ipJflOrg == NULL)
+        return EXI_FRT ;
+
+    arJob.ipDif = new JDiff(arJob.ipJflOrg, arJob.ipJflOrg, NULL,
+                            arCtx.iiHshMbt, 0,
+                            arCtx.ibSrcBkt, 1, arCtx.iiMchMax, arCtx.iiMchMin, arCtx.iiAhdMax,
+                            arCtx.ibCmpAll, arCtx.iiThrCnt, arCtx.iiAncBit, false, arCtx.ibHshBkt, arCtx.icIdxCch) ;
+    return EXI_OK ;
+}
+
+/**
+ * @brief Close the files of a batch job.
+ */
+static void bchJobClose(rBchJob &arJob)
+{
+    if (arJob.ipOut != NULL) {
+        arJob.izOutBytDta = arJob.ipOut->gzOutBytDta ;
+        arJob.izOutBytCtl = arJob.ipOut->gzOutBytCtl + arJob.ipOut->gzOutBytEsc ;
+    }
+    delete arJob.ipDif ;
+    delete arJob.ipOut ;
+    if (arJob.ifFilOut != NULL && fclose(arJob.ifFilOut) != 0 && arJob.iiRet >= 0)
+        arJob.iiRet = EXI_WRI ;
+    delete arJob.ipJflOrg ;
+    delete arJob.ipJflNew ;
+    if (arJob.ifFilOrg != NULL) jfclose(arJob.ifFilOrg) ;
+    if (arJob.ifFilNew != NULL) jfclose(arJob.ifFilNew) ;
+    #ifdef JDIFF_MMAP
+    if (arJob.iiFdOrg >= 0) close(arJob.iiFdOrg) ;
+    if (arJob.iiFdNew >= 0) close(arJob.iiFdNew) ;
+    #endif // JDIFF_MMAP
+    arJob.ipDif = NULL ;
+    arJob.ipOut = NULL ;
+    arJob.ifFilOut = NULL ;
+    arJob.ipJflOrg = NULL ;
+    arJob.ipJflNew = NULL ;
+    arJob.ifFilOrg = NULL ;
+    arJob.ifFilNew = NULL ;
+    arJob.iiFdOrg = -1 ;
+    arJob.iiFdNew = -1 ;
+}
+
+/**
+ * @brief Batch worker: process jobs until all have been taken.
+ */
+static void bchRun(rBchCtx *apCtx, rBchJob *apJob)
+{
+    int liJob ;
+    while ((liJob = apCtx->iiNxt++) < apCtx->iiFilCnt) {
+        rBchJob &lrJob = apJob[liJob] ;
+        lrJob.iiRet = bchJobOpen(*apCtx, lrJob, liJob) ;
+        if (lrJob.iiRet == EXI_OK) {
+            lrJob.iiRet = lrJob.ipDif->jdiff() ;
+            if (lrJob.iiRet == EXI_OK)
+                lrJob.iiRet = lrJob.ipOut->close() ;
+            if (lrJob.iiRet == EXI_OK)
+                lrJob.iiRet = (lrJob.ipOut->gzOutBytDta > 0) ? EXI_DIF : EXI_EQL ;
+        }
+        bchJobClose(lrJob) ;
+    }
+}
+
+/**
+ * @brief Batch mode: diff one source file with many destination files.
+ *
+ * The source file is indexed once and the hashtable is shared (read-only) by
+ * all destinations, which are processed concurrently by arCtx.iiThrCnt threads.
+ *
+ * @return EXI_DIF, EXI_EQL or the first error encountered
+ */
+static int jbatch(rBchCtx &arCtx, const int aiVerbse)
+{
+    rBchJob lrIdx ;
+    rBchJob *lpJob ;
+    int liJob ;
+    int liRet ;
+
+    /* Index the source file, independently of the destinations */
+    liRet = bchIdxOpen(arCtx, lrIdx) ;
+    if (liRet == EXI_OK)
+        liRet = lrIdx.ipDif->index() ;
+    if (liRet != EXI_OK) {
+        if (liRet == EXI_FRT)
+            fprintf(JDebug::stddbg, "Could not open first file %s for reading.\n", arCtx.icFilNamOrg);
+        bchJobClose(lrIdx) ;
+        return liRet ;
+    }
+    arCtx.ipHsh = lrIdx.ipDif->getHsh() ;
+
+    lpJob = new rBchJob[arCtx.iiFilCnt] ;
+    liRet = EXI_EQL ;
+
+    /* Process all destinations */
+    arCtx.iiNxt = 0 ;
+    #ifdef JDIFF_THREADS
+    int liThrCnt = (arCtx.iiThrCnt < arCtx.iiFilCnt) ? arCtx.iiThrCnt : arCtx.iiFilCnt ;
+    std::thread *lpThr = new std::thread[liThrCnt] ;
+    for (int liThr = 0; liThr < liThrCnt; liThr++)
+        lpThr[liThr] = std::thread(bchRun, &arCtx, lpJob) ;
+    for (int liThr = 0; liThr < liThrCnt; liThr++)
+        lpThr[liThr].join() ;
+    delete[] lpThr ;
+    #else
+    bchRun(&arCtx, lpJob) ;
+    #endif // JDIFF_THREADS
+    bchJobClose(lrIdx) ;
+
+    /* Report */
+    for (liJob = 0; liJob < arCtx.iiFilCnt; liJob++) {
+        rBchJob &lrJob = lpJob[liJob] ;
+        switch (lrJob.iiRet) {
+        case EXI_DIF:
+        case EXI_EQL:
+            if (aiVerbse > 0)
+                fprintf(JDebug::stddbg, "%s.jdf: data bytes = %" PRIzd ", control-esc bytes = %" PRIzd "\n",
+                        arCtx.icFilNamNew[liJob], lrJob.izOutBytDta, lrJob.izOutBytCtl) ;
+            if (lrJob.iiRet == EXI_DIF && liRet == EXI_EQL)
+                liRet = EXI_DIF ;
+            break ;
+        case EXI_SCD:
+            fprintf(JDebug::stddbg, "Could not open second file %s for reading.\n", arCtx.icFilNamNew[liJob]);
+            break ;
+        case EXI_OUT:
+            fprintf(JDebug::stddbg, "Could not open output file %s.jdf for writing.\n", arCtx.icFilNamNew[liJob]) ;
+            break ;
+        default:
+            fprintf(JDebug::stddbg, "Error %d on %s.\n", lrJob.iiRet, arCtx.icFilNamNew[liJob]) ;
+        }
+        if (lrJob.iiRet < 0 && liRet >= 0)
+            liRet = lrJob.iiRet ;
+    }
+
+    delete[] lpJob ;
+    return liRet ;
+}
+
+#if defined(JDIFF_THREADS) && defined(JDIFF_MMAP)
+/************************************************************************************
+* Parallel undiff: a scan of the patch collects restart points, the segments between
+* them are patched concurrently into disjoint parts of the output file.
+*************************************************************************************/
+#define PCHSEGMIN 0x400000      /**< Minimum output size of a segment (4MB)         */
+
+/**
+ * @brief Parallel undiff context, shared by all threads.
+ */
+typedef struct tPchCtx {
+    std::vector<rPchPnt> ioPnt ; /**< Restart points: segment i = ioPnt[i] to ioPnt[i+1] */
+    int   iiFdOrg ;             /**< Source file (memory mapped)                      */
+    int   iiFdPch ;             /**< Patch file (memory mapped)                       */
+    FILE *ifFilOut ;            /**< Output file                                      */
+    std::atomic<int> iiNxt ;    /**< Next segment to process                          */
+    std::atomic<int> iiRet ;    /**< First error encountered                          */
+} rPchCtx ;
+
+/**
+ * @brief Patch segments until all are done. Each thread maps the files itself.
+ */
+static void pchRun(rPchCtx *apCtx)
+{
+    JFileMmap loJflOrg(apCtx->iiFdOrg, "Org") ;
+    JFileMmap loJflPch(apCtx->iiFdPch, "Pch") ;
+    int liSeg ;
+    int liRet ;
+    int liNul = EXI_OK ;
+
+    if (! loJflOrg.is_mapped() || ! loJflPch.is_mapped()) {
+        apCtx->iiRet.compare_exchange_strong(liNul, EXI_RED) ;
+        return ;
+    }
+    while ((liSeg = apCtx->iiNxt++) < (int) apCtx->ioPnt.size() - 1
+           && apCtx->iiRet == EXI_OK) {
+        rPchPnt const &lrBeg = apCtx->ioPnt[liSeg] ;
+        JFileOut loFilOut(apCtx->ifFilOut, FILOUTBUF, lrBeg.izPosOut) ;
+        JPatcht loJPatcht(loJflOrg, loJflPch, loFilOut) ;
+
+        liRet = loJPatcht.jpatch(lrBeg, apCtx->ioPnt[liSeg + 1].izPosPch) ;
+        if (liRet != EXI_OK) {
+            liNul = EXI_OK ;
+            apCtx->iiRet.compare_exchange_strong(liNul, liRet) ;
+        }
+    }
+}
+
+/**
+ * @brief Undiff with aiThrCnt threads.
+ *
+ * @param arPch     JPatcht on the (memory mapped) source and patch file, used for the scan
+ * @param aiFdOrg   Source file descriptor
+ * @param aiFdPch   Patch file descriptor
+ * @param afFilOut  Output file (a regular file)
+ * @param aiThrCnt  Number of threads
+ * @return EXI_OK or the first error encountered
+ */
+static int jpatchpar(JPatcht &arPch, const int aiFdOrg, const int aiFdPch,
+                     FILE *afFilOut, const int aiThrCnt)
+{
+    struct stat lsSta ;
+    off_t lzSze = 0 ;
+    int liRet ;
+
+    /* Collect restart points: aim for some segments per thread */
+    if (fstat(aiFdOrg, &lsSta) == 0)
+        lzSze += lsSta.st_size ;
+    if (fstat(aiFdPch, &lsSta) == 0)
+        lzSze += lsSta.st_size ;
+    lzSze /= aiThrCnt * 8 ;
+
+    rPchCtx lrCtx ;
+    liRet = arPch.index(lrCtx.ioPnt, lzSze < PCHSEGMIN ? PCHSEGMIN : lzSze) ;
+    if (liRet != EXI_OK)
+        return liRet ;
+
+    /* Patch the segments */
+    lrCtx.iiFdOrg = aiFdOrg ;
+    lrCtx.iiFdPch = aiFdPch ;
+    lrCtx.ifFilOut = afFilOut ;
+    lrCtx.iiNxt = 0 ;
+    lrCtx.iiRet = EXI_OK ;
+
+    int liThrCnt = (aiThrCnt < (int) lrCtx.ioPnt.size() - 1) ? aiThrCnt : (int) lrCtx.ioPnt.size() - 1 ;
+    std::thread *lpThr = new std::thread[liThrCnt] ;
+    for (int liThr = 0; liThr < liThrCnt; liThr++)
+        lpThr[liThr] = std::thread(pchRun, &lrCtx) ;
+    for (int liThr = 0; liThr < liThrCnt; liThr++)
+        lpThr[liThr].join() ;
+    delete[] lpThr ;
+
+    if (lrCtx.iiRet == EXI_OK && ftruncate(fileno(afFilOut), lrCtx.ioPnt.back().izPosOut) != 0)
+        return EXI_WRI ;
+    return lrCtx.iiRet ;
+}
+#endif // JDIFF_THREADS && JDIFF_MMAP
+
+/************************************************************************************
+* Patch view test (-t1): read the file recreated by a patch through a JPatchView and
+* compare it with the expected file, sequentially and at random positions.
+*************************************************************************************/
+#define VIEWTSTCNT 1000         /**< Number of random reads                         */
+
+static int jviewtest(JFile &arJflOrg, JFile &arJflPch, FILE *afFilExp, const int aiVerbse)
+{
+    JPatchView loView(arJflOrg, arJflPch, "View") ;
+    jchar *lpExp ;              /**< Expected data                                  */
+    jchar *lpDta ;              /**< Data from the view                             */
+    off_t lzEof ;               /**< Size of the expected file                      */
+    off_t lzPos ;
+    off_t lzLen ;
+    off_t lzAvl ;
+    long  llErr = 0 ;
+    int   liTst ;
+    int   liExp ;
+
+    if (! loView.is_ready()) {
+        fprintf(JDebug::stddbg, "Could not scan the patch file.\n") ;
+        return EXI_ERR ;
+    }
+    if (jfseek(afFilExp, 0, SEEK_END) != 0 || (lzEof = jftell(afFilExp)) < 0)
+        return EXI_SEK ;
+    if (lzEof != loView.geteof()) {
+        fprintf(JDebug::stddbg, "Size mismatch: view " P8zd ", expected " P8zd ".\n",
+                loView.geteof(), lzEof) ;
+        llErr++ ;
+    }
+
+    /* Sequential read */
+    jfseek(afFilExp, 0, SEEK_SET) ;
+    for (lzPos = 0; lzPos < lzEof; lzPos++) {
+        liExp = getc(afFilExp) ;
+        if (loView.get(lzPos) != liExp) {
+            fprintf(JDebug::stddbg, "Sequential mismatch at " P8zd ".\n", lzPos) ;
+            llErr++ ;
+            break ;
+        }
+    }
+    if (aiVerbse > 0)
+        fprintf(JDebug::stddbg, "Sequential read: " P8zd " bytes, %ld blocks reconstructed.\n",
+                lzPos, loView.get_decodes()) ;
+
+    /* Random reads, pread-style */
+    lpExp = (jchar *) malloc(PCHVIEWBLK * 4) ;
+    if (lpExp == null)
+        return EXI_MEM ;
+    srand(1) ;
+    for (liTst = 0; liTst < VIEWTSTCNT && lzEof > 0; liTst++) {
+        lzPos = (((off_t) rand() << 16) ^ rand()) % lzEof ;
+        lzLen = rand() % (PCHVIEWBLK * 4) ;
+        if (lzLen > lzEof - lzPos)
+            lzLen = lzEof - lzPos ;
+        if (jfseek(afFilExp, lzPos, SEEK_SET) != 0
+                || jfread(lpExp, 1, (size_t) lzLen, afFilExp) != (size_t) lzLen) {
+            free(lpExp) ;
+            return EXI_RED ;
+        }
+        for (off_t lzOff = 0; lzOff < lzLen; lzOff += lzAvl) {
+            lpDta = loView.getbuf(lzPos + lzOff, lzAvl) ;
+            if (lpDta == null || lzAvl <= 0) {
+                fprintf(JDebug::stddbg, "Read error at " P8zd ".\n", lzPos + lzOff) ;
+                llErr++ ;
+                break ;
+            }
+            if (lzAvl > lzLen - lzOff)
+                lzAvl = lzLen - lzOff ;
+            if (memcmp(lpDta, lpExp + lzOff, (size_t) lzAvl) != 0) {
+                fprintf(JDebug::stddbg, "Random read mismatch at " P8zd ".\n", lzPos + lzOff) ;
+                llErr++ ;
+                break ;
+            }
+        }
+    }
+    free(lpExp) ;
+    if (aiVerbse > 0)
+        fprintf(JDebug::stddbg, "Random reads: %d, %ld blocks reconstructed in total.\n",
+                liTst, loView.get_decodes()) ;
+
+    fprintf(JDebug::stddbg, "Patch view test: %s (%ld errors).\n", (llErr == 0) ? "ok" : "FAILED", llErr) ;
+    return (llErr == 0) ? EXI_OK : EXI_ERR ;
+}
+
 /************************************************************************************
 * Main function
 *************************************************************************************/
@@ -285,12 +840,28 @@ int main(int aiArgCnt, char *acArg[])
     long llBufNew = 0 ;           /**< Default destin-file buffer in MB                 */
     int liBlkSze = 32*1024 ;      /**< Default block size (in bytes)                    */
     int liAhdMax = 0;             /**< Lookahead range (0=same as llBufSze)             */
+    int liPftCnt = 3 ;            /**< Blocks to read ahead in background (0=none)      */
+    int liThrCnt = 1 ;            /**< Number of threads for indexing (0=all cores)     */
+    int liAncBit = -1 ;           /**< Anchor mask bits (-1=no anchors, 0=automatic)    */
+    bool lbSfxArr = false ;       /**< Search with a suffix array (-S)                  */
+    bool lbHshBkt = false ;       /**< Hashtable of cache-line sized buckets (-B)       */
+    long llMemMax = 0 ;           /**< Memory limit in MB for buffers and index (-M)    */
+    const char *lcFilNamSrc[MULMAXSRC] ; /**< Additional source filenames (-O)       */
+    int liSrcCnt = 0 ;            /**< Number of additional source files                */
+    off_t lzDdpMin = 0x10000 ;    /**< Minimum size to deduplicate (-y)                 */
+    off_t lzIdxStp = 0 ;          /**< Seekable diff: output bytes per index entry (-z) */
+    off_t lzRngPos = -1 ;         /**< Undiff range: start position (-1 = all)          */
+    off_t lzRngLen = MAX_OFF_T ;  /**< Undiff range: length                             */
+    const char *lcIdxCch = NULL ; /**< Index cache file (NULL=none)                     */
     int liHlp=0;                  /**< -h/--help flag: 0=no, 1=-h, 2=-hh, 3=error       */
     bool lbStdio=false;           /**< use stdio                                        */
+    bool lbMapOut=false;          /**< patch into a memory mapped output file           */
+    bool lbUring=false;           /**< read the source file with io_uring               */
     int liTst=0;                  /**< test to execute : 0 = normal, 1 etc... see JTest */
     bool lbSeqOrg = false;        /**< Sequential source file ?                         */
     bool lbSeqNew = false;        /**< Sequential destination file ?                    */
-    enum {Diff, Patch, Dedup, Test} liFun = Diff;  /**< function to execute             */
+    bool lbBch = false;           /**< Batch mode: many destination files ?             */
+    enum {Diff, Patch, Dedup, Test, View} liFun = Diff;  /**< function to execute             */
 
     JDebug::stddbg = stderr ;     /**< Debug and informational (verbose) output         */
 
@@ -375,29 +946,77 @@ int main(int aiArgCnt, char *acArg[])
         case 's': // use stdio
             lbStdio = true ;
             break;
+        case 'o': // memory mapped output
+            lbMapOut = true ;
+            break;
         case 't':   // test: patch and unpatch in one go
             liFun = Test ;
             if (optarg)
                 liTst = atoi(optarg);    // test number
             else
                 liTst=0;
+            if (liTst == 1)
+                liFun = View ;           // patch view test
             break ;
         case 'u':   // unpatch
             liFun = Patch ;
             break ;
+        case 'U':   // "uring",             no_argument
+            lbUring = true ;
+            break ;
         case 'v': // "verbose",           no_argument
             liVerbse++;
             break;
+        case 'z':   // seekable diff
+            lzIdxStp = 0x100000 ;
+            if (optarg) {
+                lzIdxStp = (off_t) atoi(optarg) * 1024 ;
+                if (lzIdxStp <= 0)
+                    lzIdxStp = 1024 ;
+            }
+            break ;
+        case 'Z':   // undiff range <pos>[,<len>]
+            {
+                char *lcEnd ;
+                lzRngPos = (off_t) strtoll(optarg, &lcEnd, 0) ;
+                if (*lcEnd == ',')
+                    lzRngLen = (off_t) strtoll(lcEnd + 1, &lcEnd, 0) ;
+                if (*lcEnd != '\0' || lzRngPos < 0 || lzRngLen < 0) {
+                    fprintf(JDebug::stddbg, "Invalid range %s.\n", optarg) ;
+                    liHlp = 3 ;
+                }
+            }
+            break ;
         case 'y':   // deduplicate
             liFun = Dedup ;
             liOutTyp = 3 ;
             lbStdio = true ;
-            if (optarg)
-                liTst = atoi(optarg);    //@todo: minimum dedup size
-            else
-                liTst=0;
+            if (optarg) {
+                lzDdpMin = (off_t) atoi(optarg) * 1024 ;
+                if (lzDdpMin <= 0)
+                    lzDdpMin = 1 ;
+            }
             break ;
 
+        case 'A': // "anchors",           optional_argument
+            liAncBit = 0 ;
+            if (optarg) {
+                liAncBit = atoi(optarg) ;
+                if (liAncBit <= 0) {
+                    liAncBit = 0 ;
+                    fprintf(JDebug::stddbg, "Warning: invalid --anchors/-A specified, set to automatic.\n");
+                }
+            }
+            break;
+
+        case 'S': // "suffix-array",      no_argument
+            lbSfxArr = true ;
+            break;
+
+        case 'B': // "buckets",           no_argument
+            lbHshBkt = true ;
+            break;
+
         case 'a': // search-ahead-size
             if (optarg)
                 liAhdMax = atoi(optarg) * 1024 ;
@@ -432,11 +1051,51 @@ int main(int aiArgCnt, char *acArg[])
                 // third and subsequent -m: do nothing
             }
             break;
+        case 'M': // "memory-limit",      required_argument
+            llMemMax = atol(optarg) ;
+            if (llMemMax <= 0) {
+                llMemMax = 0 ;
+                fprintf(JDebug::stddbg, "Warning: invalid --memory-limit/-M specified, no limit.\n");
+            }
+            break;
+        case 'O': // "source",            required_argument
+            if (liSrcCnt < MULMAXSRC - 1) {
+                lcFilNamSrc[liSrcCnt++] = optarg ;
+            } else {
+                fprintf(JDebug::stddbg, "Error: too many source files (maximum %d) !\n", MULMAXSRC) ;
+                liHlp = 3 ;
+            }
+            break;
         case 'n': // "search-min",        required_argument
             liMchMin = atoi(optarg) ;
             if (liMchMin < 0)
                 liMchMin=0;
             break;
+        case 'g': // "batch",             no_argument
+            lbBch = true ;
+            break;
+
+        case 'e': // "index-cache",       required_argument
+            lcIdxCch = optarg ;
+            break;
+
+        case 'R': // "read-ahead",        required_argument
+            liPftCnt = atoi(optarg) ;
+            if (liPftCnt < 0)
+                liPftCnt = 0 ;
+            break;
+
+        case 'w': // "threads",           required_argument
+            liThrCnt = atoi(optarg) ;
+            if (liThrCnt <= 0) {
+            #ifdef JDIFF_THREADS
+                liThrCnt = std::thread::hardware_concurrency() ;
+            #endif // JDIFF_THREADS
+                if (liThrCnt <= 0)
+                    liThrCnt = 1 ;
+            }
+            break;
+
         case 'x': // "search-max",        required_argument
             liMchMax = atoi(optarg) ;
             if (liMchMax <= 0)
@@ -515,9 +1174,11 @@ int main(int aiArgCnt, char *acArg[])
         fprintf(JDebug::stddbg, "the first by \"undiffing\". JDiff aims for the smallest possible diff file.\n\n"),
 
         fprintf(JDebug::stddbg, "Usage: jdiff -j [options] <source file> <destination file> [<diff file>]\n") ;
-        fprintf(JDebug::stddbg, "   or: jdiff -u [options] <source file> <diff file> [<destination file>]\n\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff -u [options] <source file> <diff file> [<destination file>]\n") ;
+        fprintf(JDebug::stddbg, "   or: jdiff -j -g [options] <source file> <destination file> ... (<dest>.jdf)\n\n") ;
         fprintf(JDebug::stddbg, "  -j                       JDiff:  create a difference file.\n");
         #ifdef JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  -y --reflink[=<size>]    Dedup:  share regions with source, min <size> KB (64).\n");
         #endif // JDIFF_DEDUP
         fprintf(JDebug::stddbg, "  -u                       Undiff: undiff a difference file.\n\n");
 
@@ -533,20 +1194,38 @@ int main(int aiArgCnt, char *acArg[])
         fprintf(JDebug::stddbg, "  -bb                      Best:   even more memory, search more.\n");
         fprintf(JDebug::stddbg, "  -f --lazy                Lazy:   no unbuffered searching (often slower).\n");
         fprintf(JDebug::stddbg, "  -ff                      Lazier: no full index table.\n");
+        fprintf(JDebug::stddbg, "  -g --batch               Batch: diff source with many destinations.\n");
         fprintf(JDebug::stddbg, "  -p --sequential-source   Sequential source (to avoid !) (with - for stdin).\n");
         fprintf(JDebug::stddbg, "  -q --sequential-dest     Sequential destination (with - for stdin).\n");
         #ifndef JDIFF_STDIO_ONLY
         fprintf(JDebug::stddbg, "  -s --stdio               Use stdio files (for testing).\n");
         #endif // JDIFF_STDIO_ONLY
-        #ifdef JDIFF_DEDUP
-        fprintf(JDebug::stddbg, "  -y --reflink             Reflink to source file when possible.\n") ;
-        #endif // JDIFF_DEDUP
+        fprintf(JDebug::stddbg, "  -t1 <src> <diff> <dest>  Test: compare <dest> with a view on <src> + <diff>.\n");
+        #ifdef JDIFF_MMAP
+        fprintf(JDebug::stddbg, "  -o --mmap                Undiff into a memory mapped destination file.\n");
+        #endif // JDIFF_MMAP
+        #ifdef JDIFF_URING
+        fprintf(JDebug::stddbg, "  -U --uring               Read the source file with io_uring.\n");
+        #endif // JDIFF_URING
+        fprintf(JDebug::stddbg, "  -z --seekable[=<size>]   Seekable diff: index every <size> KB of output (1024).\n") ;
+        fprintf(JDebug::stddbg, "     --range=<pos>[,<len>] Undiff only <len> bytes from position <pos>.\n") ;
         fprintf(JDebug::stddbg, "\n");
+        fprintf(JDebug::stddbg, "  -A --anchors[=<bits>]    Index content-defined anchors, one every 2^bits bytes\n");
+        fprintf(JDebug::stddbg, "                           (faster, but larger diffs with a small index -i).\n");
+        fprintf(JDebug::stddbg, "  -S --suffix-array        Search with a suffix array (source file < 1GB, 5x memory).\n");
+        fprintf(JDebug::stddbg, "  -B --buckets             Index table of cache-line sized buckets.\n");
         fprintf(JDebug::stddbg, "  -a --search-size <size>  Size (in KB) to search (default=buffer-size).\n");
         fprintf(JDebug::stddbg, "  -i --index-size  <size>  Size (in MB) for index table    (default 64).\n");
+        fprintf(JDebug::stddbg, "  -e --index-cache <file>  Load/save the source index from/to file.\n");
         fprintf(JDebug::stddbg, "  -k --block-size  <size>  Block size in bytes for reading (default 8192).\n");
         fprintf(JDebug::stddbg, "  -m --buffer-size <size>  Size (in KB) for search buffers (0=no buffering)\n");
+        fprintf(JDebug::stddbg, "  -M --memory-limit <size> Memory limit (in MB) for buffers and index together.\n");
+        fprintf(JDebug::stddbg, "  -O --source <file>       Additional source file, repeatable (also to undiff).\n");
         fprintf(JDebug::stddbg, "  -n --search-min <count>  Minimum number of matches to search (default %d).\n", liMchMin);
+        #ifdef JDIFF_THREADS
+        fprintf(JDebug::stddbg, "  -R --read-ahead <count>  Blocks to read ahead in background (default %d).\n", liPftCnt);
+        fprintf(JDebug::stddbg, "  -w --threads    <count>  Threads for indexing or undiffing (0=all cores).\n");
+        #endif // JDIFF_THREADS
         fprintf(JDebug::stddbg, "  -x --search-max <count>  Maximum number of matches to search (default %d).\n\n", liMchMax);
 
         fprintf(JDebug::stddbg, "Make  diff-file: jdiff -j old-file new-file diff-file.jdf\n");
@@ -614,12 +1293,49 @@ int main(int aiArgCnt, char *acArg[])
         exit(- EXI_ARG);
     }
 
+    // Streams are sequential: know it before sizing the buffers
+    if (liFun == Diff || liFun == Test || liFun == Dedup) {
+        if (! lbSeqOrg && isStream(lcFilNamOrg, csStdInpOutNam)) {
+            lbSeqOrg = true ;
+            lbCmpAll = false ;            // only compare data within the buffer
+            lbSrcBkt = false ;            // only backtrack on source file in buffer
+            liSrcScn = 0;                 // no pre-scan indexing
+            fprintf(JDebug::stddbg, "\n%s\n", "Warning: Source file is a sequential file, assuming -p.");
+        }
+        if (! lbSeqNew && isStream(lcFilNamNew, csStdInpOutNam)) {
+            lbSeqNew = true ;
+            liMchMin = 0;                 // only search within the buffer
+            fprintf(JDebug::stddbg, "\n%s\n", "Warning: Destination file is a sequential file, assuming -q.");
+        }
+    }
+
+    // Additional source files are concatenated to the source file
+    if (liSrcCnt > 0 && (lbSeqOrg || lbBch || liFun == Dedup || strcmp(lcFilNamOrg, csStdInpOutNam) == 0)) {
+        fprintf(JDebug::stddbg, "%s", "Error: Additional source files need a seekable source file, without -g or -y !\n");
+        exit(- EXI_ARG);
+    }
+
     // Set default values for llBlk and liBlk
     llBufOrg = (llBufOrg > 0 ? llBufOrg : lbSeqOrg ? 32 : 1) ;
     llBufNew = (llBufNew > 0 ? llBufNew : lbSeqNew ? 16 : llBufOrg) * 1024 * 1024 ;
     llBufOrg = llBufOrg * 1024 * 1024 ;
     liBlkSze = (liBlkSze < 4096 ? 4096 : liBlkSze) ;
 
+    // Memory limit: scale down the buffers and the index table together
+    if (llMemMax > 0 && (llBufOrg + llBufNew) / 1024 / 1024 + liHshMbt > llMemMax) {
+        long llMemTot = (llBufOrg + llBufNew) / 1024 / 1024 + liHshMbt ;
+        llBufOrg = (long) ((double) llBufOrg * llMemMax / llMemTot) ;
+        llBufNew = (long) ((double) llBufNew * llMemMax / llMemTot) ;
+        llBufOrg -= llBufOrg % liBlkSze ;
+        llBufNew -= llBufNew % liBlkSze ;
+        liHshMbt = (int) ((long) liHshMbt * llMemMax / llMemTot) ;
+        if (liHshMbt < 1)
+            liHshMbt = 1 ;
+        if (liVerbse > 0)
+            fprintf(JDebug::stddbg, "Warning: memory limit of %ldMb, buffers set to %ldkb+%ldkb and index to %dMb.\n",
+                    llMemMax, llBufOrg / 1024, llBufNew / 1024, liHshMbt);
+    }
+
     // Buffer size cannot be zero and must be aligned on block size
     // Block size  cannot be larger than buffer size
     if (llBufOrg % liBlkSze != 0){
@@ -644,6 +1360,55 @@ int main(int aiArgCnt, char *acArg[])
             liAhdMax = 4096 ;
     }
 
+    /* Batch mode: all remaining arguments are destination files */
+    if (lbBch) {
+        if (lbSeqOrg || strcmp(lcFilNamOrg, csStdInpOutNam) == 0) {
+            fprintf(JDebug::stddbg, "%s", "Error: Batch mode requires a non-sequential source file !\n");
+            exit(- EXI_ARG);
+        }
+        if (liSrcScn == 0) {
+            // all destinations share one index, built beforehand by a full scan
+            fprintf(JDebug::stddbg, "%s", "Error: Batch mode requires a full indexing scan, -ff cannot be used with -g !\n");
+            exit(- EXI_ARG);
+        }
+        if (lbSfxArr) {
+            // all destinations share the hashtable of the source file
+            fprintf(JDebug::stddbg, "%s", "Error: Batch mode searches with the hashtable, -S cannot be used with -g !\n");
+            exit(- EXI_ARG);
+        }
+        if (liFun != Diff) {
+            fprintf(JDebug::stddbg, "%s", "Error: Batch mode only creates difference files, -u, -t and -y cannot be used with -g !\n");
+            exit(- EXI_ARG);
+        }
+        if (liOutTyp != 0) {
+            fprintf(JDebug::stddbg, "%s", "Error: Batch mode only produces binary output, -l and -r cannot be used with -g !\n");
+            exit(- EXI_ARG);
+        }
+
+        rBchCtx lrCtx ;
+        lrCtx.icFilNamOrg = lcFilNamOrg ;
+        lrCtx.icFilNamNew = &acArg[2 + liOptArgCnt] ;
+        lrCtx.iiFilCnt = aiArgCnt - liOptArgCnt - 2 ;
+        lrCtx.ilBufOrg = llBufOrg ;
+        lrCtx.ilBufNew = llBufNew ;
+        lrCtx.iiBlkSze = liBlkSze ;
+        lrCtx.iiPftCnt = liPftCnt ;
+        lrCtx.ibStdio = lbStdio ;
+        lrCtx.iiHshMbt = liHshMbt ;
+        lrCtx.ibSrcBkt = lbSrcBkt ;
+        lrCtx.iiMchMax = liMchMax ;
+        lrCtx.iiMchMin = liMchMin ;
+        lrCtx.iiAhdMax = liAhdMax ;
+        lrCtx.ibCmpAll = lbCmpAll ;
+        lrCtx.iiThrCnt = liThrCnt ;
+        lrCtx.iiAncBit = liAncBit ;
+        lrCtx.ibHshBkt = lbHshBkt ;
+        lrCtx.icIdxCch = lcIdxCch ;
+        lrCtx.ipHsh = NULL ;
+
+        jexit(jbatch(lrCtx, liVerbse), liVerbse) ;
+    }
+
     /* Open files and create file handlers */
     JFile *lpJflOrg = NULL ;
     JFile *lpJflNew = NULL ;
@@ -654,6 +1419,50 @@ int main(int aiArgCnt, char *acArg[])
         lbStdio=true ;
     #endif // JDIFF_STDIO_ONLY
 
+    #ifdef JDIFF_MMAP
+    int liFdOrg = -1 ;
+    int liFdNew = -1 ;
+    if (! lbStdio) {
+        /* Map regular files into memory, other files fall back to buffered access */
+        if (! lbSeqOrg && strcmp(lcFilNamOrg, csStdInpOutNam) != 0) {
+            liFdOrg = open(lcFilNamOrg, O_RDONLY) ;
+            #ifdef JDIFF_URING
+            if (liFdOrg >= 0 && lbUring) {
+                // random access through a block cache instead of a mapping
+                JFileUring *lpUrgOrg = new JFileUring(liFdOrg, "Org", llBufOrg, liBlkSze) ;
+                if (lpUrgOrg->is_ready())
+                    lpJflOrg = lpUrgOrg ;
+                else
+                    delete lpUrgOrg ;
+            }
+            #endif // JDIFF_URING
+            if (liFdOrg >= 0 && lpJflOrg == NULL) {
+                JFileMmap *lpMapOrg = new JFileMmap(liFdOrg, "Org") ;
+                if (lpMapOrg->is_mapped()) {
+                    lpJflOrg = lpMapOrg ;
+                } else {
+                    delete lpMapOrg ;
+                    close(liFdOrg) ;
+                    liFdOrg = -1 ;
+                }
+            }
+        }
+        if (! lbSeqNew && strcmp(lcFilNamNew, csStdInpOutNam) != 0) {
+            liFdNew = open(lcFilNamNew, O_RDONLY) ;
+            if (liFdNew >= 0) {
+                JFileMmap *lpMapNew = new JFileMmap(liFdNew, "New") ;
+                if (lpMapNew->is_mapped()) {
+                    lpJflNew = lpMapNew ;
+                } else {
+                    delete lpMapNew ;
+                    close(liFdNew) ;
+                    liFdNew = -1 ;
+                }
+            }
+        }
+    }
+    #endif // JDIFF_MMAP
+
     FILE *lfFilOrg = NULL ;
     FILE *lfFilNew = NULL ;
 
@@ -703,7 +1512,9 @@ int main(int aiArgCnt, char *acArg[])
     ifstream loSrmNew;
     if (! lbStdio) {
         /* Open first file */
-        if (strcmp(lcFilNamOrg, csStdInpOutNam) == 0 ){
+        if (lpJflOrg != NULL) {
+            // already memory mapped
+        } else if (strcmp(lcFilNamOrg, csStdInpOutNam) == 0 ){
             // Windows needs some additional tweaking for stdin to work
             #ifdef _WIN32
             if (liVerbse > 1)
@@ -721,7 +1532,9 @@ int main(int aiArgCnt, char *acArg[])
         }
 
         /* Open second file */
-        if (strcmp(lcFilNamNew, csStdInpOutNam) == 0 ){
+        if (lpJflNew != NULL) {
+            // already memory mapped
+        } else if (strcmp(lcFilNamNew, csStdInpOutNam) == 0 ){
             // Windows needs some additional tweaking for stdin to work
             #ifdef _WIN32
             if (liVerbse > 1)
@@ -751,9 +1564,41 @@ int main(int aiArgCnt, char *acArg[])
         exit(- EXI_SCD);
     }
 
+    /* Additional source files: one source file made of all source files */
+    FILE *lfFilSrc[MULMAXSRC] ;
+    int liFdSrc[MULMAXSRC] ;
+    if (liSrcCnt > 0) {
+        JFile *lpJflSrc[MULMAXSRC] ;
+        lpJflSrc[0] = lpJflOrg ;
+        for (int liSrc = 0; liSrc < liSrcCnt; liSrc++) {
+            lpJflSrc[liSrc + 1] = bchOpen(lcFilNamSrc[liSrc], "Org", llBufOrg, liBlkSze, lbStdio,
+                                          lfFilSrc[liSrc], liFdSrc[liSrc]) ;
+            if (lpJflSrc[liSrc + 1] == NULL) {
+                fprintf(JDebug::stddbg, "Could not open source file %s for reading.\n", lcFilNamSrc[liSrc]);
+                exit(- EXI_FRT);
+            }
+        }
+        lpJflOrg = new JFileMulti(lpJflSrc, liSrcCnt + 1, "Org") ;
+        if (lpJflOrg->isSequential()) {
+            fprintf(JDebug::stddbg, "%s", "Error: Additional source files need seekable source files !\n");
+            exit(- EXI_FRT);
+        }
+    }
+
+    /* Read ahead in background (buffered files only) */
+    lpJflOrg->prefetch(liPftCnt) ;
+    lpJflNew->prefetch(liPftCnt) ;
+
     /* Open output */
     if (liFun == Dedup) {
         lpFilOut = null ;
+    } else if (liFun == View) {
+        // the third file is the expected result
+        lpFilOut = jfopen(lcFilNamOut, "rb") ;
+        if ( lpFilOut == null ) {
+            fprintf(JDebug::stddbg, "Could not open file %s for reading.\n", lcFilNamOut) ;
+            exit(- EXI_OUT);
+        }
     } else {
         if (strcmp(lcFilNamOut,csStdInpOutNam) == 0 ){
             lpFilOut = stdout ;
@@ -764,6 +1609,8 @@ int main(int aiArgCnt, char *acArg[])
                 fprintf(JDebug::stddbg, "%s\n", "Setting Windows stdout to binary mode.");
             setmode(fileno(lpFilOut), O_BINARY );
             #endif // __WIN32__
+        } else if (lbMapOut && liFun == Patch) {
+            lpFilOut = fopen(lcFilNamOut, "w+b") ;     // mapping needs read access
         } else {
             lpFilOut = fopen(lcFilNamOut, "wb") ;
         }
@@ -805,7 +1652,7 @@ int main(int aiArgCnt, char *acArg[])
             break;
         #ifdef JDIFF_DEDUP
         case 3:
-            lpOut = new JOutDedup(*lpJflOrg, *lpJflNew, liVerbse) ;
+            lpOut = new JOutDedup(*lpJflOrg, *lpJflNew, liVerbse, lzDdpMin) ;
             break ;
         #endif // JDIFF_DEDUP
         case 2:
@@ -817,14 +1664,15 @@ int main(int aiArgCnt, char *acArg[])
         /* Initialize JDiff object */
         JDiff loJDiff(lpJflOrg, lpJflNew, lpOut,
                       liHshMbt, liVerbse,
-                      lbSrcBkt, liSrcScn, liMchMax, liMchMin, liAhdMax, lbCmpAll);
+                      lbSrcBkt, liSrcScn, liMchMax, liMchMin, liAhdMax, lbCmpAll, liThrCnt, liAncBit, lbSfxArr, lbHshBkt, lcIdxCch);
 
         /* Show execution parameters */
         if (liVerbse>1) {
             fprintf(JDebug::stddbg, "\n");
-            fprintf(JDebug::stddbg, "Index table size (default: 64Mb) (-s): %dMb (%d samples)\n",
-                    ((loJDiff.getHsh()->get_hashsize() + 512) / 1024 + 512) / 1024,
-                    loJDiff.getHsh()->get_hashprime()) ;
+            if (loJDiff.getHsh() != null)
+                fprintf(JDebug::stddbg, "Index table size (default: 64Mb) (-s): %dMb (%d samples)\n",
+                        ((loJDiff.getHsh()->get_hashsize() + 512) / 1024 + 512) / 1024,
+                        loJDiff.getHsh()->get_hashcapacity()) ;
             fprintf(JDebug::stddbg, "Search size     (0 = buffersize) (-a): %dkb\n",  liAhdMax / 1024 );
             fprintf(JDebug::stddbg, "Buffer size       (default  2Mb) (-m): %ldMb\n", (llBufOrg + llBufNew) / 1024 / 1024);
             fprintf(JDebug::stddbg, "Block  size       (default 32kb) (-b): %dkb\n",  liBlkSze / 1024);
@@ -833,10 +1681,24 @@ int main(int aiArgCnt, char *acArg[])
             fprintf(JDebug::stddbg, "Compare out-of-buffer (-f to disable): %s\n",    lbCmpAll?"yes":"no");
             fprintf(JDebug::stddbg, "Full indexing scan   (-ff to disbale): %s\n",   (liSrcScn>0)?"yes":"no");
             fprintf(JDebug::stddbg, "Backtrace allowed     (-p to disable): %s\n",    lbSrcBkt?"yes":"no");
+            fprintf(JDebug::stddbg, "Indexing threads     (default 1) (-w): %d\n",  liThrCnt);
+            if (loJDiff.getHsh() != null && loJDiff.getHsh()->get_anchors() >= 0)
+                fprintf(JDebug::stddbg, "Anchor mask bits   (default none) (-A): %d\n",  loJDiff.getHsh()->get_anchors());
+            fprintf(JDebug::stddbg, "Suffix array       (default no)   (-S): %s\n",   (loJDiff.getSfx() != null)?"yes":"no");
+            if (loJDiff.getHsh() != null)
+                fprintf(JDebug::stddbg, "Index buckets      (default no)   (-B): %s\n",   loJDiff.getHsh()->get_buckets()?"yes":"no");
+            if (liSrcCnt > 0)
+                fprintf(JDebug::stddbg, "Additional source files        (-O): %d\n",  liSrcCnt);
         }
 
         /* Execute... */
         liRet = loJDiff.jdiff();
+
+        /* Flush the output: a write error fails the diff */
+        if (liRet == EXI_OK)
+            liRet = lpOut->close() ;
+        if (liRet == EXI_OK && lpFilOut != null && (fflush(lpFilOut) != 0 || ferror(lpFilOut)))
+            liRet = EXI_WRI ;
         if (liRet == EXI_OK) {
             if (lpOut->gzOutBytDta > 0)
                 liRet=EXI_DIF ;
@@ -847,10 +1709,12 @@ int main(int aiArgCnt, char *acArg[])
         /* Write statistics */
         if (liVerbse > 1) {
             fprintf(JDebug::stddbg, "\n");
-            fprintf(JDebug::stddbg, "Index table hits        = %d\n",   loJDiff.getHsh()->get_hashhits()) ;
-            fprintf(JDebug::stddbg, "Index table repairs     = %d\n",   loJDiff.getMch()->getHshRpr()) ;
-            fprintf(JDebug::stddbg, "Index table overloading = %d\n",   loJDiff.getHsh()->get_hashcolmax() / 4 - 1);
-            fprintf(JDebug::stddbg, "Reliability distance    = %d\n",   loJDiff.getHsh()->get_reliability());
+            fprintf(JDebug::stddbg, "Index table hits        = %d\n",   loJDiff.getHshHit()) ;
+            if (loJDiff.getHsh() != null) {
+                fprintf(JDebug::stddbg, "Index table repairs     = %d\n",   loJDiff.getMch()->getHshRpr()) ;
+                fprintf(JDebug::stddbg, "Index table overloading = %d\n",   loJDiff.getHsh()->get_hashcolmax() / 4 - 1);
+                fprintf(JDebug::stddbg, "Reliability distance    = %d\n",   loJDiff.getHsh()->get_reliability());
+            }
             fprintf(JDebug::stddbg, "Inaccurate  solutions   = %d\n",   loJDiff.getHshErr()) ;
             fprintf(JDebug::stddbg, "Source      seeks       = %ld\n",  lpJflOrg->seekcount());
             fprintf(JDebug::stddbg, "Destination seeks       = %ld\n",  lpJflNew->seekcount());
@@ -866,13 +1730,77 @@ int main(int aiArgCnt, char *acArg[])
             fprintf(JDebug::stddbg, "Control-Esc bytes       = %" PRIzd "\n", lpOut->gzOutBytCtl + lpOut->gzOutBytEsc);
             fprintf(JDebug::stddbg, "Total       bytes       = %" PRIzd "\n",
                     lpOut->gzOutBytCtl + lpOut->gzOutBytEsc + lpOut->gzOutBytDta);
+            #ifdef JDIFF_DEDUP
+            if (liFun == Dedup)
+                fprintf(JDebug::stddbg, "Reflinked   bytes       = %" PRIzd "\n",
+                        ((JOutDedup *) lpOut)->getDdpByt());
+            #endif // JDIFF_DEDUP
+        }
+
+        /* Flush and close output */
+        delete lpOut ;
+
+        /* Append an index to make the diff seekable */
+        if (lzIdxStp > 0 && liFun == Diff && (liRet == EXI_DIF || liRet == EXI_EQL)) {
+            FILE *lfFilPch = NULL ;
+            if (liOutTyp == 0 && lpFilOut != stdout && fflush(lpFilOut) == 0)
+                lfFilPch = jfopen(lcFilNamOut, "rb") ;
+            if (lfFilPch == NULL) {
+                fprintf(JDebug::stddbg, "%s\n", "Warning: Seekable diff needs a binary diff written to a file.");
+            } else {
+                JFileAheadStdio loJflPch(lfFilPch, "Pch", llBufNew, liBlkSze, false) ;
+                JFileOut loFilOut(lpFilOut) ;
+                JPatcht loJPatcht(*lpJflOrg, loJflPch, loFilOut) ;
+                int liIdx = loJPatcht.seekable(lzIdxStp) ;
+                if (liIdx != EXI_OK)
+                    liRet = liIdx ;
+                jfclose(lfFilPch) ;
+            }
         }
     } /* liFun == 0 or 2 */
+    if (liFun == View) {
+        liRet = jviewtest(*lpJflOrg, *lpJflNew, lpFilOut, liVerbse) ;
+    }
     if (liFun == Patch || liFun == Test) {
-        JFileOut loFilOut(lpFilOut) ;
+        JFileOut *lpJflOut = NULL ;
+
+        #ifdef JDIFF_MMAP
+        if (lbMapOut && liFun == Patch) {
+            // Estimate the output size as source plus patch size
+            struct stat lsSta ;
+            off_t lzSze = 0 ;
+            if (liFdOrg >= 0 && fstat(liFdOrg, &lsSta) == 0)
+                lzSze += lsSta.st_size ;
+            if (liFdNew >= 0 && fstat(liFdNew, &lsSta) == 0)
+                lzSze += lsSta.st_size ;
+
+            JFileOutMmap *lpMapOut = new JFileOutMmap(lpFilOut, lzSze) ;
+            if (lpMapOut->is_mapped()) {
+                lpJflOut = lpMapOut ;
+            } else {
+                delete lpMapOut ;
+                fprintf(JDebug::stddbg, "%s\n", "Warning: Could not map the destination file, using buffered output.");
+            }
+        }
+        #endif // JDIFF_MMAP
+        if (lpJflOut == NULL)
+            lpJflOut = new JFileOut(lpFilOut) ;
 
-        JPatcht loJPatcht(*lpJflOrg, *lpJflNew, loFilOut, liVerbse) ;
-        liRet = loJPatcht.jpatch();
+        JPatcht loJPatcht(*lpJflOrg, *lpJflNew, *lpJflOut, liVerbse) ;
+        #if defined(JDIFF_THREADS) && defined(JDIFF_MMAP)
+        // Patch segments concurrently: needs mapped inputs and a regular output file
+        struct stat lsSta ;
+        if (liFun == Patch && liThrCnt > 1 && liVerbse == 0 && ! lbMapOut && lzRngPos < 0
+                && liFdOrg >= 0 && liFdNew >= 0 && liSrcCnt == 0 && lpFilOut != stdout
+                && fstat(fileno(lpFilOut), &lsSta) == 0 && S_ISREG(lsSta.st_mode))
+            liRet = jpatchpar(loJPatcht, liFdOrg, liFdNew, lpFilOut, liThrCnt) ;
+        else
+        #endif // JDIFF_THREADS && JDIFF_MMAP
+        if (lzRngPos >= 0)
+            liRet = loJPatcht.jpatch_range(lzRngPos, lzRngLen) ;
+        else
+            liRet = loJPatcht.jpatch();
+        delete lpJflOut ;
     } /* liFun == 1 or 2 */
 
     /* Cleanup */
@@ -891,43 +1819,18 @@ int main(int aiArgCnt, char *acArg[])
     #endif // JDIFF_STDIO_ONLY
     if (lfFilOrg != NULL) jfclose(lfFilOrg);
     if (lfFilNew != NULL) jfclose(lfFilNew);
+    #ifdef JDIFF_MMAP
+    if (liFdOrg >= 0) close(liFdOrg);
+    if (liFdNew >= 0) close(liFdNew);
+    #endif // JDIFF_MMAP
+    for (int liSrc = 0; liSrc < liSrcCnt; liSrc++) {
+        if (lfFilSrc[liSrc] != NULL) jfclose(lfFilSrc[liSrc]);
+        #ifdef JDIFF_MMAP
+        if (liFdSrc[liSrc] >= 0) close(liFdSrc[liSrc]);
+        #endif // JDIFF_MMAP
+    }
 
 
     /* Exit */
-    switch (liRet) {
-    case EXI_SEK:
-        fprintf(JDebug::stddbg, "\nSeek error !\n");
-        exit (- EXI_SEK);
-    case EXI_LRG:
-        fprintf(JDebug::stddbg, "\nError: 64-bit offsets not supported !\n");
-        exit (- EXI_LRG);
-    case EXI_RED:
-        fprintf(JDebug::stddbg, "\nError reading file !\n");
-        exit (- EXI_RED);
-    case EXI_WRI:
-        fprintf(JDebug::stddbg, "\nError writing file !\n");
-        exit (- EXI_WRI);
-    case EXI_MEM:
-        fprintf(JDebug::stddbg, "\nError allocating memory !\n");
-        exit (- EXI_MEM);
-    case EXI_ARG:
-        fprintf(JDebug::stddbg, "\nError in arguments !\n");
-        exit (- EXI_ARG);
-    case EXI_ERR:
-        fprintf(JDebug::stddbg, "\nError occurred !\n");
-        exit (- EXI_ERR);
-    case EXI_OK:
-        exit (EXI_OK) ;
-    case EXI_EQL:
-        if (liVerbse > 1)
-            fprintf(JDebug::stddbg, "\nFound all data within source file.\n");
-        exit(EXI_OK) ;
-    case EXI_DIF:
-        if (liVerbse > 1)
-            fprintf(JDebug::stddbg, "\nNot all data has been found in source file.\n");
-        exit(EXI_DIF) ;
-    default:
-        fprintf(JDebug::stddbg, "\nUnknown exit code %d\n", liRet);
-        exit (- EXI_ERR);
-    }
+    jexit(liRet, liVerbse);
 }